@@ -0,0 +1,479 @@
+#include "benchmark.h"
+#include "keyboard_input.h"
+#include "opengl.h"
+#include "obj_parser.h"
+#include "model_import.h"
+#include "frustum_culling.h"
+#include "bvh.h"
+#include "mip_chain.h"
+#include "libraries/stb_image.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <stdlib.h>
+#include <thread>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+
+void applyBenchmarkCameraPath(float time) {
+    const float orbitRadius = 4.0f;
+    float orbitAngle = time * glm::radians(45.0f);
+
+    cameraPos.x = orbitRadius * cos(orbitAngle);
+    cameraPos.y = 0.5f * sin(time * 0.5f);
+    cameraPos.z = orbitRadius * sin(orbitAngle);
+    // Face the origin, front is built from the yaw in drawScene
+    cameraYaw = glm::degrees(atan2(-cameraPos.z, -cameraPos.x));
+}
+
+void initializeBenchmark(BenchmarkRecorder& recorder, int warmupFrames) {
+    glGenQueries(BenchmarkRecorder::QUERY_RING_SIZE, recorder.queries);
+    for (int i = 0; i < BenchmarkRecorder::QUERY_RING_SIZE; i++)
+        recorder.querySample[i] = -1;
+    recorder.warmupFrames = warmupFrames;
+    recorder.frameIndex = 0;
+    recorder.samples.clear();
+}
+
+static void collectQuery(BenchmarkRecorder& recorder, int slot) {
+    int sample = recorder.querySample[slot];
+    if (sample < 0)
+        return;
+    // Blocks only if the GPU is more than QUERY_RING_SIZE frames behind
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(recorder.queries[slot], GL_QUERY_RESULT, &elapsed);
+    recorder.samples[sample].gpuMs = elapsed / 1.0e6;
+    recorder.querySample[slot] = -1;
+}
+
+void beginBenchmarkFrame(BenchmarkRecorder& recorder) {
+    int slot = recorder.frameIndex % BenchmarkRecorder::QUERY_RING_SIZE;
+    collectQuery(recorder, slot);
+
+    recorder.frameStart = std::chrono::steady_clock::now();
+    glBeginQuery(GL_TIME_ELAPSED, recorder.queries[slot]);
+}
+
+void endBenchmarkFrame(BenchmarkRecorder& recorder, const RenderStateCounters& stateCalls,
+                       const CullingCounters& culling) {
+    int slot = recorder.frameIndex % BenchmarkRecorder::QUERY_RING_SIZE;
+    glEndQuery(GL_TIME_ELAPSED);
+    std::chrono::duration<double, std::milli> cpuTime = std::chrono::steady_clock::now() - recorder.frameStart;
+
+    if (recorder.frameIndex >= recorder.warmupFrames)
+    {
+        FrameSample sample;
+        sample.cpuMs = cpuTime.count();
+        sample.gpuMs = -1.0;
+        sample.stateCalls = stateCalls;
+        sample.culling = culling;
+        recorder.samples.push_back(sample);
+        recorder.querySample[slot] = (int)recorder.samples.size() - 1;
+    }
+    recorder.frameIndex++;
+}
+
+void finishBenchmark(BenchmarkRecorder& recorder) {
+    for (int i = 0; i < BenchmarkRecorder::QUERY_RING_SIZE; i++)
+        collectQuery(recorder, i);
+    glDeleteQueries(BenchmarkRecorder::QUERY_RING_SIZE, recorder.queries);
+}
+
+struct TimingStats {
+    double mean, min, max, p50, p95, p99;
+};
+
+// Nearest-rank percentile on an already sorted list
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty())
+        return 0.0;
+    size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static TimingStats computeStats(std::vector<double> values) {
+    TimingStats stats = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    if (values.empty())
+        return stats;
+    std::sort(values.begin(), values.end());
+    double sum = 0.0;
+    for (size_t i = 0; i < values.size(); i++)
+        sum += values[i];
+    stats.mean = sum / values.size();
+    stats.min = values.front();
+    stats.max = values.back();
+    stats.p50 = percentile(values, 50.0);
+    stats.p95 = percentile(values, 95.0);
+    stats.p99 = percentile(values, 99.0);
+    return stats;
+}
+
+static void writeStatsJSON(FILE* file, const char* name, const TimingStats& stats, bool last) {
+    fprintf(file, "    \"%s\": { \"mean\": %.4f, \"min\": %.4f, \"max\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f }%s\n",
+            name, stats.mean, stats.min, stats.max, stats.p50, stats.p95, stats.p99, last ? "" : ",");
+}
+
+static void writeStatsCSV(FILE* file, const char* name, const TimingStats& stats) {
+    fprintf(file, "# %s_ms mean=%.4f min=%.4f max=%.4f p50=%.4f p95=%.4f p99=%.4f\n",
+            name, stats.mean, stats.min, stats.max, stats.p50, stats.p95, stats.p99);
+}
+
+bool writeBenchmarkResults(const BenchmarkRecorder& recorder, const std::string& fileName) {
+    std::vector<double> cpuTimes, gpuTimes;
+    double stateIssued = 0.0, stateSkipped = 0.0;
+    double culledObjects = 0.0, frustumCulled = 0.0, occlusionCulled = 0.0;
+    for (size_t i = 0; i < recorder.samples.size(); i++)
+    {
+        cpuTimes.push_back(recorder.samples[i].cpuMs);
+        stateIssued += recorder.samples[i].stateCalls.issued;
+        stateSkipped += recorder.samples[i].stateCalls.skipped;
+        culledObjects += recorder.samples[i].culling.objects;
+        frustumCulled += recorder.samples[i].culling.frustumCulled;
+        occlusionCulled += recorder.samples[i].culling.occlusionCulled;
+        if (recorder.samples[i].gpuMs >= 0.0)
+            gpuTimes.push_back(recorder.samples[i].gpuMs);
+    }
+    TimingStats cpu = computeStats(cpuTimes);
+    TimingStats gpu = computeStats(gpuTimes);
+    if (!recorder.samples.empty())
+    {
+        stateIssued /= recorder.samples.size();
+        stateSkipped /= recorder.samples.size();
+        culledObjects /= recorder.samples.size();
+        frustumCulled /= recorder.samples.size();
+        occlusionCulled /= recorder.samples.size();
+    }
+
+    printf("Benchmark: %d frames, cpu p50 %.3f ms p95 %.3f ms p99 %.3f ms, gpu p50 %.3f ms p95 %.3f ms p99 %.3f ms\n",
+           (int)recorder.samples.size(), cpu.p50, cpu.p95, cpu.p99, gpu.p50, gpu.p95, gpu.p99);
+    printf("State changes per frame: %.1f issued, %.1f skipped\n", stateIssued, stateSkipped);
+    printf("Culled per frame: %.1f frustum, %.1f occlusion of %.1f objects\n", frustumCulled, occlusionCulled, culledObjects);
+
+    FILE* file = fopen(fileName.c_str(), "w");
+    if (!file)
+    {
+        fprintf(stderr, "Failed to open %s for writing\n", fileName.c_str());
+        return false;
+    }
+
+    bool json = fileName.size() >= 5 && fileName.compare(fileName.size() - 5, 5, ".json") == 0;
+    if (json)
+    {
+        fprintf(file, "{\n  \"frames\": %d,\n  \"warmupFrames\": %d,\n  \"stats\": {\n",
+                (int)recorder.samples.size(), recorder.warmupFrames);
+        writeStatsJSON(file, "cpu_ms", cpu, false);
+        writeStatsJSON(file, "gpu_ms", gpu, true);
+        fprintf(file, "  },\n  \"stateCallsPerFrame\": { \"issued\": %.2f, \"skipped\": %.2f },\n",
+                stateIssued, stateSkipped);
+        fprintf(file, "  \"culledPerFrame\": { \"objects\": %.2f, \"frustum\": %.2f, \"occlusion\": %.2f },\n",
+                culledObjects, frustumCulled, occlusionCulled);
+        fprintf(file, "  \"samples\": [\n");
+        for (size_t i = 0; i < recorder.samples.size(); i++)
+        {
+            const FrameSample& sample = recorder.samples[i];
+            fprintf(file, "    { \"frame\": %d, \"cpu_ms\": %.4f, \"gpu_ms\": %.4f, \"state_issued\": %u, \"state_skipped\": %u, "
+                    "\"frustum_culled\": %u, \"occlusion_culled\": %u }%s\n",
+                    (int)i, sample.cpuMs, sample.gpuMs, sample.stateCalls.issued, sample.stateCalls.skipped,
+                    sample.culling.frustumCulled, sample.culling.occlusionCulled,
+                    i + 1 < recorder.samples.size() ? "," : "");
+        }
+        fprintf(file, "  ]\n}\n");
+    }
+    else
+    {
+        writeStatsCSV(file, "cpu", cpu);
+        writeStatsCSV(file, "gpu", gpu);
+        fprintf(file, "# state_calls_per_frame issued=%.2f skipped=%.2f\n", stateIssued, stateSkipped);
+        fprintf(file, "# culled_per_frame objects=%.2f frustum=%.2f occlusion=%.2f\n",
+                culledObjects, frustumCulled, occlusionCulled);
+        fprintf(file, "frame,cpu_ms,gpu_ms,state_issued,state_skipped,frustum_culled,occlusion_culled\n");
+        for (size_t i = 0; i < recorder.samples.size(); i++)
+        {
+            const FrameSample& sample = recorder.samples[i];
+            fprintf(file, "%d,%.4f,%.4f,%u,%u,%u,%u\n", (int)i, sample.cpuMs, sample.gpuMs,
+                    sample.stateCalls.issued, sample.stateCalls.skipped,
+                    sample.culling.frustumCulled, sample.culling.occlusionCulled);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void benchmarkObjParser(const char* fileName, double megabytes, int iterations, int threadCount) {
+    double best = 1e30, total = 0.0;
+    ObjModel model;
+    for (int i = 0; i < iterations; i++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!parseObjFile(fileName, model, threadCount))
+            return;
+        double seconds = secondsSince(start);
+        best = std::min(best, seconds);
+        total += seconds;
+    }
+    printf("obj_parser %2d threads: best %8.2f MB/s, mean %8.2f MB/s (%d vertices, %d triangles)\n",
+           threadCount, megabytes / best, megabytes / (total / iterations),
+           (int)model.mesh.vertices.size(), (int)model.mesh.indices.size() / 3);
+}
+
+int runObjParseBenchmark(const char* fileName, int iterations) {
+    struct stat fileInfo;
+    if (stat(fileName, &fileInfo) != 0)
+    {
+        fprintf(stderr, "Failed to open %s\n", fileName);
+        return -1;
+    }
+    double megabytes = fileInfo.st_size / (1024.0 * 1024.0);
+    printf("Parsing %s (%.2f MB), %d iterations\n", fileName, megabytes, iterations);
+
+    int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    benchmarkObjParser(fileName, megabytes, iterations, 1);
+    if (hardwareThreads > 1)
+        benchmarkObjParser(fileName, megabytes, iterations, hardwareThreads);
+
+    Mesh mesh;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (importModelWithAssimp(fileName, mesh))
+    {
+        double seconds = secondsSince(start);
+        printf("assimp               : %8.2f MB/s (%d vertices, %d triangles)\n",
+               megabytes / seconds, (int)mesh.vertices.size(), (int)mesh.indices.size() / 3);
+    }
+    return 0;
+}
+
+typedef size_t (*CullFunction)(const Frustum&, const CullingBounds&, unsigned char*);
+
+static void benchmarkCulling(const char* name, CullFunction cull, const Frustum& frustum,
+                             const CullingBounds& bounds, int iterations) {
+    std::vector<unsigned char> visible(bounds.size());
+    double best = 1e30, total = 0.0;
+    size_t visibleCount = 0;
+    for (int i = 0; i < iterations; i++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        visibleCount = cull(frustum, bounds, visible.data());
+        double seconds = secondsSince(start);
+        best = std::min(best, seconds);
+        total += seconds;
+    }
+    printf("%-6s: best %8.4f ms, mean %8.4f ms, %6.2f ns/object (%d of %d visible)\n", name,
+           best * 1e3, total / iterations * 1e3, best * 1e9 / bounds.size(),
+           (int)visibleCount, (int)bounds.size());
+}
+
+int runCullingBenchmark(int objectCount, int iterations) {
+    // Same projection as the scene, camera at the origin looking down -z
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum;
+    extractFrustum(projection * view, frustum);
+
+    // Unit boxes scattered through a 200 unit cube around the camera
+    srand(1);
+    CullingBounds bounds;
+    for (int i = 0; i < objectCount; i++)
+    {
+        glm::vec3 position(rand() % 2000 * 0.1f - 100.0f, rand() % 2000 * 0.1f - 100.0f, rand() % 2000 * 0.1f - 100.0f);
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+        model = glm::rotate(model, rand() % 628 * 0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
+        addCullingBounds(bounds, glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(0.5f, 0.5f, 0.5f), model);
+    }
+
+    printf("Culling %d objects, %d iterations\n", objectCount, iterations);
+#if defined(__AVX__)
+    benchmarkCulling("avx", cullBounds, frustum, bounds, iterations);
+#elif defined(__SSE__)
+    benchmarkCulling("sse", cullBounds, frustum, bounds, iterations);
+#elif defined(__ARM_NEON)
+    benchmarkCulling("neon", cullBounds, frustum, bounds, iterations);
+#endif
+    benchmarkCulling("scalar", cullBoundsScalar, frustum, bounds, iterations);
+    return 0;
+}
+
+// Boxes scattered through a cube with the same density at every count, so
+// query results stay comparable while the tree gets deeper
+static void randomBoxes(int objectCount, CullingBounds& bounds) {
+    float halfSize = 100.0f * cbrtf(objectCount / 100000.0f);
+    clearCullingBounds(bounds);
+    for (int i = 0; i < objectCount; i++)
+    {
+        glm::vec3 position((rand() / (float)RAND_MAX * 2.0f - 1.0f) * halfSize,
+                           (rand() / (float)RAND_MAX * 2.0f - 1.0f) * halfSize,
+                           (rand() / (float)RAND_MAX * 2.0f - 1.0f) * halfSize);
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+        model = glm::rotate(model, rand() % 628 * 0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
+        addCullingBounds(bounds, glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(0.5f, 0.5f, 0.5f), model);
+    }
+}
+
+static void benchmarkBvh(int objectCount, int iterations) {
+    const int QUERY_COUNT = 10000;
+    CullingBounds bounds;
+    randomBoxes(objectCount, bounds);
+    Bvh bvh;
+    setBvhObjectBounds(bvh, bounds);
+    // Builds are slow at 1M objects, a few runs are enough
+    int buildIterations = std::min(iterations, 5);
+
+    double bestBuild = 1e30;
+    for (int i = 0; i < buildIterations; i++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        buildBvh(bvh);
+        bestBuild = std::min(bestBuild, secondsSince(start));
+    }
+    float builtCost = bvh.builtCost;
+
+    // Every object drifts a little each iteration, like a frame of animation
+    std::vector<Aabb> startBounds = bvh.objectBounds;
+    std::vector<glm::vec3> velocity(objectCount);
+    for (int i = 0; i < objectCount; i++)
+        velocity[i] = glm::vec3(rand() % 200 - 100, rand() % 200 - 100, rand() % 200 - 100) * 0.0005f;
+    double bestRefit = 1e30;
+    for (int i = 0; i < iterations; i++)
+    {
+        for (int o = 0; o < objectCount; o++)
+        {
+            bvh.objectBounds[o].min += velocity[o];
+            bvh.objectBounds[o].max += velocity[o];
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        refitBvh(bvh);
+        bestRefit = std::min(bestRefit, secondsSince(start));
+    }
+    float refitCost = bvhCost(bvh);
+    bvh.objectBounds = startBounds;
+    buildBvh(bvh);
+
+    // Camera at the origin looking down -z, same projection as the scene
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum;
+    extractFrustum(projection * view, frustum);
+    std::vector<unsigned int> found;
+    double bestFrustum = 1e30;
+    for (int i = 0; i < iterations; i++)
+    {
+        found.clear();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        queryBvhFrustum(bvh, frustum, found);
+        bestFrustum = std::min(bestFrustum, secondsSince(start));
+    }
+    size_t frustumCount = found.size();
+    std::vector<unsigned char> visible(objectCount);
+    double bestFlat = 1e30;
+    for (int i = 0; i < iterations; i++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        cullBounds(frustum, bounds, visible.data());
+        bestFlat = std::min(bestFlat, secondsSince(start));
+    }
+
+    std::vector<glm::vec3> directions(QUERY_COUNT), centers(QUERY_COUNT);
+    for (int i = 0; i < QUERY_COUNT; i++)
+    {
+        directions[i] = glm::normalize(glm::vec3(rand() % 200 - 99.5f, rand() % 200 - 99.5f, rand() % 200 - 99.5f));
+        centers[i] = bvh.objectBounds[rand() % objectCount].min;
+    }
+    int hits = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < QUERY_COUNT; i++)
+    {
+        unsigned int object;
+        float distance;
+        hits += raycastBvh(bvh, glm::vec3(0.0f, 0.0f, 0.0f), directions[i], 1000.0f, object, distance);
+    }
+    double raySeconds = secondsSince(start);
+
+    size_t neighbours = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < QUERY_COUNT; i++)
+    {
+        found.clear();
+        queryBvhSphere(bvh, centers[i], 5.0f, found);
+        neighbours += found.size();
+    }
+    double sphereSeconds = secondsSince(start);
+
+    printf("%7d objects, %7d nodes, SAH cost %.1f (%.1f after refit)\n", objectCount, (int)bvh.nodes.size(),
+           builtCost, refitCost);
+    printf("  build   : %9.3f ms\n", bestBuild * 1e3);
+    printf("  refit   : %9.3f ms\n", bestRefit * 1e3);
+    printf("  frustum : %9.3f ms (%d visible), flat SIMD culling %.3f ms\n", bestFrustum * 1e3,
+           (int)frustumCount, bestFlat * 1e3);
+    printf("  ray     : %9.3f us/query, %8.0f queries/s (%d of %d hit)\n", raySeconds * 1e6 / QUERY_COUNT,
+           QUERY_COUNT / raySeconds, hits, QUERY_COUNT);
+    printf("  sphere  : %9.3f us/query, %8.0f queries/s (%.1f objects within 5 units)\n",
+           sphereSeconds * 1e6 / QUERY_COUNT, QUERY_COUNT / sphereSeconds, neighbours / (double)QUERY_COUNT);
+}
+
+int runBvhBenchmark(int maxObjects, int iterations) {
+    printf("BVH up to %d objects, %d iterations\n", maxObjects, iterations);
+    srand(1);
+    int objectCount = std::min(maxObjects, 10000);
+    while (true)
+    {
+        benchmarkBvh(objectCount, iterations);
+        if (objectCount >= maxObjects)
+            break;
+        objectCount = std::min(maxObjects, objectCount * 10);
+    }
+    return 0;
+}
+
+static void benchmarkMipChain(const char* name, const TextureMip& image, const MipChainSettings& settings,
+                              int iterations) {
+    std::vector<TextureMip> mips;
+    double best = 1e30;
+    for (int i = 0; i < iterations; i++)
+    {
+        mips.assign(1, image);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        buildMipChain(mips, settings);
+        best = std::min(best, secondsSince(start));
+    }
+    printf("%-22s: %8.3f ms, %8.1f Mpixel/s\n", name, best * 1e3, image.width * (double)image.height / best * 1e-6);
+}
+
+int runMipBenchmark(const char* fileName, int iterations, int threadCount) {
+    TextureMip image;
+    int channels;
+    unsigned char* pixels = stbi_load(fileName, &image.width, &image.height, &channels, 4);
+    if (!pixels)
+    {
+        fprintf(stderr, "Failed to load texture %s\n", fileName);
+        return -1;
+    }
+    image.pixels.assign(pixels, pixels + (size_t)image.width * image.height * 4);
+    stbi_image_free(pixels);
+    printf("Mip chain of %s (%dx%d), %d iterations\n", fileName, image.width, image.height, iterations);
+
+    JobSystem jobs;
+    int workerCounts[2] = { 1, threadCount > 0 ? threadCount : (int)std::max(1u, std::thread::hardware_concurrency()) };
+    for (int w = 0; w < (workerCounts[1] > 1 ? 2 : 1); w++)
+    {
+        startJobSystem(jobs, workerCounts[w]);
+        for (int filter = MIP_FILTER_BOX; filter <= MIP_FILTER_KAISER; filter++)
+        {
+            for (int scalar = 0; scalar < 2; scalar++)
+            {
+                MipChainSettings settings;
+                settings.filter = (MipFilter)filter;
+                settings.jobs = &jobs;
+                settings.scalar = scalar;
+                char name[64];
+                snprintf(name, sizeof(name), "%s %s, %d thread%s", filter == MIP_FILTER_BOX ? "box" : "kaiser",
+                         scalar ? "scalar" : "simd", workerCounts[w], workerCounts[w] > 1 ? "s" : "");
+                benchmarkMipChain(name, image, settings, iterations);
+            }
+        }
+        stopJobSystem(jobs);
+    }
+    return 0;
+}
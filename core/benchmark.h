@@ -0,0 +1,65 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include "render_state.h"
+#include "frustum_culling.h"
+
+// Scripted camera path used instead of keyboard input while benchmarking:
+// one orbit around the origin every 8 seconds, bobbing up and down, always
+// looking at the center. Writes cameraPos / cameraYaw directly.
+void applyBenchmarkCameraPath(float time);
+
+struct FrameSample {
+    double cpuMs; // wall time of the whole frame on the CPU
+    double gpuMs; // GL_TIME_ELAPSED of the frame's commands, -1 until known
+    RenderStateCounters stateCalls; // state changes issued / filtered this frame
+    CullingCounters culling;        // objects dropped by frustum and occlusion culling
+};
+
+// Collects per-frame CPU and GPU timings. GPU times come from timer queries
+// that are read back a few frames later so the benchmark never waits on
+// the GPU inside the loop.
+struct BenchmarkRecorder {
+    static const int QUERY_RING_SIZE = 4;
+
+    unsigned int queries[QUERY_RING_SIZE];
+    int querySample[QUERY_RING_SIZE]; // sample index a query belongs to, -1 when free
+    int warmupFrames;
+    int frameIndex;
+    std::chrono::steady_clock::time_point frameStart;
+    std::vector<FrameSample> samples;
+};
+
+void initializeBenchmark(BenchmarkRecorder& recorder, int warmupFrames);
+void beginBenchmarkFrame(BenchmarkRecorder& recorder);
+void endBenchmarkFrame(BenchmarkRecorder& recorder, const RenderStateCounters& stateCalls,
+                       const CullingCounters& culling);
+// Waits for outstanding queries and releases them
+void finishBenchmark(BenchmarkRecorder& recorder);
+
+// Writes samples and p50/p95/p99 statistics, .json paths get JSON,
+// anything else gets CSV. Also prints a one-line summary to stdout.
+bool writeBenchmarkResults(const BenchmarkRecorder& recorder, const std::string& fileName);
+
+// Parses an OBJ file `iterations` times single threaded and with all
+// hardware threads, then once through Assimp, and prints MB/s for each.
+int runObjParseBenchmark(const char* fileName, int iterations);
+
+// Frustum culls `objectCount` randomly placed and rotated boxes `iterations`
+// times with the SIMD and the scalar test and prints the time per pass.
+int runCullingBenchmark(int objectCount, int iterations);
+
+// Builds, refits and queries (frustum, ray picking, sphere proximity) a BVH
+// over 10k, 100k, ... up to maxObjects randomly placed boxes and prints the
+// time of each, with flat SIMD culling of the same boxes for comparison.
+int runBvhBenchmark(int maxObjects, int iterations);
+
+// Builds the sRGB mip chain of an image `iterations` times with the box and
+// Kaiser filters, SIMD and scalar, on one worker and on threadCount (0: one
+// per hardware thread), and prints level 0 Mpixel/s for each.
+int runMipBenchmark(const char* fileName, int iterations, int threadCount);
+
+#endif
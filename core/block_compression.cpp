@@ -0,0 +1,510 @@
+#include "block_compression.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+const char* textureFormatName(TextureFormat format) {
+    static const char* names[TEXTURE_FORMAT_COUNT] = { "rgba8", "bc1", "bc3", "bc7" };
+    return names[format];
+}
+
+int textureBlockSize(TextureFormat format) {
+    return format == TEXTURE_FORMAT_RGBA8 ? 1 : 4;
+}
+
+int textureBlockBytes(TextureFormat format) {
+    return format == TEXTURE_FORMAT_RGBA8 ? 4 : format == TEXTURE_FORMAT_BC1 ? 8 : 16;
+}
+
+size_t textureLevelSize(TextureFormat format, int width, int height) {
+    int blockSize = textureBlockSize(format);
+    size_t blocksX = (width + blockSize - 1) / blockSize;
+    size_t blocksY = (height + blockSize - 1) / blockSize;
+    return blocksX * blocksY * textureBlockBytes(format);
+}
+
+// Mean and principal axis (power iteration on the covariance matrix) of the
+// 16 pixels over the first `channels` channels
+static void principalAxis(const unsigned char* rgba, int channels, float* mean, float* axis) {
+    float minimum[4] = { 255, 255, 255, 255 }, maximum[4] = { 0, 0, 0, 0 };
+    for (int c = 0; c < channels; c++)
+        mean[c] = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < channels; c++)
+        {
+            float value = rgba[i * 4 + c];
+            mean[c] += value / 16.0f;
+            minimum[c] = std::min(minimum[c], value);
+            maximum[c] = std::max(maximum[c], value);
+        }
+    }
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        float offset[4];
+        for (int c = 0; c < channels; c++)
+            offset[c] = rgba[i * 4 + c] - mean[c];
+        for (int a = 0; a < channels; a++)
+            for (int b = 0; b < channels; b++)
+                covariance[a][b] += offset[a] * offset[b];
+    }
+
+    // The bounding box diagonal is a good start and the answer for flat blocks
+    for (int c = 0; c < channels; c++)
+        axis[c] = maximum[c] - minimum[c];
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {}, length = 0.0f;
+        for (int a = 0; a < channels; a++)
+        {
+            for (int b = 0; b < channels; b++)
+                next[a] += covariance[a][b] * axis[b];
+            length += next[a] * next[a];
+        }
+        if (length < 1e-6f)
+            break;
+        length = sqrtf(length);
+        for (int c = 0; c < channels; c++)
+            axis[c] = next[c] / length;
+    }
+}
+
+// Projections of the pixels on the axis, as the endpoints spanning them
+static void axisEndpoints(const unsigned char* rgba, int channels, float* start, float* end) {
+    float mean[4], axis[4];
+    principalAxis(rgba, channels, mean, axis);
+    float low = 0.0f, high = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = 0.0f;
+        for (int c = 0; c < channels; c++)
+            t += (rgba[i * 4 + c] - mean[c]) * axis[c];
+        low = std::min(low, t);
+        high = std::max(high, t);
+    }
+    for (int c = 0; c < channels; c++)
+    {
+        start[c] = mean[c] + axis[c] * low;
+        end[c] = mean[c] + axis[c] * high;
+    }
+}
+
+// Endpoints minimizing the squared error of (1 - w) * start + w * end for
+// the pixels' chosen weights, false when the weights don't span a line
+static bool leastSquaresEndpoints(const unsigned char* rgba, int channels, const float* weights,
+                                  float* start, float* end) {
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[4] = {}, bx[4] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        float a = 1.0f - weights[i], b = weights[i];
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < channels; c++)
+        {
+            ax[c] += a * rgba[i * 4 + c];
+            bx[c] += b * rgba[i * 4 + c];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (fabsf(determinant) < 1e-6f)
+        return false;
+    for (int c = 0; c < channels; c++)
+    {
+        start[c] = std::min(255.0f, std::max(0.0f, (bb * ax[c] - ab * bx[c]) / determinant));
+        end[c] = std::min(255.0f, std::max(0.0f, (aa * bx[c] - ab * ax[c]) / determinant));
+    }
+    return true;
+}
+
+static unsigned short packRGB565(const float* color) {
+    int r = std::min(31, std::max(0, (int)(color[0] * 31.0f / 255.0f + 0.5f)));
+    int g = std::min(63, std::max(0, (int)(color[1] * 63.0f / 255.0f + 0.5f)));
+    int b = std::min(31, std::max(0, (int)(color[2] * 31.0f / 255.0f + 0.5f)));
+    return (unsigned short)(r << 11 | g << 5 | b);
+}
+
+static void unpackRGB565(unsigned short color, int* rgb) {
+    int r = color >> 11 & 31, g = color >> 5 & 63, b = color & 31;
+    rgb[0] = r << 3 | r >> 2;
+    rgb[1] = g << 2 | g >> 4;
+    rgb[2] = b << 3 | b >> 2;
+}
+
+// Four color palette, indices 2 and 3 are 1/3 and 2/3 of the way to color1
+static void colorPalette(unsigned short color0, unsigned short color1, int palette[4][3]) {
+    unpackRGB565(color0, palette[0]);
+    unpackRGB565(color1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+    }
+}
+
+// Writes the color half of a BC1/BC3 block for two 565 endpoints and
+// returns its squared error. Endpoints are ordered color0 > color1, which
+// selects the four color mode.
+static int encodeColorEndpoints(const unsigned char* rgba, unsigned short color0, unsigned short color1,
+                                unsigned char* block, unsigned char* indices) {
+    if (color0 < color1)
+        std::swap(color0, color1);
+    int palette[4][3];
+    colorPalette(color0, color1, palette);
+    int error = 0;
+    unsigned int bits = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0, bestError = 1 << 30;
+        // Equal endpoints decode in the three color mode, where only index 0 is color0
+        for (int p = 0; p < (color0 == color1 ? 1 : 4); p++)
+        {
+            int distance = 0;
+            for (int c = 0; c < 3; c++)
+            {
+                int delta = rgba[i * 4 + c] - palette[p][c];
+                distance += delta * delta;
+            }
+            if (distance < bestError)
+            {
+                best = p;
+                bestError = distance;
+            }
+        }
+        indices[i] = best;
+        bits |= best << (i * 2);
+        error += bestError;
+    }
+    block[0] = color0 & 0xFF;
+    block[1] = color0 >> 8;
+    block[2] = color1 & 0xFF;
+    block[3] = color1 >> 8;
+    block[4] = bits & 0xFF;
+    block[5] = bits >> 8 & 0xFF;
+    block[6] = bits >> 16 & 0xFF;
+    block[7] = bits >> 24;
+    return error;
+}
+
+static void compressColorBlock(const unsigned char* rgba, unsigned char* block) {
+    float start[3], end[3];
+    axisEndpoints(rgba, 3, start, end);
+    unsigned char indices[16];
+    int error = encodeColorEndpoints(rgba, packRGB565(end), packRGB565(start), block, indices);
+
+    // Refit the endpoints to the chosen indices, keep the result if it's better
+    static const float INDEX_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    float weights[16];
+    for (int i = 0; i < 16; i++)
+        weights[i] = INDEX_WEIGHTS[indices[i]];
+    if (error > 0 && leastSquaresEndpoints(rgba, 3, weights, end, start))
+    {
+        unsigned char refined[8], refinedIndices[16];
+        if (encodeColorEndpoints(rgba, packRGB565(end), packRGB565(start), refined, refinedIndices) < error)
+            memcpy(block, refined, 8);
+    }
+}
+
+void compressBlockBC1(const unsigned char* rgba, unsigned char* block) {
+    compressColorBlock(rgba, block);
+}
+
+// Eight alpha values for a0 > a1, six plus 0 and 255 otherwise
+static void alphaPalette(int alpha0, int alpha1, int* palette) {
+    palette[0] = alpha0;
+    palette[1] = alpha1;
+    if (alpha0 > alpha1)
+    {
+        for (int k = 2; k < 8; k++)
+            palette[k] = ((8 - k) * alpha0 + (k - 1) * alpha1 + 3) / 7;
+    }
+    else
+    {
+        for (int k = 2; k < 6; k++)
+            palette[k] = ((6 - k) * alpha0 + (k - 1) * alpha1 + 2) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+void compressBlockBC3(const unsigned char* rgba, unsigned char* block) {
+    int minimum = 255, maximum = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        minimum = std::min(minimum, (int)rgba[i * 4 + 3]);
+        maximum = std::max(maximum, (int)rgba[i * 4 + 3]);
+    }
+    int palette[8];
+    alphaPalette(maximum, minimum, palette);
+    unsigned long long bits = 0;
+    for (int i = 0; i < 16 && maximum > minimum; i++)
+    {
+        int best = 0;
+        for (int k = 1; k < 8; k++)
+            if (abs(rgba[i * 4 + 3] - palette[k]) < abs(rgba[i * 4 + 3] - palette[best]))
+                best = k;
+        bits |= (unsigned long long)best << (i * 3);
+    }
+    block[0] = maximum;
+    block[1] = minimum;
+    for (int i = 0; i < 6; i++)
+        block[2 + i] = bits >> (i * 8) & 0xFF;
+    compressColorBlock(rgba, block + 8);
+}
+
+// BC7 fields are packed from the least significant bit of byte 0 upwards
+static void writeBits(unsigned char* block, int& position, unsigned int value, int count) {
+    for (int i = 0; i < count; i++, position++)
+        if (value >> i & 1)
+            block[position >> 3] |= 1 << (position & 7);
+}
+
+static unsigned int readBits(const unsigned char* block, int& position, int count) {
+    unsigned int value = 0;
+    for (int i = 0; i < count; i++, position++)
+        value |= (block[position >> 3] >> (position & 7) & 1) << i;
+    return value;
+}
+
+static const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Mode 6 endpoint: 7 bits per channel plus a p-bit shared by the channels
+struct Bc7Endpoint {
+    int channels[4];
+    int pBit;
+};
+
+static Bc7Endpoint quantizeBc7Endpoint(const float* color) {
+    Bc7Endpoint best = {};
+    float bestError = 1e30f;
+    for (int pBit = 0; pBit < 2; pBit++)
+    {
+        Bc7Endpoint endpoint;
+        endpoint.pBit = pBit;
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++)
+        {
+            endpoint.channels[c] = std::min(127, std::max(0, (int)((color[c] - pBit) * 0.5f + 0.5f)));
+            float delta = (endpoint.channels[c] << 1 | pBit) - color[c];
+            error += delta * delta;
+        }
+        if (error < bestError)
+        {
+            best = endpoint;
+            bestError = error;
+        }
+    }
+    return best;
+}
+
+// Chooses indices for two quantized endpoints, returns the squared error
+static int bc7Indices(const unsigned char* rgba, const Bc7Endpoint& start, const Bc7Endpoint& end, unsigned char* indices) {
+    int palette[16][4];
+    for (int k = 0; k < 16; k++)
+        for (int c = 0; c < 4; c++)
+        {
+            int a = start.channels[c] << 1 | start.pBit, b = end.channels[c] << 1 | end.pBit;
+            palette[k][c] = ((64 - BC7_WEIGHTS4[k]) * a + BC7_WEIGHTS4[k] * b + 32) >> 6;
+        }
+    int error = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0, bestError = 1 << 30;
+        for (int k = 0; k < 16; k++)
+        {
+            int distance = 0;
+            for (int c = 0; c < 4; c++)
+            {
+                int delta = rgba[i * 4 + c] - palette[k][c];
+                distance += delta * delta;
+            }
+            if (distance < bestError)
+            {
+                best = k;
+                bestError = distance;
+            }
+        }
+        indices[i] = best;
+        error += bestError;
+    }
+    return error;
+}
+
+void compressBlockBC7(const unsigned char* rgba, unsigned char* block) {
+    float startColor[4], endColor[4];
+    axisEndpoints(rgba, 4, startColor, endColor);
+    Bc7Endpoint start = quantizeBc7Endpoint(startColor), end = quantizeBc7Endpoint(endColor);
+    unsigned char indices[16];
+    int error = bc7Indices(rgba, start, end, indices);
+
+    float weights[16];
+    for (int i = 0; i < 16; i++)
+        weights[i] = BC7_WEIGHTS4[indices[i]] / 64.0f;
+    if (error > 0 && leastSquaresEndpoints(rgba, 4, weights, startColor, endColor))
+    {
+        Bc7Endpoint refinedStart = quantizeBc7Endpoint(startColor), refinedEnd = quantizeBc7Endpoint(endColor);
+        unsigned char refinedIndices[16];
+        if (bc7Indices(rgba, refinedStart, refinedEnd, refinedIndices) < error)
+        {
+            start = refinedStart;
+            end = refinedEnd;
+            memcpy(indices, refinedIndices, 16);
+        }
+    }
+
+    // The first index is stored without its top bit, which must be zero
+    if (indices[0] & 8)
+    {
+        std::swap(start, end);
+        for (int i = 0; i < 16; i++)
+            indices[i] = 15 - indices[i];
+    }
+    memset(block, 0, 16);
+    int position = 0;
+    writeBits(block, position, 1 << 6, 7);
+    for (int c = 0; c < 4; c++)
+    {
+        writeBits(block, position, start.channels[c], 7);
+        writeBits(block, position, end.channels[c], 7);
+    }
+    writeBits(block, position, start.pBit, 1);
+    writeBits(block, position, end.pBit, 1);
+    writeBits(block, position, indices[0], 3);
+    for (int i = 1; i < 16; i++)
+        writeBits(block, position, indices[i], 4);
+}
+
+void decompressBlockBC1(const unsigned char* block, unsigned char* rgba) {
+    unsigned short color0 = block[0] | block[1] << 8, color1 = block[2] | block[3] << 8;
+    int palette[4][4];
+    unpackRGB565(color0, palette[0]);
+    unpackRGB565(color1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        if (color0 > color1)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+        }
+        else
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c] + 1) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    palette[0][3] = palette[1][3] = palette[2][3] = 255;
+    palette[3][3] = color0 > color1 ? 255 : 0;
+    unsigned int bits = block[4] | block[5] << 8 | block[6] << 16 | (unsigned int)block[7] << 24;
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++)
+            rgba[i * 4 + c] = palette[bits >> (i * 2) & 3][c];
+}
+
+void decompressBlockBC3(const unsigned char* block, unsigned char* rgba) {
+    // Color is always four color mode here, whatever the endpoint order
+    int palette[4][3];
+    colorPalette(block[8] | block[9] << 8, block[10] | block[11] << 8, palette);
+    unsigned int colorBits = block[12] | block[13] << 8 | block[14] << 16 | (unsigned int)block[15] << 24;
+    int alphas[8];
+    alphaPalette(block[0], block[1], alphas);
+    unsigned long long alphaBits = 0;
+    for (int i = 0; i < 6; i++)
+        alphaBits |= (unsigned long long)block[2 + i] << (i * 8);
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 3; c++)
+            rgba[i * 4 + c] = palette[colorBits >> (i * 2) & 3][c];
+        rgba[i * 4 + 3] = alphas[alphaBits >> (i * 3) & 7];
+    }
+}
+
+void decompressBlockBC7(const unsigned char* block, unsigned char* rgba) {
+    if ((block[0] & 0x7F) != 0x40)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            rgba[i * 4 + 0] = 255;
+            rgba[i * 4 + 1] = 0;
+            rgba[i * 4 + 2] = 255;
+            rgba[i * 4 + 3] = 255;
+        }
+        return;
+    }
+    int position = 7;
+    int endpoints[2][4];
+    for (int c = 0; c < 4; c++)
+    {
+        endpoints[0][c] = readBits(block, position, 7);
+        endpoints[1][c] = readBits(block, position, 7);
+    }
+    int pBits[2];
+    pBits[0] = readBits(block, position, 1);
+    pBits[1] = readBits(block, position, 1);
+    for (int e = 0; e < 2; e++)
+        for (int c = 0; c < 4; c++)
+            endpoints[e][c] = endpoints[e][c] << 1 | pBits[e];
+    for (int i = 0; i < 16; i++)
+    {
+        int weight = BC7_WEIGHTS4[readBits(block, position, i == 0 ? 3 : 4)];
+        for (int c = 0; c < 4; c++)
+            rgba[i * 4 + c] = ((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6;
+    }
+}
+
+void compressImage(TextureFormat format, const unsigned char* rgba, int width, int height, unsigned char* output) {
+    if (format == TEXTURE_FORMAT_RGBA8)
+    {
+        memcpy(output, rgba, (size_t)width * height * 4);
+        return;
+    }
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    int blockBytes = textureBlockBytes(format);
+    unsigned char pixels[64];
+    for (int by = 0; by < blocksY; by++)
+    {
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            for (int y = 0; y < 4; y++)
+                for (int x = 0; x < 4; x++)
+                {
+                    int sx = std::min(bx * 4 + x, width - 1), sy = std::min(by * 4 + y, height - 1);
+                    memcpy(&pixels[(y * 4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+                }
+            unsigned char* block = output + ((size_t)by * blocksX + bx) * blockBytes;
+            if (format == TEXTURE_FORMAT_BC1)
+                compressBlockBC1(pixels, block);
+            else if (format == TEXTURE_FORMAT_BC3)
+                compressBlockBC3(pixels, block);
+            else
+                compressBlockBC7(pixels, block);
+        }
+    }
+}
+
+void decompressImage(TextureFormat format, const unsigned char* data, int width, int height, unsigned char* rgba) {
+    if (format == TEXTURE_FORMAT_RGBA8)
+    {
+        memcpy(rgba, data, (size_t)width * height * 4);
+        return;
+    }
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    int blockBytes = textureBlockBytes(format);
+    unsigned char pixels[64];
+    for (int by = 0; by < blocksY; by++)
+    {
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            const unsigned char* block = data + ((size_t)by * blocksX + bx) * blockBytes;
+            if (format == TEXTURE_FORMAT_BC1)
+                decompressBlockBC1(block, pixels);
+            else if (format == TEXTURE_FORMAT_BC3)
+                decompressBlockBC3(block, pixels);
+            else
+                decompressBlockBC7(block, pixels);
+            for (int y = 0; y < 4 && by * 4 + y < height; y++)
+                for (int x = 0; x < 4 && bx * 4 + x < width; x++)
+                    memcpy(&rgba[((size_t)(by * 4 + y) * width + bx * 4 + x) * 4], &pixels[(y * 4 + x) * 4], 4);
+        }
+    }
+}
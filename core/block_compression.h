@@ -0,0 +1,41 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <stddef.h>
+
+// Pixel formats of texture levels. The BC formats store 4x4 pixel blocks:
+// BC1 8 bytes (RGB, 4 bits per pixel), BC3 and BC7 16 bytes (RGBA, 8 bits
+// per pixel), so they take 1/8 and 1/4 the memory of RGBA8.
+enum TextureFormat {
+    TEXTURE_FORMAT_RGBA8,
+    TEXTURE_FORMAT_BC1,
+    TEXTURE_FORMAT_BC3,
+    TEXTURE_FORMAT_BC7,
+    TEXTURE_FORMAT_COUNT
+};
+
+const char* textureFormatName(TextureFormat format);
+// 1 for RGBA8, 4 for the block formats
+int textureBlockSize(TextureFormat format);
+// Bytes per block (per pixel for RGBA8)
+int textureBlockBytes(TextureFormat format);
+size_t textureLevelSize(TextureFormat format, int width, int height);
+
+// 4x4 blocks of RGBA8 pixels, 64 bytes row by row. BC1 and BC3 colors are
+// fit along the principal axis of the block's colors and refined once by
+// least squares; BC3 alpha uses the 8 value mode between the block's
+// extremes. BC7 blocks are always mode 6 (one RGBA line, 4 bit indices).
+void compressBlockBC1(const unsigned char* rgba, unsigned char* block);
+void compressBlockBC3(const unsigned char* rgba, unsigned char* block);
+void compressBlockBC7(const unsigned char* rgba, unsigned char* block);
+void decompressBlockBC1(const unsigned char* block, unsigned char* rgba);
+void decompressBlockBC3(const unsigned char* block, unsigned char* rgba);
+// Mode 6 only, what compressBlockBC7 writes; other modes decode magenta
+void decompressBlockBC7(const unsigned char* block, unsigned char* rgba);
+
+// Whole levels, output sized by textureLevelSize. Blocks past the right or
+// bottom edge repeat the last column or row.
+void compressImage(TextureFormat format, const unsigned char* rgba, int width, int height, unsigned char* output);
+void decompressImage(TextureFormat format, const unsigned char* data, int width, int height, unsigned char* rgba);
+
+#endif
@@ -0,0 +1,406 @@
+#include "bvh.h"
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+static const int BIN_COUNT = 16;
+static const unsigned int MAX_LEAF_OBJECTS = 4;
+// SAH cost of visiting a node relative to testing one object
+static const float TRAVERSAL_COST = 1.0f;
+// Traversals pop a node and push at most its two children, so their stack
+// holds at most one pending node per level plus the two just pushed:
+// MAX_DEPTH + 1 entries. Nodes at MAX_DEPTH stay leaves however many
+// objects they have, so a lopsided tree never overflows the stack.
+static const int STACK_SIZE = 64;
+static const unsigned int MAX_DEPTH = STACK_SIZE - 1;
+
+static float halfArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    glm::vec3 size = boundsMax - boundsMin;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+struct Bin {
+    Aabb bounds;
+    unsigned int count;
+};
+
+static void growBounds(Aabb& bounds, const Aabb& other) {
+    bounds.min = glm::min(bounds.min, other.min);
+    bounds.max = glm::max(bounds.max, other.max);
+}
+
+static Aabb emptyBounds() {
+    Aabb bounds;
+    bounds.min = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    bounds.max = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    return bounds;
+}
+
+static bool finiteBounds(const Aabb& bounds) {
+    for (int k = 0; k < 3; k++)
+        if (!isfinite(bounds.min[k]) || !isfinite(bounds.max[k]))
+            return false;
+    return true;
+}
+
+static void computeNodeBounds(Bvh& bvh, BvhNode& node) {
+    Aabb bounds = emptyBounds();
+    for (unsigned int i = 0; i < node.objectCount; i++)
+        growBounds(bounds, bvh.objectBounds[bvh.objectIndices[node.leftOrFirst + i]]);
+    node.boundsMin = bounds.min;
+    node.boundsMax = bounds.max;
+}
+
+// Finds the cheapest binned split of a leaf, returns false when keeping the leaf is cheaper
+static bool findSplit(const Bvh& bvh, const BvhNode& node, const std::vector<glm::vec3>& centroids,
+                      int& splitAxis, float& splitPosition) {
+    glm::vec3 centroidMin(FLT_MAX, FLT_MAX, FLT_MAX), centroidMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (unsigned int i = 0; i < node.objectCount; i++)
+    {
+        const glm::vec3& centroid = centroids[bvh.objectIndices[node.leftOrFirst + i]];
+        centroidMin = glm::min(centroidMin, centroid);
+        centroidMax = glm::max(centroidMax, centroid);
+    }
+
+    float bestCost = FLT_MAX;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = centroidMax[axis] - centroidMin[axis];
+        if (!(extent > 0.0f && extent < FLT_MAX))
+            continue;
+
+        Bin bins[BIN_COUNT];
+        for (int b = 0; b < BIN_COUNT; b++)
+        {
+            bins[b].bounds = emptyBounds();
+            bins[b].count = 0;
+        }
+        float scale = BIN_COUNT / extent;
+        for (unsigned int i = 0; i < node.objectCount; i++)
+        {
+            unsigned int object = bvh.objectIndices[node.leftOrFirst + i];
+            // Clamped on both ends before the conversion, a float outside int range is undefined
+            float bin = (centroids[object][axis] - centroidMin[axis]) * scale;
+            int b = bin > 0.0f ? (int)std::min(bin, (float)(BIN_COUNT - 1)) : 0;
+            bins[b].count++;
+            growBounds(bins[b].bounds, bvh.objectBounds[object]);
+        }
+
+        // Sweep from both sides, plane i splits after bin i
+        float leftArea[BIN_COUNT - 1], rightArea[BIN_COUNT - 1];
+        unsigned int leftCount[BIN_COUNT - 1], rightCount[BIN_COUNT - 1];
+        Aabb leftBounds = emptyBounds(), rightBounds = emptyBounds();
+        unsigned int leftSum = 0, rightSum = 0;
+        for (int i = 0; i < BIN_COUNT - 1; i++)
+        {
+            leftSum += bins[i].count;
+            growBounds(leftBounds, bins[i].bounds);
+            leftCount[i] = leftSum;
+            leftArea[i] = leftSum ? halfArea(leftBounds.min, leftBounds.max) : 0.0f;
+
+            rightSum += bins[BIN_COUNT - 1 - i].count;
+            growBounds(rightBounds, bins[BIN_COUNT - 1 - i].bounds);
+            rightCount[BIN_COUNT - 2 - i] = rightSum;
+            rightArea[BIN_COUNT - 2 - i] = rightSum ? halfArea(rightBounds.min, rightBounds.max) : 0.0f;
+        }
+        for (int i = 0; i < BIN_COUNT - 1; i++)
+        {
+            float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+            if (leftCount[i] > 0 && rightCount[i] > 0 && cost < bestCost)
+            {
+                bestCost = cost;
+                splitAxis = axis;
+                splitPosition = centroidMin[axis] + (i + 1) / scale;
+            }
+        }
+    }
+
+    float leafCost = node.objectCount * halfArea(node.boundsMin, node.boundsMax);
+    float splitCost = TRAVERSAL_COST * halfArea(node.boundsMin, node.boundsMax) + bestCost;
+    return bestCost < FLT_MAX && (splitCost < leafCost || node.objectCount > MAX_LEAF_OBJECTS);
+}
+
+void setBvhObjectBounds(Bvh& bvh, const CullingBounds& bounds) {
+    bvh.objectBounds.resize(bounds.size());
+    for (size_t i = 0; i < bounds.size(); i++)
+    {
+        glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+        glm::vec3 extent(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+        bvh.objectBounds[i].min = center - extent;
+        bvh.objectBounds[i].max = center + extent;
+    }
+}
+
+void buildBvh(Bvh& bvh) {
+    size_t objectCount = bvh.objectBounds.size();
+    bvh.nodes.clear();
+    bvh.objectIndices.resize(objectCount);
+    bvh.refitsSinceBuild = 0;
+    if (objectCount == 0)
+    {
+        bvh.builtCost = 0.0f;
+        return;
+    }
+
+    // Objects with NaN or infinite bounds go after the ones in the tree, no
+    // node references them
+    std::vector<glm::vec3> centroids(objectCount);
+    size_t treeObjects = 0;
+    for (size_t i = 0; i < objectCount; i++)
+    {
+        const Aabb& bounds = bvh.objectBounds[i];
+        bvh.objectIndices[i] = i;
+        centroids[i] = bounds.min * 0.5f + bounds.max * 0.5f;
+        if (finiteBounds(bounds))
+            std::swap(bvh.objectIndices[i], bvh.objectIndices[treeObjects++]);
+    }
+    if (treeObjects == 0)
+    {
+        bvh.builtCost = 0.0f;
+        return;
+    }
+
+    bvh.nodes.reserve(treeObjects * 2);
+    BvhNode root;
+    root.leftOrFirst = 0;
+    root.objectCount = treeObjects;
+    computeNodeBounds(bvh, root);
+    bvh.nodes.push_back(root);
+
+    std::vector<std::pair<unsigned int, unsigned int> > pending(1, std::make_pair(0u, 0u)); // node, depth
+    while (!pending.empty())
+    {
+        unsigned int nodeIndex = pending.back().first;
+        unsigned int depth = pending.back().second;
+        pending.pop_back();
+
+        int axis = 0;
+        float position = 0.0f;
+        if (depth == MAX_DEPTH || !findSplit(bvh, bvh.nodes[nodeIndex], centroids, axis, position))
+            continue;
+
+        // Partition the node's objects in place around the split plane
+        BvhNode node = bvh.nodes[nodeIndex];
+        unsigned int* first = &bvh.objectIndices[node.leftOrFirst];
+        unsigned int* middle = std::partition(first, first + node.objectCount,
+            [&](unsigned int object) { return centroids[object][axis] < position; });
+        unsigned int leftCount = middle - first;
+        if (leftCount == 0 || leftCount == node.objectCount)
+            continue;
+
+        BvhNode left, right;
+        left.leftOrFirst = node.leftOrFirst;
+        left.objectCount = leftCount;
+        right.leftOrFirst = node.leftOrFirst + leftCount;
+        right.objectCount = node.objectCount - leftCount;
+        computeNodeBounds(bvh, left);
+        computeNodeBounds(bvh, right);
+
+        unsigned int leftIndex = bvh.nodes.size();
+        bvh.nodes[nodeIndex].leftOrFirst = leftIndex;
+        bvh.nodes[nodeIndex].objectCount = 0;
+        bvh.nodes.push_back(left);
+        bvh.nodes.push_back(right);
+        pending.push_back(std::make_pair(leftIndex, depth + 1));
+        pending.push_back(std::make_pair(leftIndex + 1, depth + 1));
+    }
+    bvh.builtCost = bvhCost(bvh);
+}
+
+void refitBvh(Bvh& bvh) {
+    // Children come after their parents, so a reverse sweep sees them first
+    for (size_t i = bvh.nodes.size(); i-- > 0;)
+    {
+        BvhNode& node = bvh.nodes[i];
+        if (node.objectCount > 0)
+        {
+            computeNodeBounds(bvh, node);
+            continue;
+        }
+        const BvhNode& left = bvh.nodes[node.leftOrFirst];
+        const BvhNode& right = bvh.nodes[node.leftOrFirst + 1];
+        node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+        node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+    }
+    bvh.refitsSinceBuild++;
+}
+
+bool updateBvh(Bvh& bvh) {
+    if (bvh.objectIndices.size() != bvh.objectBounds.size() || bvh.refitsSinceBuild >= bvh.maxRefits)
+    {
+        buildBvh(bvh);
+        return true;
+    }
+    refitBvh(bvh);
+    // A NaN cost (an object's bounds stopped being finite) rebuilds too
+    if (!(bvhCost(bvh) <= bvh.builtCost * bvh.rebuildThreshold))
+    {
+        buildBvh(bvh);
+        return true;
+    }
+    return false;
+}
+
+float bvhCost(const Bvh& bvh) {
+    if (bvh.nodes.empty())
+        return 0.0f;
+    float rootArea = halfArea(bvh.nodes[0].boundsMin, bvh.nodes[0].boundsMax);
+    if (rootArea <= 0.0f)
+        return 0.0f;
+    float cost = 0.0f;
+    for (size_t i = 0; i < bvh.nodes.size(); i++)
+    {
+        const BvhNode& node = bvh.nodes[i];
+        float area = halfArea(node.boundsMin, node.boundsMax);
+        cost += node.objectCount > 0 ? node.objectCount * area : TRAVERSAL_COST * area;
+    }
+    return cost / rootArea;
+}
+
+// Classifies a box against the planes still set in planeMask, clears the
+// planes the box is completely inside of. Returns false when it's outside one.
+static bool classifyBox(const Frustum& frustum, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                        unsigned int& planeMask) {
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+    for (int p = 0; p < 6; p++)
+    {
+        if (!(planeMask & (1u << p)))
+            continue;
+        const glm::vec4& plane = frustum.planes[p];
+        float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        float reach = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+        if (distance + reach < 0.0f)
+            return false;
+        if (distance - reach >= 0.0f)
+            planeMask &= ~(1u << p);
+    }
+    return true;
+}
+
+void queryBvhFrustum(const Bvh& bvh, const Frustum& frustum, std::vector<unsigned int>& objects) {
+    if (bvh.nodes.empty())
+        return;
+    unsigned int stack[STACK_SIZE * 2]; // node, plane mask pairs
+    int top = 0;
+    stack[top++] = 0;
+    stack[top++] = 0x3F;
+    while (top > 0)
+    {
+        unsigned int planeMask = stack[--top];
+        const BvhNode& node = bvh.nodes[stack[--top]];
+        if (planeMask && !classifyBox(frustum, node.boundsMin, node.boundsMax, planeMask))
+            continue;
+
+        if (node.objectCount > 0)
+        {
+            for (unsigned int i = 0; i < node.objectCount; i++)
+            {
+                unsigned int object = bvh.objectIndices[node.leftOrFirst + i];
+                unsigned int objectMask = planeMask;
+                const Aabb& bounds = bvh.objectBounds[object];
+                if (!objectMask || classifyBox(frustum, bounds.min, bounds.max, objectMask))
+                    objects.push_back(object);
+            }
+            continue;
+        }
+        stack[top++] = node.leftOrFirst;
+        stack[top++] = planeMask;
+        stack[top++] = node.leftOrFirst + 1;
+        stack[top++] = planeMask;
+    }
+}
+
+// Slab test, returns the entry distance or FLT_MAX on a miss
+static float intersectBox(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance,
+                          const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+    glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+    glm::vec3 nearest = glm::min(t0, t1), farthest = glm::max(t0, t1);
+    float entry = std::max(std::max(nearest.x, nearest.y), std::max(nearest.z, 0.0f));
+    float exit = std::min(std::min(farthest.x, farthest.y), std::min(farthest.z, maxDistance));
+    return entry <= exit ? entry : FLT_MAX;
+}
+
+bool raycastBvh(const Bvh& bvh, const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                unsigned int& object, float& distance) {
+    if (bvh.nodes.empty())
+        return false;
+    glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    float closest = maxDistance;
+    bool hit = false;
+
+    unsigned int stack[STACK_SIZE];
+    int top = 0;
+    if (intersectBox(origin, inverseDirection, closest, bvh.nodes[0].boundsMin, bvh.nodes[0].boundsMax) < FLT_MAX)
+        stack[top++] = 0;
+    while (top > 0)
+    {
+        const BvhNode& node = bvh.nodes[stack[--top]];
+        if (node.objectCount > 0)
+        {
+            for (unsigned int i = 0; i < node.objectCount; i++)
+            {
+                unsigned int candidate = bvh.objectIndices[node.leftOrFirst + i];
+                const Aabb& bounds = bvh.objectBounds[candidate];
+                float t = intersectBox(origin, inverseDirection, closest, bounds.min, bounds.max);
+                if (t < FLT_MAX)
+                {
+                    closest = t;
+                    object = candidate;
+                    hit = true;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first, skip children behind the closest hit
+        unsigned int left = node.leftOrFirst, right = node.leftOrFirst + 1;
+        float leftDistance = intersectBox(origin, inverseDirection, closest, bvh.nodes[left].boundsMin, bvh.nodes[left].boundsMax);
+        float rightDistance = intersectBox(origin, inverseDirection, closest, bvh.nodes[right].boundsMin, bvh.nodes[right].boundsMax);
+        if (leftDistance > rightDistance)
+        {
+            std::swap(left, right);
+            std::swap(leftDistance, rightDistance);
+        }
+        if (rightDistance < FLT_MAX)
+            stack[top++] = right;
+        if (leftDistance < FLT_MAX)
+            stack[top++] = left;
+    }
+    if (hit)
+        distance = closest;
+    return hit;
+}
+
+void queryBvhSphere(const Bvh& bvh, const glm::vec3& center, float radius, std::vector<unsigned int>& objects) {
+    if (bvh.nodes.empty())
+        return;
+    float radiusSquared = radius * radius;
+    unsigned int stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const BvhNode& node = bvh.nodes[stack[--top]];
+        glm::vec3 closestPoint = glm::clamp(center, node.boundsMin, node.boundsMax);
+        glm::vec3 offset = closestPoint - center;
+        if (glm::dot(offset, offset) > radiusSquared)
+            continue;
+
+        if (node.objectCount > 0)
+        {
+            for (unsigned int i = 0; i < node.objectCount; i++)
+            {
+                unsigned int object = bvh.objectIndices[node.leftOrFirst + i];
+                const Aabb& bounds = bvh.objectBounds[object];
+                glm::vec3 objectOffset = glm::clamp(center, bounds.min, bounds.max) - center;
+                if (glm::dot(objectOffset, objectOffset) <= radiusSquared)
+                    objects.push_back(object);
+            }
+            continue;
+        }
+        stack[top++] = node.leftOrFirst;
+        stack[top++] = node.leftOrFirst + 1;
+    }
+}
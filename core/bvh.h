@@ -0,0 +1,59 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "frustum_culling.h"
+
+struct Aabb {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// 32 byte node. Inner nodes have objectCount 0 and their children at
+// leftOrFirst and leftOrFirst + 1, leaves own objectIndices[leftOrFirst ...
+// leftOrFirst + objectCount). Children always come after their parent.
+struct BvhNode {
+    glm::vec3 boundsMin;
+    unsigned int leftOrFirst;
+    glm::vec3 boundsMax;
+    unsigned int objectCount;
+};
+
+// Bounding volume hierarchy over object AABBs, built top down with binned
+// SAH. Moving objects only need their entry in objectBounds updated and a
+// call to updateBvh: the tree is refitted bottom up, and rebuilt when the
+// refitted tree's SAH cost drifted too far from a fresh build's or after
+// maxRefits refits. Objects whose bounds aren't finite are left out of the
+// tree, queries never return them.
+struct Bvh {
+    std::vector<Aabb> objectBounds;     // input, indexed by object
+    std::vector<BvhNode> nodes;
+    std::vector<unsigned int> objectIndices;
+    float builtCost = 0.0f;             // SAH cost right after the last build
+    int refitsSinceBuild = 0;
+    float rebuildThreshold = 1.3f;      // rebuild when cost > builtCost * threshold
+    int maxRefits = 300;
+};
+
+// Replaces objectBounds with the boxes of culling bounds, keeping the tree
+void setBvhObjectBounds(Bvh& bvh, const CullingBounds& bounds);
+
+void buildBvh(Bvh& bvh);
+void refitBvh(Bvh& bvh);
+// Refits, rebuilds if the tree degraded or the object count changed.
+// Returns true when it rebuilt.
+bool updateBvh(Bvh& bvh);
+// SAH cost relative to the root's surface area, lower is better
+float bvhCost(const Bvh& bvh);
+
+// Appends the objects whose box intersects the frustum. Subtrees completely
+// inside are added without testing their objects.
+void queryBvhFrustum(const Bvh& bvh, const Frustum& frustum, std::vector<unsigned int>& objects);
+// Closest object whose box the ray enters within maxDistance, for picking
+bool raycastBvh(const Bvh& bvh, const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                unsigned int& object, float& distance);
+// Appends the objects whose box intersects the sphere
+void queryBvhSphere(const Bvh& bvh, const glm::vec3& center, float radius, std::vector<unsigned int>& objects);
+
+#endif
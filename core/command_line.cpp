@@ -0,0 +1,267 @@
+#include "command_line.h"
+#include "block_compression.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void printUsage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --headless        render offscreen without opening a window\n"
+        "  --software        render headless frames with the CPU rasterizer, no GPU or GL needed\n"
+        "  --threads N       job system workers and software rasterizer threads (default one per hardware thread)\n"
+        "  --frames N        number of frames to render in headless/benchmark mode (default 60)\n"
+        "  --size WxH        render resolution (default 640x480)\n"
+        "  --output DIR      write each headless frame to DIR/frame_NNNN.ppm\n"
+        "  --benchmark       replay a scripted camera path with vsync off and record frame times\n"
+        "  --warmup N        frames to skip before recording benchmark samples (default 10)\n"
+        "  --benchmark-out F write benchmark results to F, .json or .csv (default benchmark.csv)\n"
+        "  --mesh FILE       draw a .mesh cache next to the cube\n"
+        "  --convert-mesh IN OUT\n"
+        "                    convert a model (e.g. models/suzanne.obj) into a .mesh cache and exit\n"
+        "  --compact-vertices\n"
+        "                    use the quantized 20 byte vertex format (cube and --convert-mesh output)\n"
+        "  --obj-benchmark FILE\n"
+        "                    report OBJ parsing throughput in MB/s (uses --frames as iteration count)\n"
+        "  --instances N     draw a grid of N cubes with a single instanced draw call\n"
+        "  --multi-draw      pack meshes into one buffer and draw them with glMultiDrawElementsIndirect\n"
+        "                    (a loop of draws on GL 4.1), --instances cubes become separate draws\n"
+        "  --no-culling      draw every object without frustum culling\n"
+        "  --cull-benchmark N\n"
+        "                    time frustum culling of N objects (uses --frames as iteration count)\n"
+        "  --bvh-culling     frustum cull through a bounding volume hierarchy refitted every frame\n"
+        "  --occlusion-culling\n"
+        "                    also cull objects hidden behind the nearest cubes (CPU depth buffer)\n"
+        "  --bvh-benchmark N\n"
+        "                    time BVH build, refit and frustum/ray/sphere queries at 10k, 100k, ...\n"
+        "                    up to N objects (uses --frames as iteration count)\n"
+        "  --texture FILE    texture of the cubes, an image or a .tex (default textures/cat.jpg)\n"
+        "  --convert-texture IN OUT\n"
+        "                    bake an image and its mip chain into a .tex with GPU block compression and exit\n"
+        "  --texture-format rgba8|bc1|bc3|bc7\n"
+        "                    format of --convert-texture (default bc1, bc3 if the image has alpha)\n"
+        "  --mip-filter box|kaiser\n"
+        "                    mip filter of --convert-texture (default kaiser)\n"
+        "  --linear-texture  --texture or --convert-texture input is data, not sRGB color: filter it\n"
+        "                    without gamma\n"
+        "  --mip-benchmark   report mip chain generation of --texture in Mpixel/s, box and Kaiser, SIMD\n"
+        "                    and scalar, on one and on --threads workers (uses --frames as iteration count)\n"
+        "  --atlas A,B,...   pack the images into texture array pages and draw every material from them,\n"
+        "                    the cubes use A and the --mesh model B (or A again)\n"
+        "  --texture-budget MB\n"
+        "                    GPU memory for streamed textures before least recently used ones are evicted\n"
+        "                    (default 256)\n"
+        "  --texture-benchmark N\n"
+        "                    stream N copies of --texture headless and report how long requests,\n"
+        "                    first levels and full residency take (at most --frames frames)\n"
+        "  --no-pipeline     simulate each frame right before drawing it instead of on a worker while\n"
+        "                    the previous frame is drawn\n"
+        "  --job-benchmark   render headless frames with 1, 2, 4, ... job system workers and report\n"
+        "                    CPU time per frame for each (default 10000 --instances)\n",
+        program);
+}
+
+bool parseCommandLine(int argc, char** argv, LaunchOptions& options) {
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (strcmp(arg, "--headless") == 0)
+        {
+            options.headless = true;
+        }
+        else if (strcmp(arg, "--software") == 0)
+        {
+            options.software = true;
+        }
+        else if (strcmp(arg, "--threads") == 0 && hasValue)
+        {
+            options.threadCount = atoi(argv[++i]);
+            if (options.threadCount <= 0)
+            {
+                printUsage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--frames") == 0 && hasValue)
+        {
+            options.frameCount = atoi(argv[++i]);
+            if (options.frameCount <= 0)
+            {
+                printUsage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--size") == 0 && hasValue)
+        {
+            if (sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2 ||
+                options.width <= 0 || options.height <= 0)
+            {
+                printUsage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--output") == 0 && hasValue)
+        {
+            options.outputDir = argv[++i];
+        }
+        else if (strcmp(arg, "--benchmark") == 0)
+        {
+            options.benchmark = true;
+        }
+        else if (strcmp(arg, "--warmup") == 0 && hasValue)
+        {
+            options.warmupFrames = atoi(argv[++i]);
+            if (options.warmupFrames < 0)
+            {
+                printUsage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--benchmark-out") == 0 && hasValue)
+        {
+            options.benchmarkOutput = argv[++i];
+        }
+        else if (strcmp(arg, "--mesh") == 0 && hasValue)
+        {
+            options.meshFile = argv[++i];
+        }
+        else if (strcmp(arg, "--convert-mesh") == 0 && i + 2 < argc)
+        {
+            options.convertInput = argv[++i];
+            options.convertOutput = argv[++i];
+        }
+        else if (strcmp(arg, "--obj-benchmark") == 0 && hasValue)
+        {
+            options.objBenchmarkFile = argv[++i];
+        }
+        else if (strcmp(arg, "--compact-vertices") == 0)
+        {
+            options.compactVertices = true;
+        }
+        else if (strcmp(arg, "--instances") == 0 && hasValue)
+        {
+            options.instanceCount = atoi(argv[++i]);
+            if (options.instanceCount < 0)
+            {
+                printUsage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--cull-benchmark") == 0 && hasValue)
+        {
+            options.cullBenchmarkObjects = atoi(argv[++i]);
+            if (options.cullBenchmarkObjects <= 0)
+            {
+                printUsage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--bvh-benchmark") == 0 && hasValue)
+        {
+            options.bvhBenchmarkObjects = atoi(argv[++i]);
+            if (options.bvhBenchmarkObjects <= 0)
+            {
+                printUsage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--texture") == 0 && hasValue)
+        {
+            options.textureFile = argv[++i];
+        }
+        else if (strcmp(arg, "--convert-texture") == 0 && i + 2 < argc)
+        {
+            options.convertTextureInput = argv[++i];
+            options.convertTextureOutput = argv[++i];
+        }
+        else if (strcmp(arg, "--texture-format") == 0 && hasValue)
+        {
+            const char* name = argv[++i];
+            options.textureFormat = -1;
+            for (int format = 0; format < TEXTURE_FORMAT_COUNT; format++)
+                if (strcmp(name, textureFormatName((TextureFormat)format)) == 0)
+                    options.textureFormat = format;
+            if (options.textureFormat < 0)
+            {
+                printUsage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--mip-filter") == 0 && hasValue)
+        {
+            const char* name = argv[++i];
+            if (strcmp(name, "box") == 0)
+                options.mipFilter = MIP_FILTER_BOX;
+            else if (strcmp(name, "kaiser") == 0)
+                options.mipFilter = MIP_FILTER_KAISER;
+            else
+            {
+                printUsage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--linear-texture") == 0)
+        {
+            options.srgbTexture = false;
+        }
+        else if (strcmp(arg, "--atlas") == 0 && hasValue)
+        {
+            options.atlasFiles = argv[++i];
+        }
+        else if (strcmp(arg, "--mip-benchmark") == 0)
+        {
+            options.mipBenchmark = true;
+        }
+        else if (strcmp(arg, "--texture-budget") == 0 && hasValue)
+        {
+            int megabytes = atoi(argv[++i]);
+            if (megabytes <= 0)
+            {
+                printUsage(argv[0]);
+                return false;
+            }
+            options.textureBudget = (size_t)megabytes << 20;
+        }
+        else if (strcmp(arg, "--texture-benchmark") == 0 && hasValue)
+        {
+            options.textureBenchmarkCount = atoi(argv[++i]);
+            if (options.textureBenchmarkCount <= 0)
+            {
+                printUsage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--no-pipeline") == 0)
+        {
+            options.pipelined = false;
+        }
+        else if (strcmp(arg, "--job-benchmark") == 0)
+        {
+            options.jobBenchmark = true;
+        }
+        else if (strcmp(arg, "--bvh-culling") == 0)
+        {
+            options.bvhCulling = true;
+        }
+        else if (strcmp(arg, "--occlusion-culling") == 0)
+        {
+            options.occlusionCulling = true;
+        }
+        else if (strcmp(arg, "--no-culling") == 0)
+        {
+            options.frustumCulling = false;
+        }
+        else if (strcmp(arg, "--multi-draw") == 0)
+        {
+            options.multiDraw = true;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+
+#include <stddef.h>
+#include <string>
+#include "mip_chain.h"
+
+// Options picked on the command line, defaults give the interactive window.
+struct LaunchOptions {
+    bool headless = false;      // --headless: render offscreen, no window
+    bool software = false;      // --software: render on the CPU without any GL context
+    int threadCount = 0;        // --threads N: job system workers and software rasterizer threads, 0 is one per hardware thread
+    int frameCount = 60;        // --frames N: frames to render when headless or benchmarking
+    int width = 640;            // --size WxH
+    int height = 480;
+    std::string outputDir = ""; // --output DIR: write every frame as a PPM here
+    bool benchmark = false;     // --benchmark: scripted camera, vsync off, timings recorded
+    int warmupFrames = 10;      // --warmup N: frames rendered before recording starts
+    std::string benchmarkOutput = "benchmark.csv"; // --benchmark-out FILE (.csv or .json)
+    std::string meshFile = "";      // --mesh FILE: .mesh cache drawn next to the cube
+    std::string convertInput = "";  // --convert-mesh IN OUT: bake a model into a .mesh cache and exit
+    std::string convertOutput = "";
+    bool compactVertices = false;   // --compact-vertices: 20 byte quantized vertices for the cube and converted meshes
+    std::string objBenchmarkFile = "";  // --obj-benchmark FILE: measure OBJ parse throughput and exit
+    int instanceCount = 0;          // --instances N: draw a grid of N extra cubes with one instanced draw
+    int cullBenchmarkObjects = 0;   // --cull-benchmark N: measure frustum culling of N objects and exit
+    bool frustumCulling = true;     // --no-culling: submit every object, visible or not
+    bool bvhCulling = false;        // --bvh-culling: cull through a refitted BVH instead of testing every object
+    bool occlusionCulling = false;  // --occlusion-culling: drop objects hidden behind the nearest cubes
+    int bvhBenchmarkObjects = 0;    // --bvh-benchmark N: measure BVH build, refit and queries up to N objects and exit
+    size_t textureBudget = 256u << 20; // --texture-budget MB: GPU memory streamed textures may use before LRU eviction
+    std::string textureFile = "./textures/cat.jpg"; // --texture FILE: image or .tex texture of the cubes
+    std::string convertTextureInput = "";  // --convert-texture IN OUT: bake an image into a .tex and exit
+    std::string convertTextureOutput = "";
+    int textureFormat = -1;         // --texture-format NAME: TextureFormat of --convert-texture, -1 picks BC1 or BC3 by alpha
+    MipFilter mipFilter = MIP_FILTER_KAISER; // --mip-filter box|kaiser: filter of --convert-texture
+    bool srgbTexture = true;        // --linear-texture: the image holds data (normal maps, masks), not sRGB color
+    bool mipBenchmark = false;      // --mip-benchmark: measure mip chain generation of --texture and exit
+    std::string atlasFiles = "";    // --atlas A,B,...: images packed into a texture array, the cubes use A, the model B
+    int textureBenchmarkCount = 0;  // --texture-benchmark N: stream N textures headless, report load times and exit
+    bool pipelined = true;          // --no-pipeline: simulate each frame on the render thread right before drawing it
+    bool jobBenchmark = false;      // --job-benchmark: measure frame CPU time for growing worker counts and exit
+    bool multiDraw = false;         // --multi-draw: pack the scene's meshes into one buffer, draw with multi-draw indirect
+};
+
+// Returns false (after printing usage) when the arguments can't be parsed.
+bool parseCommandLine(int argc, char** argv, LaunchOptions& options);
+
+#endif
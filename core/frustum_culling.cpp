@@ -0,0 +1,244 @@
+#include "frustum_culling.h"
+#include <cmath>
+#include <algorithm>
+#include <string.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+void extractFrustum(const glm::mat4& viewProjection, Frustum& frustum) {
+    // glm is column major, row i of the matrix is m[0][i], m[1][i], ...
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+    frustum.planes[0] = rows[3] + rows[0]; // left
+    frustum.planes[1] = rows[3] - rows[0]; // right
+    frustum.planes[2] = rows[3] + rows[1]; // bottom
+    frustum.planes[3] = rows[3] - rows[1]; // top
+    frustum.planes[4] = rows[3] + rows[2]; // near
+    frustum.planes[5] = rows[3] - rows[2]; // far
+    for (int i = 0; i < 6; i++)
+    {
+        float length = glm::length(glm::vec3(frustum.planes[i]));
+        if (length > 0.0f)
+            frustum.planes[i] /= length;
+    }
+}
+
+void clearCullingBounds(CullingBounds& bounds) {
+    bounds.centerX.clear();
+    bounds.centerY.clear();
+    bounds.centerZ.clear();
+    bounds.extentX.clear();
+    bounds.extentY.clear();
+    bounds.extentZ.clear();
+    bounds.radius.clear();
+}
+
+void resizeCullingBounds(CullingBounds& bounds, size_t count) {
+    bounds.centerX.resize(count);
+    bounds.centerY.resize(count);
+    bounds.centerZ.resize(count);
+    bounds.extentX.resize(count);
+    bounds.extentY.resize(count);
+    bounds.extentZ.resize(count);
+    bounds.radius.resize(count);
+}
+
+void addCullingBounds(CullingBounds& bounds, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                      const glm::mat4& model) {
+    size_t index = bounds.size();
+    resizeCullingBounds(bounds, index + 1);
+    setCullingBounds(bounds, index, boundsMin, boundsMax, model);
+}
+
+void setCullingBounds(CullingBounds& bounds, size_t index, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                      const glm::mat4& model) {
+    glm::vec3 localCenter = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 localExtent = (boundsMax - boundsMin) * 0.5f;
+    glm::vec3 center = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+
+    // Arvo: the world box encloses the transformed box when every axis
+    // sums the absolute contributions of the local extents
+    glm::vec3 extent(0.0f, 0.0f, 0.0f);
+    float maxScale = 0.0f;
+    for (int column = 0; column < 3; column++)
+    {
+        glm::vec3 axis(model[column]);
+        extent += glm::vec3(fabsf(axis.x), fabsf(axis.y), fabsf(axis.z)) * localExtent[column];
+        maxScale = std::max(maxScale, glm::length(axis));
+    }
+
+    bounds.centerX[index] = center.x;
+    bounds.centerY[index] = center.y;
+    bounds.centerZ[index] = center.z;
+    bounds.extentX[index] = extent.x;
+    bounds.extentY[index] = extent.y;
+    bounds.extentZ[index] = extent.z;
+    bounds.radius[index] = glm::length(localExtent) * maxScale;
+}
+
+static inline bool insideFrustum(const Frustum& frustum, const CullingBounds& bounds, size_t i) {
+    for (int p = 0; p < 6; p++)
+    {
+        const glm::vec4& plane = frustum.planes[p];
+        float distance = plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i] + plane.z * bounds.centerZ[i] + plane.w;
+        float boxReach = fabsf(plane.x) * bounds.extentX[i] + fabsf(plane.y) * bounds.extentY[i] +
+                         fabsf(plane.z) * bounds.extentZ[i];
+        if (distance + bounds.radius[i] < 0.0f || distance + boxReach < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+static size_t cullRange(const Frustum& frustum, const CullingBounds& bounds, unsigned char* visible,
+                        size_t begin, size_t end) {
+    size_t visibleCount = 0;
+    for (size_t i = begin; i < end; i++)
+    {
+        visible[i] = insideFrustum(frustum, bounds, i);
+        visibleCount += visible[i];
+    }
+    return visibleCount;
+}
+
+size_t cullBoundsScalar(const Frustum& frustum, const CullingBounds& bounds, unsigned char* visible) {
+    return cullRange(frustum, bounds, visible, 0, bounds.size());
+}
+
+#if defined(__AVX__) || defined(__SSE__) || defined(__ARM_NEON)
+// Lane masks as the visible bytes they expand to (little endian), stored 4 at a time
+static const unsigned int MASK_BYTES[16] = {
+    0x00000000, 0x00000001, 0x00000100, 0x00000101, 0x00010000, 0x00010001, 0x00010100, 0x00010101,
+    0x01000000, 0x01000001, 0x01000100, 0x01000101, 0x01010000, 0x01010001, 0x01010100, 0x01010101
+};
+#endif
+
+size_t cullBounds(const Frustum& frustum, const CullingBounds& bounds, unsigned char* visible) {
+    return cullBoundsRange(frustum, bounds, visible, 0, bounds.size());
+}
+
+size_t cullBoundsRange(const Frustum& frustum, const CullingBounds& bounds, unsigned char* visible,
+                       size_t begin, size_t end) {
+    size_t count = end;
+    size_t visibleCount = 0;
+    size_t i = begin;
+    if (begin >= end)
+        return 0;
+
+    // Locals, so stores through visible (a char pointer may alias anything)
+    // don't force the compiler to reload planes and array pointers
+    const float* centerX = &bounds.centerX[0];
+    const float* centerY = &bounds.centerY[0];
+    const float* centerZ = &bounds.centerZ[0];
+    const float* extentX = &bounds.extentX[0];
+    const float* extentY = &bounds.extentY[0];
+    const float* extentZ = &bounds.extentZ[0];
+    const float* radius = &bounds.radius[0];
+    float planes[6][7]; // x, y, z, w, |x|, |y|, |z|
+    for (int p = 0; p < 6; p++)
+    {
+        for (int k = 0; k < 4; k++)
+            planes[p][k] = frustum.planes[p][k];
+        for (int k = 0; k < 3; k++)
+            planes[p][4 + k] = fabsf(frustum.planes[p][k]);
+    }
+
+    // Per plane: distance = n.c + w, the sphere is outside when distance + r < 0
+    // and the box when distance + |n|.e < 0, so keep min(both) >= 0
+#if defined(__AVX__)
+    __m256 plane[6][7];
+    for (int p = 0; p < 6; p++)
+        for (int k = 0; k < 7; k++)
+            plane[p][k] = _mm256_set1_ps(planes[p][k]);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 cx = _mm256_loadu_ps(centerX + i);
+        __m256 cy = _mm256_loadu_ps(centerY + i);
+        __m256 cz = _mm256_loadu_ps(centerZ + i);
+        __m256 ex = _mm256_loadu_ps(extentX + i);
+        __m256 ey = _mm256_loadu_ps(extentY + i);
+        __m256 ez = _mm256_loadu_ps(extentZ + i);
+        __m256 r = _mm256_loadu_ps(radius + i);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++)
+        {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, plane[p][0]), _mm256_mul_ps(cy, plane[p][1])),
+                                            _mm256_add_ps(_mm256_mul_ps(cz, plane[p][2]), plane[p][3]));
+            __m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, plane[p][4]), _mm256_mul_ps(ey, plane[p][5])),
+                                         _mm256_mul_ps(ez, plane[p][6]));
+            __m256 margin = _mm256_add_ps(distance, _mm256_min_ps(r, reach));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(margin, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        memcpy(visible + i, &MASK_BYTES[mask & 15], 4);
+        memcpy(visible + i + 4, &MASK_BYTES[mask >> 4], 4);
+        visibleCount += __builtin_popcount(mask);
+    }
+#elif defined(__SSE__)
+    __m128 plane[6][7];
+    for (int p = 0; p < 6; p++)
+        for (int k = 0; k < 7; k++)
+            plane[p][k] = _mm_set1_ps(planes[p][k]);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(centerX + i);
+        __m128 cy = _mm_loadu_ps(centerY + i);
+        __m128 cz = _mm_loadu_ps(centerZ + i);
+        __m128 ex = _mm_loadu_ps(extentX + i);
+        __m128 ey = _mm_loadu_ps(extentY + i);
+        __m128 ez = _mm_loadu_ps(extentZ + i);
+        __m128 r = _mm_loadu_ps(radius + i);
+        __m128 inside = _mm_cmpeq_ps(r, r); // all ones (radii are never NaN)
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, plane[p][0]), _mm_mul_ps(cy, plane[p][1])),
+                                         _mm_add_ps(_mm_mul_ps(cz, plane[p][2]), plane[p][3]));
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, plane[p][4]), _mm_mul_ps(ey, plane[p][5])),
+                                      _mm_mul_ps(ez, plane[p][6]));
+            __m128 margin = _mm_add_ps(distance, _mm_min_ps(r, reach));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(margin, _mm_setzero_ps()));
+        }
+        int mask = _mm_movemask_ps(inside);
+        memcpy(visible + i, &MASK_BYTES[mask], 4);
+        visibleCount += __builtin_popcount(mask);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4_t cx = vld1q_f32(centerX + i);
+        float32x4_t cy = vld1q_f32(centerY + i);
+        float32x4_t cz = vld1q_f32(centerZ + i);
+        float32x4_t ex = vld1q_f32(extentX + i);
+        float32x4_t ey = vld1q_f32(extentY + i);
+        float32x4_t ez = vld1q_f32(extentZ + i);
+        float32x4_t r = vld1q_f32(radius + i);
+        uint32x4_t inside = vdupq_n_u32(0xFFFFFFFFu);
+        for (int p = 0; p < 6; p++)
+        {
+            const float* plane = planes[p];
+            float32x4_t distance = vmlaq_n_f32(vdupq_n_f32(plane[3]), cx, plane[0]);
+            distance = vmlaq_n_f32(distance, cy, plane[1]);
+            distance = vmlaq_n_f32(distance, cz, plane[2]);
+            float32x4_t reach = vmulq_n_f32(ex, plane[4]);
+            reach = vmlaq_n_f32(reach, ey, plane[5]);
+            reach = vmlaq_n_f32(reach, ez, plane[6]);
+            float32x4_t margin = vaddq_f32(distance, vminq_f32(r, reach));
+            inside = vandq_u32(inside, vcgeq_f32(margin, vdupq_n_f32(0.0f)));
+        }
+        // One bit per lane, then the same byte expansion as above
+        static const uint32_t laneBits[4] = { 1, 2, 4, 8 };
+        int mask = vaddvq_u32(vandq_u32(inside, vld1q_u32(laneBits)));
+        memcpy(visible + i, &MASK_BYTES[mask], 4);
+        visibleCount += __builtin_popcount(mask);
+    }
+#endif
+
+    return visibleCount + cullRange(frustum, bounds, visible, i, count);
+}
@@ -0,0 +1,55 @@
+#ifndef FRUSTUM_CULLING_H
+#define FRUSTUM_CULLING_H
+
+#include <vector>
+#include <stddef.h>
+#include <glm/glm.hpp>
+
+// Six planes (left, right, bottom, top, near, far) with normals pointing
+// inwards and unit length, so dot(plane.xyz, p) + plane.w is a distance
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Gribb/Hartmann extraction from the rows of projection * view
+void extractFrustum(const glm::mat4& viewProjection, Frustum& frustum);
+
+// World space bounds of many objects as structure of arrays, so the test
+// handles 4 (SSE, NEON) or 8 (AVX) objects per instruction. Every object
+// has an AABB (center/half extent) and a bounding sphere around the same
+// center, an object is culled when either volume is outside a plane.
+struct CullingBounds {
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<float> radius;
+
+    size_t size() const { return centerX.size(); }
+};
+
+// Objects tested and rejected by each culling stage in one frame
+struct CullingCounters {
+    unsigned int objects;
+    unsigned int frustumCulled;
+    unsigned int occlusionCulled;
+};
+
+void clearCullingBounds(CullingBounds& bounds);
+// Appends a mesh's local bounding box placed by model
+void addCullingBounds(CullingBounds& bounds, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                      const glm::mat4& model);
+// Same, for filling slots of resized bounds from several threads
+void resizeCullingBounds(CullingBounds& bounds, size_t count);
+void setCullingBounds(CullingBounds& bounds, size_t index, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                      const glm::mat4& model);
+
+// Sets visible[i] to 1 for objects intersecting the frustum and 0 for the
+// rest, returns the number of visible objects. Conservative: objects near
+// a frustum corner may be kept although they are outside.
+size_t cullBounds(const Frustum& frustum, const CullingBounds& bounds, unsigned char* visible);
+// Objects [begin, end) only, visible is still indexed from 0
+size_t cullBoundsRange(const Frustum& frustum, const CullingBounds& bounds, unsigned char* visible,
+                       size_t begin, size_t end);
+// Same result one object at a time, the reference for benchmarks
+size_t cullBoundsScalar(const Frustum& frustum, const CullingBounds& bounds, unsigned char* visible);
+
+#endif
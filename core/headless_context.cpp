@@ -0,0 +1,134 @@
+#include "headless_context.h"
+#include <stdio.h>
+
+#ifdef __APPLE__
+
+#include <GLFW/glfw3.h>
+#include "error_callback.h"
+
+static GLFWwindow* hiddenWindow = nullptr;
+
+bool initializeHeadlessContext() {
+    glfwSetErrorCallback(errorCallback);
+    if (!glfwInit())
+        return false;
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // Never shown, we only need it for the context
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    hiddenWindow = glfwCreateWindow(1, 1, "headless", NULL, NULL);
+    if (!hiddenWindow)
+    {
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(hiddenWindow);
+    return true;
+}
+
+void destroyHeadlessContext() {
+    glfwDestroyWindow(hiddenWindow);
+    glfwTerminate();
+    hiddenWindow = nullptr;
+}
+
+#else
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+static EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+static EGLContext eglContext = EGL_NO_CONTEXT;
+static EGLSurface eglSurface = EGL_NO_SURFACE;
+
+static EGLDisplay openDisplay() {
+    // Prefer the surfaceless platform: it needs no X server and no GPU
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+    {
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display != EGL_NO_DISPLAY)
+            return display;
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool initializeHeadlessContext() {
+    eglDisplay = openDisplay();
+    EGLint major, minor;
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor))
+    {
+        fprintf(stderr, "EGL: failed to initialize display (0x%x)\n", eglGetError());
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        fprintf(stderr, "EGL: desktop OpenGL is not supported\n");
+        return false;
+    }
+
+    // A pbuffer config is only needed when surfaceless contexts are not available
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLConfig config = NULL;
+    EGLint numConfigs = 0;
+    eglChooseConfig(eglDisplay, configAttribs, &config, 1, &numConfigs);
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 1,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    eglContext = eglCreateContext(eglDisplay, numConfigs > 0 ? config : EGL_NO_CONFIG_KHR,
+                                  EGL_NO_CONTEXT, contextAttribs);
+    if (eglContext == EGL_NO_CONTEXT)
+    {
+        fprintf(stderr, "EGL: failed to create a 4.1 core context (0x%x)\n", eglGetError());
+        eglTerminate(eglDisplay);
+        return false;
+    }
+
+    // Try without any surface first (EGL_KHR_surfaceless_context), then fall
+    // back to a tiny pbuffer, all real rendering goes into an FBO anyway
+    if (eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+        return true;
+
+    if (numConfigs > 0)
+    {
+        const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        eglSurface = eglCreatePbufferSurface(eglDisplay, config, pbufferAttribs);
+        if (eglSurface != EGL_NO_SURFACE && eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext))
+            return true;
+    }
+
+    fprintf(stderr, "EGL: failed to make the context current (0x%x)\n", eglGetError());
+    destroyHeadlessContext();
+    return false;
+}
+
+void destroyHeadlessContext() {
+    if (eglDisplay == EGL_NO_DISPLAY)
+        return;
+    eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (eglSurface != EGL_NO_SURFACE)
+        eglDestroySurface(eglDisplay, eglSurface);
+    if (eglContext != EGL_NO_CONTEXT)
+        eglDestroyContext(eglDisplay, eglContext);
+    eglTerminate(eglDisplay);
+    eglDisplay = EGL_NO_DISPLAY;
+    eglContext = EGL_NO_CONTEXT;
+    eglSurface = EGL_NO_SURFACE;
+}
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+// Creates an OpenGL 4.1 core context that is not attached to any window.
+// On Linux this goes through EGL (surfaceless Mesa platform when available,
+// so it also works on GPU-less boxes via llvmpipe). On macOS an invisible
+// GLFW window is used instead. Rendering must go into an offscreen target.
+bool initializeHeadlessContext();
+void destroyHeadlessContext();
+
+#endif
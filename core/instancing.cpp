@@ -0,0 +1,70 @@
+#include "instancing.h"
+#include "opengl.h"
+#include "transform_batch.h"
+#include <stddef.h>
+
+void buildInstances(const glm::mat4* models, size_t count, std::vector<InstanceData>& instances) {
+    instances.resize(count);
+    if (count > 0)
+        fillInstances(models, count, &instances[0]);
+}
+
+void fillInstances(const glm::mat4* models, size_t count, InstanceData* instances) {
+    for (size_t i = 0; i < count; i++)
+    {
+        instances[i].model = models[i];
+        computeNormalMatrices(&models[i], 1, &instances[i].normalMatrix);
+    }
+}
+
+void createInstancedMesh(InstancedMesh& instanced, const GpuMesh& mesh, size_t capacity) {
+    glGenVertexArrays(1, &instanced.VAO);
+    glBindVertexArray(instanced.VAO);
+
+    // Same per-vertex layout as the mesh's own VAO
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    setupVertexAttributes(mesh.vertexFormat);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+
+    glGenBuffers(1, &instanced.instanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanced.instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+    instanced.capacity = capacity;
+    instanced.instanceCount = 0;
+
+    // A mat4 attribute takes four locations, a mat3 three
+    GLsizei stride = sizeof(InstanceData);
+    for (unsigned int column = 0; column < 4; column++)
+    {
+        unsigned int location = INSTANCE_ATTRIBUTE_LOCATION + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+    for (unsigned int column = 0; column < 3; column++)
+    {
+        unsigned int location = INSTANCE_ATTRIBUTE_LOCATION + 4 + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(offsetof(InstanceData, normalMatrix) + column * sizeof(glm::vec3)));
+        glVertexAttribDivisor(location, 1);
+    }
+
+    glBindVertexArray(0);
+}
+
+void updateInstances(InstancedMesh& instanced, const InstanceData* instances, size_t count) {
+    glBindBuffer(GL_ARRAY_BUFFER, instanced.instanceVBO);
+    if (count > instanced.capacity)
+        instanced.capacity = count + count / 2;
+    glBufferData(GL_ARRAY_BUFFER, instanced.capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData), instances);
+    instanced.instanceCount = count;
+}
+
+void destroyInstancedMesh(InstancedMesh& instanced) {
+    glDeleteVertexArrays(1, &instanced.VAO);
+    glDeleteBuffers(1, &instanced.instanceVBO);
+    instanced = InstancedMesh();
+}
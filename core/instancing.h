@@ -0,0 +1,39 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glm/glm.hpp>
+#include <stddef.h>
+#include <vector>
+#include "mesh.h"
+
+// Per-instance vertex attributes, read by the vertex shader at locations
+// 4-7 (model, one vec4 column each) and 8-10 (normal matrix columns)
+struct InstanceData {
+    glm::mat4 model;
+    glm::mat3 normalMatrix;
+};
+
+const unsigned int INSTANCE_ATTRIBUTE_LOCATION = 4;
+
+// A mesh drawn many times with one glDrawElementsInstanced. It gets its own
+// VAO sharing the mesh's vertex and index buffers plus an instance buffer
+// advancing once per instance (glVertexAttribDivisor 1).
+struct InstancedMesh {
+    unsigned int VAO = 0;
+    unsigned int instanceVBO = 0;
+    size_t capacity = 0;       // instances the buffer can hold
+    size_t instanceCount = 0;  // instances uploaded by the last updateInstances
+};
+
+// Fills instances from model matrices, normal matrices included
+void buildInstances(const glm::mat4* models, size_t count, std::vector<InstanceData>& instances);
+// Same without resizing, for filling ranges of one array from several threads
+void fillInstances(const glm::mat4* models, size_t count, InstanceData* instances);
+
+void createInstancedMesh(InstancedMesh& instanced, const GpuMesh& mesh, size_t capacity);
+// Streams this frame's instances, the old storage is orphaned so the driver
+// never waits for draws still reading it; grows the buffer when needed
+void updateInstances(InstancedMesh& instanced, const InstanceData* instances, size_t count);
+void destroyInstancedMesh(InstancedMesh& instanced);
+
+#endif
@@ -0,0 +1,189 @@
+#include "job_system.h"
+#include <algorithm>
+
+// Worker the calling thread runs as, threads outside the system count as worker 0
+static thread_local int currentWorker = 0;
+
+static void pushJob(JobSystem& jobs, const Job& job) {
+    JobQueue& queue = jobs.queues[currentWorker < jobs.workerCount ? currentWorker : 0];
+    {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        queue.jobs.push_back(job);
+    }
+    jobs.queuedJobs++;
+    // Taking the lock orders the notify after a worker's empty check
+    if (jobs.workerCount > 1)
+    {
+        std::lock_guard<std::mutex> guard(jobs.sleepLock);
+        jobs.wake.notify_one();
+    }
+}
+
+static bool popJob(JobSystem& jobs, int worker, Job& job) {
+    if (jobs.queuedJobs.load() == 0)
+        return false;
+    {
+        JobQueue& queue = jobs.queues[worker];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (!queue.jobs.empty())
+        {
+            job = queue.jobs.back();
+            queue.jobs.pop_back();
+            jobs.queuedJobs--;
+            return true;
+        }
+    }
+    // Steal the oldest job of another worker, usually the biggest remaining range
+    for (int i = 1; i < jobs.workerCount; i++)
+    {
+        JobQueue& victim = jobs.queues[(worker + i) % jobs.workerCount];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.jobs.empty())
+        {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            jobs.queuedJobs--;
+            jobs.jobsStolen++;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void finishJob(JobSystem& jobs, const Job& job) {
+    jobs.jobsRun++;
+    if (!job.counter)
+        return;
+    // Jobs that leave the counter above zero don't need the lock
+    int pending = job.counter->pending.load();
+    while (pending > 1)
+    {
+        if (job.counter->pending.compare_exchange_weak(pending, pending - 1))
+            return;
+    }
+
+    // The last one reaches zero under the lock and releases the jobs waiting
+    // for it there. waitForCounter takes the lock before returning, so the
+    // counter can't be freed and reused by another group mid scan.
+    std::vector<Job> released;
+    {
+        std::lock_guard<std::mutex> guard(jobs.waitingLock);
+        if (--job.counter->pending > 0)
+            return;
+        for (size_t i = 0; i < jobs.waiting.size();)
+        {
+            if (jobs.waiting[i].dependency == job.counter)
+            {
+                released.push_back(jobs.waiting[i]);
+                jobs.waiting[i] = jobs.waiting.back();
+                jobs.waiting.pop_back();
+            }
+            else
+                i++;
+        }
+    }
+    for (size_t i = 0; i < released.size(); i++)
+        pushJob(jobs, released[i]);
+}
+
+static void executeJob(JobSystem& jobs, const Job& job) {
+    job.function(job.data, job.begin, job.end);
+    finishJob(jobs, job);
+}
+
+static void workerLoop(JobSystem* jobs, int worker) {
+    currentWorker = worker;
+    Job job;
+    while (!jobs->stopping.load())
+    {
+        if (popJob(*jobs, worker, job))
+        {
+            executeJob(*jobs, job);
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(jobs->sleepLock);
+        jobs->wake.wait(guard, [jobs] { return jobs->queuedJobs.load() > 0 || jobs->stopping.load(); });
+    }
+}
+
+void startJobSystem(JobSystem& jobs, int workerCount) {
+    if (workerCount <= 0)
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+    jobs.workerCount = workerCount;
+    jobs.queues.reset(new JobQueue[workerCount]);
+    jobs.queuedJobs = 0;
+    jobs.stopping = false;
+    jobs.jobsRun = 0;
+    jobs.jobsStolen = 0;
+    currentWorker = 0;
+    for (int i = 1; i < workerCount; i++)
+        jobs.threads.push_back(std::thread(workerLoop, &jobs, i));
+}
+
+void stopJobSystem(JobSystem& jobs) {
+    {
+        std::lock_guard<std::mutex> guard(jobs.sleepLock);
+        jobs.stopping = true;
+        jobs.wake.notify_all();
+    }
+    for (size_t i = 0; i < jobs.threads.size(); i++)
+        jobs.threads[i].join();
+    jobs.threads.clear();
+    jobs.queues.reset();
+    jobs.workerCount = 0;
+}
+
+static void submitJob(JobSystem& jobs, const Job& job) {
+    if (job.counter)
+        job.counter->pending++;
+    if (job.dependency)
+    {
+        // Checked under the lock finishJob takes, so the release can't be missed
+        std::lock_guard<std::mutex> guard(jobs.waitingLock);
+        if (job.dependency->pending.load() > 0)
+        {
+            jobs.waiting.push_back(job);
+            return;
+        }
+    }
+    pushJob(jobs, job);
+}
+
+void runJob(JobSystem& jobs, JobFunction function, void* data, JobCounter* counter, JobCounter* dependency) {
+    Job job = { function, data, 0, 1, counter, dependency };
+    submitJob(jobs, job);
+}
+
+void parallelFor(JobSystem& jobs, JobFunction function, void* data, int count, int grainSize,
+                 JobCounter* counter, JobCounter* dependency) {
+    if (count <= 0)
+        return;
+    int rangeSize = std::max(std::max(grainSize, 1), (count + jobs.workerCount * 4 - 1) / (jobs.workerCount * 4));
+    for (int begin = 0; begin < count; begin += rangeSize)
+    {
+        Job job = { function, data, begin, std::min(begin + rangeSize, count), counter, dependency };
+        submitJob(jobs, job);
+    }
+}
+
+bool runPendingJob(JobSystem& jobs) {
+    Job job;
+    if (!popJob(jobs, currentWorker, job))
+        return false;
+    executeJob(jobs, job);
+    return true;
+}
+
+void waitForCounter(JobSystem& jobs, JobCounter& counter) {
+    Job job;
+    while (counter.pending.load() > 0)
+    {
+        if (popJob(jobs, currentWorker, job))
+            executeJob(jobs, job);
+        else
+            std::this_thread::yield();
+    }
+    // The job that reached zero may still be releasing dependents, the
+    // caller is free to destroy the counter once it's done
+    std::lock_guard<std::mutex> guard(jobs.waitingLock);
+}
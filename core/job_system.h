@@ -0,0 +1,75 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A job runs function(data, begin, end), parallel fors split [0, count)
+// into ranges of at least grainSize items
+typedef void (*JobFunction)(void* data, int begin, int end);
+
+// Counts unfinished jobs. Every job submitted with a counter increments it
+// and decrements it when done, so one counter can stand for a whole group
+// of jobs; jobs can also wait for a counter to reach zero before they start.
+struct JobCounter {
+    std::atomic<int> pending;
+    JobCounter() : pending(0) {}
+};
+
+struct Job {
+    JobFunction function;
+    void* data;
+    int begin, end;
+    JobCounter* counter;    // decremented when the job is done, may be NULL
+    JobCounter* dependency; // the job is held back until this reaches zero, may be NULL
+};
+
+// Per worker deque: the owner pushes and pops at the back (newest first,
+// its data is still in cache), idle workers steal from the front
+struct JobQueue {
+    std::mutex lock;
+    std::deque<Job> jobs;
+};
+
+// Task scheduler with one work-stealing deque per worker. Worker 0 is the
+// thread that started the system, it runs jobs inside waitForCounter;
+// workers 1..workerCount-1 are threads that sleep while there is no work.
+struct JobSystem {
+    int workerCount = 0;
+    std::vector<std::thread> threads;
+    std::unique_ptr<JobQueue[]> queues;
+    std::atomic<int> queuedJobs;    // jobs sitting in any deque
+    std::atomic<bool> stopping;
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    std::mutex waitingLock;         // jobs held back by their dependency
+    std::vector<Job> waiting;
+    std::atomic<unsigned int> jobsRun;
+    std::atomic<unsigned int> jobsStolen;
+};
+
+// workerCount 0 picks one worker per hardware thread
+void startJobSystem(JobSystem& jobs, int workerCount = 0);
+// Waits for the worker threads, queued jobs must be finished by then
+void stopJobSystem(JobSystem& jobs);
+
+// A dependency is checked when the job is submitted, so submit the jobs it
+// stands for first; a counter that is already zero holds nothing back
+void runJob(JobSystem& jobs, JobFunction function, void* data, JobCounter* counter,
+            JobCounter* dependency = NULL);
+// Splits [0, count) into about four ranges per worker, none under grainSize
+void parallelFor(JobSystem& jobs, JobFunction function, void* data, int count, int grainSize,
+                 JobCounter* counter, JobCounter* dependency = NULL);
+// Runs one queued job on the calling thread, false when there was none.
+// Lets a single worker system make progress without waiting on a counter.
+bool runPendingJob(JobSystem& jobs);
+// Runs queued jobs (own deque first, then stolen ones) until counter is zero.
+// Safe inside jobs, the waiting worker keeps working instead of blocking.
+void waitForCounter(JobSystem& jobs, JobCounter& counter);
+
+#endif
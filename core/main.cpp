@@ -1,17 +1,18 @@
-#define GL_SILENCE_DEPRECATION
-
 // Without this gl.h gets included instead of gl3.h
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
 // For includes related to OpenGL, make sure their are included after glfw3.h
-#include <OpenGL/gl3.h>
+#include "opengl.h"
 
 // Utils
 #include <stdio.h>
+#include <sys/stat.h>
 #include <fstream>
 #include <iostream>
 #include <cassert>
+#include <algorithm>
+#include <cmath>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "libraries/stb_image.h"
@@ -24,11 +25,34 @@
 // Local includes
 #include "keyboard_input.h"
 #include "error_callback.h"
+#include "command_line.h"
+#include "headless_context.h"
+#include "offscreen_target.h"
+#include "benchmark.h"
+#include "render_state.h"
+#include "render_queue.h"
+
+// Meshes
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "model_import.h"
+#include "mesh_optimizer.h"
+#include "transform_batch.h"
+#include "instancing.h"
+#include "multi_draw.h"
+#include "frustum_culling.h"
+#include "bvh.h"
+#include "occlusion_culling.h"
+#include "software_rasterizer.h"
+#include "job_system.h"
+#include "texture_streaming.h"
+#include "texture_cache.h"
+#include "texture_atlas.h"
+#include "texture_array.h"
 
-// Include the Assimp library
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
+// Shaders
+#include "shader_program.h"
+#include "uniform_buffers.h"
 
 using namespace std;
 
@@ -41,24 +65,85 @@ float cameraYaw = -90.0f; // Initial yaw angle
 // Timing
 float deltaTime = 0.0f; // Time between current frame and last frame
 float lastFrame = 0.0f; // Time of last frame
+const float benchmarkFrameStep = 1.0f / 60.0f; // Fixed step for headless and benchmark runs
+const int OCCLUSION_BUFFER_WIDTH = 256;         // Height follows the aspect ratio
+const size_t MAX_OCCLUDERS = 64;                // Nearest cubes rasterized for occlusion culling
+
+const glm::vec3 sceneLightPos(10.0f, 0.0f, 0.0f);    // Define light position
+const glm::vec3 sceneLightColor(1.0f, 1.0f, 1.0f);  // White light
+
+// Objects drawn every frame, the --instances grid comes on top
+enum { CUBE_OBJECT, MODEL_OBJECT, AXES_OBJECT, OBJECT_COUNT };
+const int GRID_CULLING_INDEX = 2; // culling bounds are cube, model, then the grid
 
 void frameBufferResizeCallback(GLFWwindow* window, int width, int height){
     glViewport(0, 0, width, height);
 }
 
-string readShaderCode(const char* fileName){
-    ifstream meInput(fileName);
-    if ( ! meInput.good())
-    {
-        cout << "File failed to load..." << fileName;
-        exit(1);
-    }
-    return std::string(
-        std::istreambuf_iterator<char>(meInput),
-        std::istreambuf_iterator<char>());
-}
+// GL objects and uniform locations shared by the windowed and headless loops
+struct Scene {
+    JobSystem jobs;         // frame work and asset decoding, started by setupScene
+    RenderState state;
+    RenderQueue queue;      // reused every frame to keep its allocations
+    ShaderProgram shader;
+    TextureStreamer textures;
+    int catTexture;         // streamed texture handle, see useTexture
+    TextureArray atlas;     // --atlas pages, every material draws from it when set
+    int cubeLayer, modelLayer;
+    GpuMesh cube;
+    InstancedMesh cubeInstances;            // --instances grid drawn with one call
+    int instanceCount;
+    std::vector<glm::mat4> instanceModels;  // simulation scratch for the grid
+    bool frustumCulling;
+    CullingBounds cullingBounds;            // world bounds of everything culled this frame
+    std::vector<unsigned char> visibility;
+    bool bvhCulling;                        // --bvh-culling: query bvh instead of testing every object
+    Bvh bvh;                                // over cullingBounds, refitted every frame
+    std::vector<unsigned int> visibleObjects;
+    bool occlusionCulling;                  // --occlusion-culling: the nearest cubes hide what's behind them
+    OcclusionBuffer occlusion;
+    Mesh occluderMesh;                      // CPU copy of the cube for the occlusion rasterizer
+    std::vector<std::pair<float, int> > occluderCandidates; // squared distance, culling index
+    bool multiDraw;                         // --multi-draw: cube and model drawn from the batch
+    bool useMultiDrawIndirect;              // GL 4.3 context, otherwise the fallback loop
+    MeshBatch batch;
+    int batchModelMesh;                     // -1 when the model isn't in the batch
+    unsigned int VAOLine;
+    int modelSlot, modelViewProjectionSlot, normalMatrixSlot;
+    glm::mat4 projection;
+    UniformRing uniformRing;  // per-frame FrameUniforms and LightUniforms
+    int useLightingSlot, useTextureSlot, textureSlot;
+    int useTextureArraySlot, textureLayerSlot;
+    int positionOffsetSlot, positionScaleSlot, octahedralNormalsSlot;
+    int instancedSlot;
+    int multiDrawSlot, drawOffsetSlot, drawDataSlot;
+    glm::vec3 lightPos;
+    glm::vec3 lightColor;
+    GpuMesh model;          // optional mesh loaded from a .mesh cache
+    glm::mat4 modelFit = glm::mat4(1.0f); // scales and centers the mesh next to the cube
+};
+
+// Everything renderFrame needs from the CPU side of one frame. simulateFrame
+// fills it without touching GL, so the next frame's state can be simulated
+// on a worker while the render thread draws this one.
+struct FrameState {
+    // Inputs, taken on the main thread by beginFrameState
+    float time;
+    int width, height;
+    glm::vec3 cameraPos;
+    glm::mat4 view;
+    glm::mat4 viewProjection;
+    // Results
+    glm::mat4 models[OBJECT_COUNT];
+    ObjectTransform transforms[OBJECT_COUNT];
+    bool cubeVisible, modelVisible;
+    std::vector<glm::mat4> visibleModels;             // grid cubes that survived culling
+    std::vector<ObjectTransform> instanceTransforms;  // their draws' transforms with --multi-draw
+    std::vector<InstanceData> instances;              // their instance data otherwise
+    CullingCounters culling;
+};
 
-GLFWwindow* initializeWindow() {
+GLFWwindow* initializeWindow(int windowWidth, int windowHeight) {
     GLFWwindow* window;
 
     // Set callback for errors
@@ -76,7 +161,7 @@ GLFWwindow* initializeWindow() {
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
     // Create a windowed mode window and its OpenGL context
-    window = glfwCreateWindow(640, 480, "Running OpenGL on Mac", NULL, NULL);
+    window = glfwCreateWindow(windowWidth, windowHeight, "Running OpenGL on Mac", NULL, NULL);
     if (!window)
     {
         glfwTerminate();
@@ -101,82 +186,34 @@ GLFWwindow* initializeWindow() {
     return window;
 }
 
-int main(void)
-{
-    GLFWwindow* window = initializeWindow();
-    if (!window)
-    {
-        // Handle error
-        return -1;
-    }
-
-    // MODEL LOADING
-    // Initialize the model loader (Assimp)
-    // Assimp::Importer importer;
-    // const aiScene* scene = importer.ReadFile("models/Dragon_head.obj",
-    //                                          aiProcess_Triangulate |
-    //                                          aiProcess_FlipUVs |
-    //                                          aiProcess_GenNormals);
-
-    // TEXTURE LOADING
-    unsigned int texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // load image, create texture and generate mipmaps
-    int imgWidth, imgHeight, nrChannels;
-    unsigned char *data = stbi_load("./textures/cat.jpg", &imgWidth, &imgHeight, &nrChannels, 0);
-    if (data)
-    {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imgWidth, imgHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
-
-
-    // get window height and width
-    int width, height;
-    glfwGetWindowSize(window, &width, &height);
-
-    // Define axis vertices
-    float axisLinesVertices[] = {
-        // X Axis           // (Red)
-        0.0f, 0.0f, 0.0f,   1.0f, 0.0f, 0.0f,
-        10.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,
-        // Y Axis           // (Green)
-        0.0f, 0.0f, 0.0f,   0.0f, 1.0f, 0.0f,
-        0.0f, 10.0f, 0.0f,  0.0f, 1.0f, 0.0f,
-        // Z Axis           // (Blue)
-        0.0f, 0.0f, 0.0f,   0.0f, 0.0f, 1.0f,
-        0.0f, 0.0f, 10.0f,  0.0f, 0.0f, 1.0f
-    };
-
-    // Vertex array object for axis lines
-    unsigned int VAOLine;
-    glGenVertexArrays(1, &VAOLine);
-    glBindVertexArray(VAOLine);
+// Scales and centers a loaded mesh next to the cube
+glm::mat4 fitModel(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    glm::vec3 size = boundsMax - boundsMin;
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float largestSide = std::max(size.x, std::max(size.y, size.z));
+    float scale = largestSide > 0.0f ? 1.0f / largestSide : 1.0f;
+    glm::mat4 fit = glm::translate(glm::mat4(1.0f), glm::vec3(1.4f, 0.0f, 0.0f));
+    fit = glm::scale(fit, glm::vec3(scale, scale, scale));
+    return glm::translate(fit, -center);
+}
 
-    unsigned int VBOLine;
-    glGenBuffers(1, &VBOLine);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOLine);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(axisLinesVertices), axisLinesVertices, GL_STATIC_DRAW);
-    
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+// Axis lines: position, color
+static const float axisLinesVertices[] = {
+    // X Axis           // (Red)
+    0.0f, 0.0f, 0.0f,   1.0f, 0.0f, 0.0f,
+    10.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,
+    // Y Axis           // (Green)
+    0.0f, 0.0f, 0.0f,   0.0f, 1.0f, 0.0f,
+    0.0f, 10.0f, 0.0f,  0.0f, 1.0f, 0.0f,
+    // Z Axis           // (Blue)
+    0.0f, 0.0f, 0.0f,   0.0f, 0.0f, 1.0f,
+    0.0f, 0.0f, 10.0f,  0.0f, 0.0f, 1.0f
+};
 
-    // Vertex data and buffer
-    float vertices[] = {
+// The textured cube, every face in its own color
+void buildCubeMesh(Mesh& cube) {
+    // Vertex data (flat triangle list, see Vertex in mesh.h)
+    Vertex vertices[] = {
         // positions          // normals           // colors         // texture coords
         // Back face (red)
         -0.5f, -0.5f, -0.5f,  0.0f, 0.0f, -1.0f,  1.0f, 0.0f, 0.0f,  0.0f, 0.0f,
@@ -227,179 +264,1218 @@ int main(void)
         -0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f,   0.0f, 1.0f, 1.0f,  0.0f, 0.0f,
     };
 
+    // Weld the shared corners of every face: 36 vertices become 24 plus an index buffer
+    buildIndexedMesh(vertices, sizeof(vertices) / sizeof(Vertex), cube);
+}
+
+// Loads the comma separated --atlas images and packs them, false when one
+// can't be loaded or packed
+bool buildAtlas(const std::string& files, TextureAtlas& atlas) {
+    createTextureAtlas(atlas);
+    for (size_t start = 0; start < files.size();)
+    {
+        size_t end = std::min(files.find(',', start), files.size());
+        std::string fileName = files.substr(start, end - start);
+        start = end + 1;
+        int width, height, channels;
+        unsigned char* pixels = stbi_load(fileName.c_str(), &width, &height, &channels, 4);
+        if (!pixels)
+        {
+            fprintf(stderr, "Failed to load atlas image %s\n", fileName.c_str());
+            return false;
+        }
+        TextureMip image;
+        image.width = width;
+        image.height = height;
+        image.pixels.assign(pixels, pixels + (size_t)width * height * 4);
+        stbi_image_free(pixels);
+        if (addAtlasImage(atlas, image) < 0)
+            return false;
+    }
+    return !atlas.rects.empty();
+}
+
+void setupScene(Scene& scene, const LaunchOptions& options, int width, int height) {
+    startJobSystem(scene.jobs, options.threadCount);
+    VertexFormat vertexFormat = options.compactVertices ? VERTEX_FORMAT_COMPACT : VERTEX_FORMAT_FLOAT;
+
+    // TEXTURE LOADING
+    // Decoded on a worker (or mapped, for a .tex made with --convert-texture)
+    // and uploaded a few rows per frame, draws get a placeholder until the
+    // first levels are in
+    createTextureStreamer(scene.textures, scene.jobs, options.textureBudget);
+    scene.catTexture = requestTexture(scene.textures, options.textureFile.c_str(),
+                                      options.srgbTexture ? TEXTURE_USAGE_COLOR : TEXTURE_USAGE_DATA);
+
+    // With --atlas the cubes and the model share one texture array: their
+    // texture coordinates are moved into their rects before upload and
+    // draws only differ by layer, so they keep sorting and batching together
+    TextureAtlas atlas;
+    if (!options.atlasFiles.empty() && buildAtlas(options.atlasFiles, atlas) &&
+        createTextureArray(scene.atlas, atlas, scene.state, &scene.jobs))
+    {
+        printf("Atlas of %d images on %d %dx%d pages, %d mip levels\n", (int)atlas.rects.size(),
+               scene.atlas.layerCount, scene.atlas.width, scene.atlas.height, scene.atlas.levelCount);
+    }
+    else
+        atlas.rects.clear();
+    const AtlasRect* cubeRect = atlas.rects.empty() ? NULL : &atlas.rects[0];
+    const AtlasRect* modelRect = atlas.rects.empty() ? NULL : &atlas.rects[1 % atlas.rects.size()];
+    scene.cubeLayer = cubeRect ? cubeRect->layer : 0;
+    scene.modelLayer = modelRect ? modelRect->layer : 0;
+
+    // MODEL LOADING
+    // Meshes are converted offline with --convert-mesh and mapped straight into GL buffers.
+    // An atlas needs the texture coordinates on the CPU first.
+    if (!options.meshFile.empty() && modelRect)
+    {
+        Mesh model;
+        if (readMeshCache(options.meshFile.c_str(), model))
+        {
+            remapTexCoords(model, *modelRect);
+            uploadMesh(scene.model, model, vertexFormat);
+            scene.modelFit = fitModel(scene.model.boundsMin, scene.model.boundsMax);
+        }
+    }
+    else if (!options.meshFile.empty() && loadMeshCache(options.meshFile.c_str(), scene.model))
+        scene.modelFit = fitModel(scene.model.boundsMin, scene.model.boundsMax);
+
+    // Vertex array object for axis lines
+    unsigned int VAOLine;
+    glGenVertexArrays(1, &VAOLine);
+    glBindVertexArray(VAOLine);
+
+    unsigned int VBOLine;
+    glGenBuffers(1, &VBOLine);
+    glBindBuffer(GL_ARRAY_BUFFER, VBOLine);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(axisLinesVertices), axisLinesVertices, GL_STATIC_DRAW);
+    
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+
+    // Cube vertex data, welded into an indexed mesh
+    Mesh cube;
+    buildCubeMesh(cube);
+    if (cubeRect)
+        remapTexCoords(cube, *cubeRect);
+    uploadMesh(scene.cube, cube, vertexFormat);
 
-    unsigned int VAO;
-    glGenVertexArrays(1, &VAO); 
-    glBindVertexArray(VAO);
-    unsigned int VBO;
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0); // setting up first vertex attribute (0)
-    glVertexAttribPointer(
-        0, // which attribute to configure (0)
-        3, // number of floats per vertex (x, y, z)
-        GL_FLOAT, // type of data
-        GL_FALSE, // should the data be normalized?
-        sizeof(float) * 11, // how many floats in each set of data
-        0 // where does the data start in the buffer?
-    );
-    glEnableVertexAttribArray(1); // setting up second vertex attribute (1)
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 11, (void*)(sizeof(float) * 3));
-    glEnableVertexAttribArray(2); // setting up second vertex attribute (1)
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 11, (void*)(sizeof(float) * 6));
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 11, (void*)(sizeof(float) * 9));
+    // Copies of the cube sharing its buffers, one instanced draw for all of them
+    scene.instanceCount = options.instanceCount;
+    scene.frustumCulling = options.frustumCulling;
+    scene.bvhCulling = options.bvhCulling;
+    scene.occlusionCulling = options.occlusionCulling;
+    scene.occluderMesh = cube;
+    if (scene.instanceCount > 0 && !options.multiDraw)
+        createInstancedMesh(scene.cubeInstances, scene.cube, scene.instanceCount);
+
+    // Meshes sharing the cube's vertex format go into one multi-draw batch
+    scene.multiDraw = false;
+    scene.batchModelMesh = -1;
+    if (options.multiDraw)
+    {
+        std::vector<const GpuMesh*> batchMeshes(1, &scene.cube);
+        if (scene.model.indexCount > 0 && scene.model.vertexFormat == scene.cube.vertexFormat)
+        {
+            scene.batchModelMesh = batchMeshes.size();
+            batchMeshes.push_back(&scene.model);
+        }
+        scene.multiDraw = createMeshBatch(scene.batch, batchMeshes.data(), batchMeshes.size());
+        scene.useMultiDrawIndirect = multiDrawIndirectSupported();
+        printf("Multi-draw batch of %d meshes, drawn with %s\n", (int)batchMeshes.size(),
+               scene.useMultiDrawIndirect ? "glMultiDrawElementsIndirect" : "a glDrawElementsBaseVertex loop");
+    }
 
 
     // SHADER PROGRAM
-    // Vertex shader
-    unsigned int vertexShader;
-    vertexShader = glCreateShader(GL_VERTEX_SHADER); // create shader
-    // read from file
-    const char* adapter[1];
-    string temp = readShaderCode("shaders/VertexShaderCode.glsl");
-    adapter[0] = temp.c_str();
-    // set the source
-    glShaderSource(vertexShader, 1, adapter, 0);
-    glCompileShader(vertexShader);
-    // logging
-    int  success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if(!success)
-    {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        fputs(infoLog, stderr);
-    }
-    // Fragment shader
-    unsigned int fragmentShader;
-    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER); // create shader
-    // read from file
-    temp = readShaderCode("shaders/FragmentShaderCode.glsl");
-    adapter[0] = temp.c_str();
-    // set the source
-    glShaderSource(fragmentShader, 1, adapter, 0);
-    glCompileShader(fragmentShader);
-    // logging
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if(!success)
-    {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        fputs(infoLog, stderr);
-    }
-    unsigned int shaderProgram;
-    shaderProgram = glCreateProgram();
-    // attach the shaders
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    // logging
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if(!success) {
-      glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-      fputs(infoLog, stderr);
-    }
-    glUseProgram(shaderProgram);
+    // Active uniforms are reflected once here, renderFrame only uses the slots
+    if (!scene.shader.load("shaders/VertexShaderCode.glsl", "shaders/FragmentShaderCode.glsl"))
+        exit(1);
+    scene.VAOLine = VAOLine;
 
 
     // CAMERA TRANSFORMATIONS
-    glm::mat4 model = glm::rotate(glm::mat4(1.0f), glm::radians(30.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-    glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -3.0f));
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 100.0f);
-    unsigned int modelLoc = glGetUniformLocation(shaderProgram, "model");
-    unsigned int viewLoc = glGetUniformLocation(shaderProgram, "view");
-    unsigned int projLoc = glGetUniformLocation(shaderProgram, "projection");
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    
+    // Combined with view and model on the CPU every frame, see simulateFrame
+    scene.projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 100.0f);
+    scene.modelSlot = scene.shader.uniformSlot("model");
+    scene.modelViewProjectionSlot = scene.shader.uniformSlot("modelViewProjection");
+    scene.normalMatrixSlot = scene.shader.uniformSlot("normalMatrix");
+
     // LIGHTING UNIFORMS
-    glm::vec3 lightPos = glm::vec3(10.0f, 0.0f, 0.0f); // Define light position
-    glm::vec3 lightColor = glm::vec3(1.0f, 1.0f, 1.0f); // White light
-    unsigned int lightPosLoc = glGetUniformLocation(shaderProgram, "lightPos");
-    unsigned int lightColorLoc = glGetUniformLocation(shaderProgram, "lightColor");
-    unsigned int viewPosLoc = glGetUniformLocation(shaderProgram, "viewPos");
+    scene.lightPos = sceneLightPos;
+    scene.lightColor = sceneLightColor;
+    createUniformRing(scene.uniformRing, sizeof(FrameUniforms) + sizeof(LightUniforms), 2);
+    scene.useLightingSlot = scene.shader.uniformSlot("useLighting");
+    scene.useTextureSlot = scene.shader.uniformSlot("useTexture");
+    scene.textureSlot = scene.shader.uniformSlot("texture1");
+    scene.useTextureArraySlot = scene.shader.uniformSlot("useTextureArray");
+    scene.textureLayerSlot = scene.shader.uniformSlot("textureLayer");
+    scene.shader.setInt(scene.shader.uniformSlot("textureArray"), TEXTURE_ARRAY_UNIT);
+
+    // VERTEX FORMAT UNIFORMS
+    scene.positionOffsetSlot = scene.shader.uniformSlot("positionOffset");
+    scene.positionScaleSlot = scene.shader.uniformSlot("positionScale");
+    scene.octahedralNormalsSlot = scene.shader.uniformSlot("octahedralNormals");
+    scene.instancedSlot = scene.shader.uniformSlot("instanced");
+    scene.multiDrawSlot = scene.shader.uniformSlot("multiDraw");
+    scene.drawOffsetSlot = scene.shader.uniformSlot("drawOffset");
+    scene.drawDataSlot = scene.shader.uniformSlot("drawData");
+    scene.shader.setInt(scene.drawDataSlot, DRAW_DATA_TEXTURE_UNIT);
 
-    glEnable(GL_DEPTH_TEST); // Enable depth testing
+    // Setup bound buffers, VAOs and textures behind the state tracker's back
+    invalidateRenderState(scene.state);
+    resetRenderStateCounters(scene.state);
     // OpenGL initializations end here
+}
+
+// Draw packet for a mesh, vertex decoding comes from the mesh itself
+DrawCommand meshDrawCommand(const Scene& scene, const GpuMesh& mesh, const glm::mat4& model, const ObjectTransform& transform) {
+    DrawCommand command;
+    command.program = scene.shader.id();
+    command.vertexArray = mesh.VAO;
+    command.texture = 0;
+    command.textureArray = false;
+    command.textureLayer = 0;
+    command.useLighting = true;
+    command.primitive = GL_TRIANGLES;
+    command.indexType = mesh.indexType;
+    command.first = 0;
+    command.count = mesh.indexCount;
+    command.instanceCount = 0;
+    command.batch = NULL;
+    command.batchMesh = 0;
+    command.vertexFormat = mesh.vertexFormat;
+    command.positionOffset = mesh.positionOffset;
+    command.positionScale = mesh.positionScale;
+    command.model = model;
+    command.transform = transform;
+    return command;
+}
+
+// The streamed texture, or the layer of the --atlas array when there is one
+void setMaterial(const Scene& scene, DrawCommand& command, unsigned int streamedTexture, int atlasLayer) {
+    command.texture = scene.atlas.texture ? scene.atlas.texture : streamedTexture;
+    command.textureArray = scene.atlas.texture != 0;
+    command.textureLayer = atlasLayer;
+}
+
+// Switches a command over to the mesh's copy inside the multi-draw batch
+void useBatchMesh(Scene& scene, DrawCommand& command, unsigned int batchMesh) {
+    command.batch = &scene.batch;
+    command.batchMesh = batchMesh;
+    command.vertexArray = scene.batch.VAO;
+}
+
+// Sort key for a command, the material is the lighting/texture/vertex format combination
+uint64_t drawSortKey(RenderPass pass, const DrawCommand& command) {
+    unsigned int material = (command.useLighting ? 1 : 0) | (command.texture ? 2 : 0) | (command.vertexFormat << 2) |
+                            (command.instanceCount ? 16 : 0) | (command.batch ? 32 : 0) | (command.textureArray ? 64 : 0);
+    // Clip space w is the view distance of the object's origin
+    float depth = command.transform.modelViewProjection[3][3] / 100.0f;
+    return makeSortKey(pass, command.program, material, command.texture, depth);
+}
+
+// Whether b can join a's multi-draw: same batch and everything bound or set
+// once per group. Sort keys truncate GL names to 12 bits, so they only
+// bring such draws next to each other and can't decide this.
+static bool sameBatchGroup(uint64_t keyA, const DrawCommand& a, uint64_t keyB, const DrawCommand& b) {
+    return keyA >> 60 == keyB >> 60 && a.batch == b.batch && a.program == b.program && a.texture == b.texture &&
+           a.textureArray == b.textureArray && a.useLighting == b.useLighting && a.vertexFormat == b.vertexFormat &&
+           a.primitive == b.primitive;
+}
+
+// Issues the queued draws in key order, the state tracker and the uniform
+// cache drop everything that didn't change between neighbouring draws
+void executeRenderQueue(Scene& scene) {
+    RenderQueue& queue = scene.queue;
+    sortRenderQueue(queue);
+    for (size_t i = 0; i < queue.packets.size(); i++)
+    {
+        const DrawCommand& command = queue.commands[queue.packets[i].command];
+        useProgram(scene.state, command.program);
+        bindVertexArray(scene.state, command.vertexArray);
+
+        // Material
+        scene.shader.setInt(scene.useLightingSlot, command.useLighting);
+        scene.shader.setInt(scene.useTextureSlot, command.texture != 0);
+        scene.shader.setInt(scene.useTextureArraySlot, command.textureArray);
+        if (command.textureArray)
+        {
+            // Layers change without touching the binding
+            bindTexture(scene.state, TEXTURE_ARRAY_UNIT, GL_TEXTURE_2D_ARRAY, command.texture);
+            if (!command.batch)
+                scene.shader.setFloat(scene.textureLayerSlot, (float)command.textureLayer);
+        }
+        else if (command.texture)
+        {
+            bindTexture(scene.state, 0, GL_TEXTURE_2D, command.texture);
+            scene.shader.setInt(scene.textureSlot, 0);
+        }
+
+        // Tells the vertex shader how to decode the vertex format
+        scene.shader.setVec3(scene.positionOffsetSlot, command.positionOffset);
+        scene.shader.setVec3(scene.positionScaleSlot, command.positionScale);
+        scene.shader.setInt(scene.octahedralNormalsSlot, command.vertexFormat == VERTEX_FORMAT_COMPACT);
+
+        // Batched draws: every following draw of the same batch with the same
+        // pass, program, material and texture goes into one multi-draw
+        scene.shader.setInt(scene.multiDrawSlot, command.batch != NULL);
+        if (command.batch)
+        {
+            scene.shader.setInt(scene.instancedSlot, false);
+            bindTexture(scene.state, DRAW_DATA_TEXTURE_UNIT, GL_TEXTURE_BUFFER, command.batch->drawDataTexture);
+            uint64_t key = queue.packets[i].key;
+            for (;; i++)
+            {
+                const DrawCommand& draw = queue.commands[queue.packets[i].command];
+                addBatchDraw(*command.batch, draw.batchMesh, draw.model, draw.transform.normalMatrix,
+                             draw.textureLayer);
+                if (i + 1 == queue.packets.size() ||
+                    !sameBatchGroup(key, command, queue.packets[i + 1].key, queue.commands[queue.packets[i + 1].command]))
+                    break;
+            }
+            flushBatchDraws(*command.batch, scene.useMultiDrawIndirect, scene.shader, scene.drawOffsetSlot);
+            continue;
+        }
+
+        // Per-object matrices, normal matrix and MVP were computed in one batch.
+        // Instances carry their own in the instance buffer.
+        bool instanced = command.instanceCount > 0;
+        scene.shader.setInt(scene.instancedSlot, instanced);
+        if (!instanced)
+        {
+            scene.shader.setMat4(scene.modelSlot, command.model);
+            scene.shader.setMat4(scene.modelViewProjectionSlot, command.transform.modelViewProjection);
+            scene.shader.setMat3(scene.normalMatrixSlot, command.transform.normalMatrix);
+        }
+
+        if (command.indexType)
+        {
+            size_t indexSize = command.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+            void* firstIndex = (void*)(command.first * indexSize);
+            if (instanced)
+                glDrawElementsInstanced(command.primitive, command.count, command.indexType, firstIndex, command.instanceCount);
+            else
+                glDrawElements(command.primitive, command.count, command.indexType, firstIndex);
+        }
+        else if (instanced)
+        {
+            glDrawArraysInstanced(command.primitive, command.first, command.count, command.instanceCount);
+        }
+        else
+        {
+            glDrawArrays(command.primitive, command.first, command.count);
+        }
+    }
+}
+
+// Updates cameraFront from cameraYaw and returns the view matrix
+glm::mat4 updateCameraView() {
+    glm::vec3 front;
+    front.x = cos(glm::radians(cameraYaw));
+    front.y = 0; // Keep the camera horizontal
+    front.z = sin(glm::radians(cameraYaw));
+    cameraFront = glm::normalize(front);
+    return glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+}
+
+// Model matrices of the scene's objects at a point in time
+void animateObjects(float time, const glm::mat4& modelFit, glm::mat4* models) {
+    // Calculate the cube's rotation
+    float angle = time * glm::radians(50.0f);
+    models[CUBE_OBJECT] = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.5f, 1.0f, 0.0f));
+    models[MODEL_OBJECT] = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f)) * modelFit;
+    models[AXES_OBJECT] = glm::mat4(1.0f); // Identity matrix for axes
+}
+
+// Cubes [begin, end) of the grid of instanceCount cubes below the scene
+void animateInstances(float time, int instanceCount, int begin, int end, glm::mat4* instanceModels) {
+    float angle = time * glm::radians(50.0f);
+    int columns = (int)ceil(sqrt((float)instanceCount));
+    for (int i = begin; i < end; i++)
+    {
+        glm::vec3 position((i % columns - (columns - 1) * 0.5f) * 1.2f, -1.5f, -(i / columns) * 1.2f);
+        glm::mat4 instanceModel = glm::translate(glm::mat4(1.0f), position);
+        instanceModel = glm::rotate(instanceModel, angle + i * 0.1f, glm::vec3(0.0f, 1.0f, 0.0f));
+        instanceModels[i] = glm::scale(instanceModel, glm::vec3(0.5f, 0.5f, 0.5f));
+    }
+}
+
+// Inputs of the jobs simulateFrame hands to the job system, lives until it waits for them
+struct FrameJobs {
+    Scene* scene;
+    FrameState* state;
+    Frustum frustum;
+    std::atomic<unsigned int> occlusionCulled;
+};
+
+// Grid cubes [begin, end): model matrices and culling bounds
+static void animateGridJob(void* data, int begin, int end) {
+    FrameJobs& frame = *(FrameJobs*)data;
+    Scene& scene = *frame.scene;
+    animateInstances(frame.state->time, scene.instanceCount, begin, end, scene.instanceModels.data());
+    for (int i = begin; i < end; i++)
+        setCullingBounds(scene.cullingBounds, GRID_CULLING_INDEX + i, scene.cube.boundsMin, scene.cube.boundsMax,
+                         scene.instanceModels[i]);
+}
+
+static void frustumCullJob(void* data, int begin, int end) {
+    FrameJobs& frame = *(FrameJobs*)data;
+    cullBoundsRange(frame.frustum, frame.scene->cullingBounds, frame.scene->visibility.data(), begin, end);
+}
+
+static void occlusionTestJob(void* data, int begin, int end) {
+    FrameJobs& frame = *(FrameJobs*)data;
+    Scene& scene = *frame.scene;
+    const CullingBounds& bounds = scene.cullingBounds;
+    unsigned int culled = 0;
+    for (int i = begin; i < end; i++)
+    {
+        glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+        glm::vec3 extent(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+        if (scene.visibility[i] && !testOcclusion(scene.occlusion, center, extent, frame.state->viewProjection))
+        {
+            scene.visibility[i] = 0;
+            culled++;
+        }
+    }
+    frame.occlusionCulled += culled;
+}
+
+// Visible grid cubes [begin, end) as per-draw transforms (multi-draw) or instance data
+static void gridTransformsJob(void* data, int begin, int end) {
+    FrameState& state = *((FrameJobs*)data)->state;
+    computeObjectTransforms(state.viewProjection, &state.visibleModels[begin], end - begin,
+                            &state.instanceTransforms[begin]);
+}
+
+static void gridInstancesJob(void* data, int begin, int end) {
+    FrameState& state = *((FrameJobs*)data)->state;
+    fillInstances(&state.visibleModels[begin], end - begin, &state.instances[begin]);
+}
+
+// Takes the frame's time, size and camera. Runs on the main thread, input
+// handling and the benchmark camera path write the camera globals.
+void beginFrameState(FrameState& state, const Scene& scene, float time, int width, int height) {
+    state.time = time;
+    state.width = width;
+    state.height = height;
+    state.cameraPos = cameraPos;
+    state.view = updateCameraView();
+    state.viewProjection = scene.projection * state.view;
+}
+
+// CPU side of a frame: animation, culling and the grid's draw data. Uses
+// the job system but no GL, so it may run as a job itself.
+void simulateFrame(Scene& scene, FrameState& state) {
+    // UPDATE OBJECT TRANSFORMS
+    // The grid is animated, bounded and frustum culled by jobs, the
+    // counters chain the steps
+    FrameJobs frame;
+    frame.scene = &scene;
+    frame.state = &state;
+    extractFrustum(state.viewProjection, frame.frustum);
+    frame.occlusionCulled = 0;
+    glm::mat4* models = state.models;
+    animateObjects(state.time, scene.modelFit, models);
+    scene.instanceModels.resize(scene.instanceCount);
+
+    // FRUSTUM CULLING
+    // Cube, model, then the grid; the axes are always drawn
+    resizeCullingBounds(scene.cullingBounds, GRID_CULLING_INDEX + scene.instanceCount);
+    setCullingBounds(scene.cullingBounds, 0, scene.cube.boundsMin, scene.cube.boundsMax, models[CUBE_OBJECT]);
+    setCullingBounds(scene.cullingBounds, 1, scene.model.boundsMin, scene.model.boundsMax, models[MODEL_OBJECT]);
+    std::vector<unsigned char>& visible = scene.visibility;
+    visible.assign(scene.cullingBounds.size(), 1);
+    JobCounter animated, culled;
+    parallelFor(scene.jobs, animateGridJob, &frame, scene.instanceCount, 256, &animated);
+    if (scene.frustumCulling && !scene.bvhCulling)
+        parallelFor(scene.jobs, frustumCullJob, &frame, visible.size(), 1024, &culled, &animated);
+
+    computeObjectTransforms(state.viewProjection, models, OBJECT_COUNT, state.transforms);
+    waitForCounter(scene.jobs, animated);
+    waitForCounter(scene.jobs, culled);
+
+    if (scene.frustumCulling && scene.bvhCulling)
+    {
+        // The grid only spins in place, so refitting keeps the tree good
+        setBvhObjectBounds(scene.bvh, scene.cullingBounds);
+        updateBvh(scene.bvh);
+        scene.visibleObjects.clear();
+        queryBvhFrustum(scene.bvh, frame.frustum, scene.visibleObjects);
+        visible.assign(scene.cullingBounds.size(), 0);
+        for (size_t i = 0; i < scene.visibleObjects.size(); i++)
+            visible[scene.visibleObjects[i]] = 1;
+    }
+    state.culling.objects = visible.size();
+    state.culling.frustumCulled = std::count(visible.begin(), visible.end(), 0);
+    state.culling.occlusionCulled = 0;
+
+    // OCCLUSION CULLING
+    // The nearest visible cubes go into a small CPU depth buffer, everything
+    // that survived frustum culling is tested against it. A minimized window
+    // has no size to take the buffer's aspect ratio from.
+    if (scene.occlusionCulling && state.width > 0 && state.height > 0)
+    {
+        resizeOcclusionBuffer(scene.occlusion, OCCLUSION_BUFFER_WIDTH,
+                              std::max(1, OCCLUSION_BUFFER_WIDTH * state.height / state.width));
+        clearOccluders(scene.occlusion);
+        const CullingBounds& bounds = scene.cullingBounds;
+        std::vector<std::pair<float, int> >& candidates = scene.occluderCandidates;
+        candidates.clear();
+        for (size_t i = 0; i < visible.size(); i++)
+        {
+            // Index 1 is the model, only cubes occlude
+            if (!visible[i] || i == 1)
+                continue;
+            glm::vec3 offset = glm::vec3(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]) - state.cameraPos;
+            candidates.push_back(std::make_pair(glm::dot(offset, offset), (int)i));
+        }
+        size_t occluderCount = std::min(candidates.size(), MAX_OCCLUDERS);
+        std::partial_sort(candidates.begin(), candidates.begin() + occluderCount, candidates.end());
+        for (size_t i = 0; i < occluderCount; i++)
+        {
+            int index = candidates[i].second;
+            const glm::mat4& occluderModel = index == 0 ? models[CUBE_OBJECT] : scene.instanceModels[index - GRID_CULLING_INDEX];
+            addOccluder(scene.occlusion, scene.occluderMesh, state.viewProjection * occluderModel);
+        }
+        rasterizeOccluders(scene.occlusion, scene.jobs);
+
+        JobCounter tested;
+        parallelFor(scene.jobs, occlusionTestJob, &frame, visible.size(), 1024, &tested);
+        waitForCounter(scene.jobs, tested);
+        state.culling.occlusionCulled = frame.occlusionCulled;
+    }
+    state.cubeVisible = visible[0];
+    state.modelVisible = visible[1];
+
+    // GRID DRAW DATA
+    const unsigned char* instanceVisible = &visible[GRID_CULLING_INDEX];
+    state.visibleModels.clear();
+    for (int i = 0; i < scene.instanceCount; i++)
+    {
+        if (instanceVisible[i])
+            state.visibleModels.push_back(scene.instanceModels[i]);
+    }
+    int visibleInstances = state.visibleModels.size();
+    JobCounter gridBuilt;
+    if (scene.multiDraw)
+    {
+        state.instanceTransforms.resize(visibleInstances);
+        parallelFor(scene.jobs, gridTransformsJob, &frame, visibleInstances, 256, &gridBuilt);
+    }
+    else
+    {
+        state.instances.resize(visibleInstances);
+        parallelFor(scene.jobs, gridInstancesJob, &frame, visibleInstances, 256, &gridBuilt);
+    }
+    waitForCounter(scene.jobs, gridBuilt);
+}
+
+// GL side of a frame, draws what simulateFrame produced
+void renderFrame(Scene& scene, const FrameState& state) {
+    // Counters cover a single frame, read them after renderFrame
+    resetRenderStateCounters(scene.state);
+    // Resize the viewport
+    setViewport(scene.state, 0, 0, state.width, state.height);
+    setCapability(scene.state, GL_DEPTH_TEST, true); // Enable depth testing
+    // Clear the color buffer && depth buffer
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // STREAM TEXTURES
+    updateTextureStreaming(scene.textures, scene.state);
+    unsigned int catTexture = useTexture(scene.textures, scene.catTexture);
+
+    // UPDATE SHARED UNIFORM BLOCKS
+    // One buffer write per frame covers every program using the blocks
+    FrameUniforms frameUniforms;
+    frameUniforms.view = state.view;
+    frameUniforms.projection = scene.projection;
+    frameUniforms.viewProjection = state.viewProjection;
+    frameUniforms.viewPos = glm::vec4(state.cameraPos, 1.0f);
+    LightUniforms lightUniforms;
+    lightUniforms.position = glm::vec4(scene.lightPos, 1.0f);
+    lightUniforms.color = glm::vec4(scene.lightColor, 1.0f);
+    beginUniformFrame(scene.uniformRing);
+    pushUniformBlock(scene.uniformRing, FRAME_UNIFORM_BINDING, &frameUniforms, sizeof(frameUniforms));
+    pushUniformBlock(scene.uniformRing, LIGHT_UNIFORM_BINDING, &lightUniforms, sizeof(lightUniforms));
+    endUniformFrame(scene.uniformRing);
 
-    // Loop until the user closes the window
-    while (!glfwWindowShouldClose(window))
+    // SUBMIT DRAWS
+    const glm::mat4* models = state.models;
+    const ObjectTransform* transforms = state.transforms;
+    clearRenderQueue(scene.queue);
+    // The textured cube
+    if (state.cubeVisible)
+    {
+        DrawCommand cube = meshDrawCommand(scene, scene.cube, models[CUBE_OBJECT], transforms[CUBE_OBJECT]);
+        setMaterial(scene, cube, catTexture, scene.cubeLayer);
+        if (scene.multiDraw)
+            useBatchMesh(scene, cube, 0);
+        submitDraw(scene.queue, drawSortKey(RENDER_PASS_OPAQUE, cube), cube);
+    }
+
+    // The loaded model
+    if (scene.model.indexCount > 0 && state.modelVisible)
+    {
+        DrawCommand model = meshDrawCommand(scene, scene.model, models[MODEL_OBJECT], transforms[MODEL_OBJECT]);
+        if (scene.atlas.texture)
+            setMaterial(scene, model, 0, scene.modelLayer);
+        if (scene.batchModelMesh >= 0)
+            useBatchMesh(scene, model, scene.batchModelMesh);
+        submitDraw(scene.queue, drawSortKey(RENDER_PASS_OPAQUE, model), model);
+    }
+
+    // The grid's visible cubes
+    int visibleInstances = state.visibleModels.size();
+    if (visibleInstances > 0 && scene.multiDraw)
+    {
+        // One draw per cube, the queue merges them into a single multi-draw
+        for (int i = 0; i < visibleInstances; i++)
+        {
+            DrawCommand draw = meshDrawCommand(scene, scene.cube, state.visibleModels[i], state.instanceTransforms[i]);
+            setMaterial(scene, draw, catTexture, scene.cubeLayer);
+            useBatchMesh(scene, draw, 0);
+            submitDraw(scene.queue, drawSortKey(RENDER_PASS_OPAQUE, draw), draw);
+        }
+    }
+    else if (visibleInstances > 0)
+    {
+        updateInstances(scene.cubeInstances, state.instances.data(), state.instances.size());
+
+        // The grid's origin stands in for its depth in the sort key
+        ObjectTransform gridTransform;
+        gridTransform.modelViewProjection = state.viewProjection;
+        gridTransform.normalMatrix = glm::mat3(1.0f);
+        DrawCommand grid = meshDrawCommand(scene, scene.cube, glm::mat4(1.0f), gridTransform);
+        grid.vertexArray = scene.cubeInstances.VAO;
+        setMaterial(scene, grid, catTexture, scene.cubeLayer);
+        grid.instanceCount = visibleInstances;
+        submitDraw(scene.queue, drawSortKey(RENDER_PASS_OPAQUE, grid), grid);
+    }
+
+    // The axes lines, plain float positions without lighting
+    DrawCommand axes = meshDrawCommand(scene, GpuMesh(), models[AXES_OBJECT], transforms[AXES_OBJECT]);
+    axes.vertexArray = scene.VAOLine;
+    axes.useLighting = false;
+    axes.primitive = GL_LINES;
+    axes.count = 6; // 6 vertices for the 3 lines
+    submitDraw(scene.queue, drawSortKey(RENDER_PASS_LINES, axes), axes);
+
+    executeRenderQueue(scene);
+}
+
+// Two frame states: while the render thread draws one, a worker simulates
+// the next into the other. The job counter is the hand-off, the render
+// thread waits on it (running jobs meanwhile) before touching the state.
+struct FramePipeline {
+    Scene* scene;
+    bool pipelined;         // false simulates on the render thread, one frame at a time
+    FrameState frames[2];
+    int submitted;          // frames handed to submitFrame
+    int rendered;           // frames returned by waitForFrame
+    FrameState* simulating; // written by the simulation job only
+    JobCounter simulated;
+};
+
+static void simulateFrameJob(void* data, int begin, int end) {
+    FramePipeline& pipeline = *(FramePipeline*)data;
+    simulateFrame(*pipeline.scene, *pipeline.simulating);
+}
+
+void initializeFramePipeline(FramePipeline& pipeline, Scene& scene, bool pipelined) {
+    pipeline.scene = &scene;
+    pipeline.pipelined = pipelined;
+    pipeline.submitted = 0;
+    pipeline.rendered = 0;
+}
+
+// Starts simulating a frame, call waitForFrame for the previous one first
+void submitFrame(FramePipeline& pipeline, float time, int width, int height) {
+    FrameState& state = pipeline.frames[pipeline.submitted % 2];
+    beginFrameState(state, *pipeline.scene, time, width, height);
+    pipeline.submitted++;
+    pipeline.simulating = &state;
+    if (pipeline.pipelined)
+        runJob(pipeline.scene->jobs, simulateFrameJob, &pipeline, &pipeline.simulated);
+    else
+        simulateFrame(*pipeline.scene, state);
+}
+
+// The oldest submitted frame, once its simulation is done. It stays valid
+// until the submitFrame after the next one.
+FrameState& waitForFrame(FramePipeline& pipeline) {
+    waitForCounter(pipeline.scene->jobs, pipeline.simulated);
+    return pipeline.frames[pipeline.rendered++ % 2];
+}
+
+// Takes a windowed frame's time and input and submits it
+void submitWindowedFrame(FramePipeline& pipeline, GLFWwindow* window, const LaunchOptions& options, int frame) {
+    float currentFrame;
+    if (options.benchmark)
+    {
+        // Scene time advances by a fixed step so the path is identical every run
+        currentFrame = frame * benchmarkFrameStep;
+        deltaTime = benchmarkFrameStep;
+        applyBenchmarkCameraPath(currentFrame);
+    }
+    else
     {
         // Calculate delta time
-        float currentFrame = glfwGetTime();
+        currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
         // setup keyboard input
         processInput(window);
-        // Resize the viewport
-        int width, height;
-        glfwGetFramebufferSize(window, &width, &height);
-        glViewport(0, 0, width, height);
-        // Clear the color buffer && depth buffer
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-
-        // UPDATE LIGHTING
-        glUniform3f(lightPosLoc, lightPos.x, lightPos.y, lightPos.z);
-        glUniform3f(lightColorLoc, lightColor.x, lightColor.y, lightColor.z);
-        glUniform3f(viewPosLoc, cameraPos.x, cameraPos.y, cameraPos.z);
-
-        // UPDATE CAMERA
-        // Update cameraFront from cameraYaw
-        glm::vec3 front;
-        front.x = cos(glm::radians(cameraYaw));
-        front.y = 0; // Keep the camera horizontal
-        front.z = sin(glm::radians(cameraYaw));
-        cameraFront = glm::normalize(front);
-        // Update camera view location
-        view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-
-        // DRAW THE CUBE
-        // Calculate the cube's rotation
-        float timeValue = glfwGetTime();
-        float angle = timeValue * glm::radians(50.0f);
-        glm::mat4 model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.5f, 1.0f, 0.0f));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        // Use lighting for rendering cube
-        GLint useLightingLocation = glGetUniformLocation(shaderProgram, "useLighting");
-        glUniform1i(useLightingLocation, GL_TRUE); 
-        // bind the vertex array
-        glBindVertexArray(VAO);
-        int numCubeVertices = sizeof(vertices) / (sizeof(float) * 6); // Update with your cube's vertices size
-        // bind the texture
-        glUniform1i(glGetUniformLocation(shaderProgram, "useTexture"), true); // Use the texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glUniform1i(glGetUniformLocation(shaderProgram, "texture1"), 0);
-        // Draw the cube
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        // DRAW THE AXES LINES
-        // Dont use lighting for axes lines
-        glUniform1i(glGetUniformLocation(shaderProgram, "useTexture"), false); // Don't use the texture
-        useLightingLocation = glGetUniformLocation(shaderProgram, "useLighting"); 
-        glUniform1i(useLightingLocation, GL_FALSE);
-        // bind the vertex array object
-        glBindVertexArray(VAOLine); 
-        glm::mat4 identityMatrix = glm::mat4(1.0f); // Identity matrix for axes
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(identityMatrix));
-        // unbind the texture
-        // Draw the axes lines
-        glDrawArrays(GL_LINES, 0, 6); // 6 vertices for the 3 lines
+    }
 
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    submitFrame(pipeline, currentFrame, width, height);
+}
+
+int runWindowed(const LaunchOptions& options) {
+    GLFWwindow* window = initializeWindow(options.width, options.height);
+    if (!window)
+    {
+        // Handle error
+        return -1;
+    }
+
+    // get window height and width
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+
+    Scene scene;
+    setupScene(scene, options, width, height);
+
+    BenchmarkRecorder recorder;
+    if (options.benchmark)
+    {
+        // Measure what we can render, not the display refresh rate
+        glfwSwapInterval(0);
+        initializeBenchmark(recorder, options.warmupFrames);
+    }
+    int frame = 0;
+    FramePipeline pipeline;
+    initializeFramePipeline(pipeline, scene, options.pipelined);
+    submitWindowedFrame(pipeline, window, options, frame);
+
+    // Loop until the user closes the window. Each frame's input is taken one
+    // iteration early, so its simulation overlaps the previous frame's draws.
+    for (bool finalFrame = false; !finalFrame; frame++)
+    {
+        if (options.benchmark)
+            beginBenchmarkFrame(recorder);
+        FrameState& state = waitForFrame(pipeline);
+        finalFrame = glfwWindowShouldClose(window) ||
+                    (options.benchmark && frame + 1 == options.warmupFrames + options.frameCount);
+        if (!finalFrame)
+            submitWindowedFrame(pipeline, window, options, frame + 1);
+
+        renderFrame(scene, state);
 
         // Swap front and back buffers
         glfwSwapBuffers(window);
         // Poll for and process events
         glfwPollEvents();
+
+        if (options.benchmark)
+            endBenchmarkFrame(recorder, scene.state.counters, state.culling);
     }
 
+    if (options.benchmark)
+    {
+        finishBenchmark(recorder);
+        writeBenchmarkResults(recorder, options.benchmarkOutput);
+    }
+
+    destroyTextureStreamer(scene.textures);
+    destroyUniformRing(scene.uniformRing);
+    if (scene.atlas.texture)
+        destroyTextureArray(scene.atlas);
+    stopJobSystem(scene.jobs);
     glfwDestroyWindow(window);
     glfwTerminate();
     return 0;
-}
\ No newline at end of file
+}
+
+int runHeadless(const LaunchOptions& options) {
+    if (!initializeHeadlessContext())
+    {
+        fputs("Failed to create a headless OpenGL context\n", stderr);
+        return -1;
+    }
+
+    OffscreenTarget target;
+    if (!createOffscreenTarget(target, options.width, options.height))
+    {
+        destroyHeadlessContext();
+        return -1;
+    }
+
+    if (!options.outputDir.empty())
+        mkdir(options.outputDir.c_str(), 0755);
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    Scene scene;
+    setupScene(scene, options, options.width, options.height);
+    // Written frames shouldn't depend on how fast the texture streamed in
+    if (!options.outputDir.empty())
+        finishTextureStreaming(scene.textures, scene.state);
+
+    BenchmarkRecorder recorder;
+    int totalFrames = options.frameCount;
+    if (options.benchmark)
+    {
+        initializeBenchmark(recorder, options.warmupFrames);
+        totalFrames += options.warmupFrames;
+    }
+
+    // Frames advance by a fixed 60Hz step so every run produces the same images,
+    // pipelined or not
+    deltaTime = benchmarkFrameStep;
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    FramePipeline pipeline;
+    initializeFramePipeline(pipeline, scene, options.pipelined);
+    if (options.benchmark)
+        applyBenchmarkCameraPath(0.0f);
+    submitFrame(pipeline, 0.0f, target.width, target.height);
+    int renderedFrames = 0;
+    bool writeFailed = false;
+    for (int frame = 0; frame < totalFrames; frame++)
+    {
+        if (options.benchmark)
+            beginBenchmarkFrame(recorder);
+        FrameState& state = waitForFrame(pipeline);
+        if (frame + 1 < totalFrames)
+        {
+            float time = (frame + 1) * benchmarkFrameStep;
+            if (options.benchmark)
+                applyBenchmarkCameraPath(time);
+            submitFrame(pipeline, time, target.width, target.height);
+        }
+
+        renderFrame(scene, state);
+
+        if (options.benchmark)
+        {
+            // There is no swap to bound the frame, wait for the GPU (or llvmpipe) instead
+            glFinish();
+            endBenchmarkFrame(recorder, scene.state.counters, state.culling);
+        }
+
+        if (!options.outputDir.empty())
+        {
+            char fileName[1024];
+            snprintf(fileName, sizeof(fileName), "%s/frame_%04d.ppm", options.outputDir.c_str(), frame);
+            if (!writeOffscreenTargetPPM(target, fileName))
+            {
+                writeFailed = true;
+                break;
+            }
+        }
+        renderedFrames++;
+    }
+    // A failed write leaves the next frame's simulation running
+    waitForCounter(scene.jobs, pipeline.simulated);
+    glFinish();
+    printf("Rendered %d headless frames at %dx%d\n", renderedFrames, target.width, target.height);
+
+    if (options.benchmark)
+    {
+        finishBenchmark(recorder);
+        writeBenchmarkResults(recorder, options.benchmarkOutput);
+    }
+
+    destroyTextureStreamer(scene.textures);
+    destroyUniformRing(scene.uniformRing);
+    if (scene.atlas.texture)
+        destroyTextureArray(scene.atlas);
+    stopJobSystem(scene.jobs);
+    destroyOffscreenTarget(target);
+    destroyHeadlessContext();
+    return writeFailed ? 1 : 0;
+}
+
+// Renders the headless scene with 1, 2, 4, ... workers up to the hardware
+// thread count and prints the CPU time per frame for each (simulating the
+// next frame included when pipelined). The GPU is waited for outside the
+// timed part, so only CPU work counts.
+int runJobBenchmark(const LaunchOptions& launchOptions) {
+    LaunchOptions options = launchOptions;
+    if (options.instanceCount == 0)
+        options.instanceCount = 10000;
+    if (!initializeHeadlessContext())
+    {
+        fputs("Failed to create a headless OpenGL context\n", stderr);
+        return -1;
+    }
+    OffscreenTarget target;
+    if (!createOffscreenTarget(target, options.width, options.height))
+    {
+        destroyHeadlessContext();
+        return -1;
+    }
+
+    Scene scene;
+    setupScene(scene, options, options.width, options.height);
+    finishTextureStreaming(scene.textures, scene.state);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    deltaTime = benchmarkFrameStep;
+
+    int maxWorkers = options.threadCount > 0 ? options.threadCount : std::max(1u, std::thread::hardware_concurrency());
+    printf("Frame CPU time, %d objects, %d frames:\n", options.instanceCount + 2, options.frameCount);
+    double singleWorkerMs = 0.0;
+    for (int workers = 1;; workers = std::min(workers * 2, maxWorkers))
+    {
+        stopJobSystem(scene.jobs);
+        startJobSystem(scene.jobs, workers);
+        std::vector<double> frameMs;
+        int totalFrames = options.warmupFrames + options.frameCount;
+        FramePipeline pipeline;
+        initializeFramePipeline(pipeline, scene, options.pipelined);
+        applyBenchmarkCameraPath(0.0f);
+        submitFrame(pipeline, 0.0f, target.width, target.height);
+        for (int frame = 0; frame < totalFrames; frame++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            FrameState& state = waitForFrame(pipeline);
+            if (frame + 1 < totalFrames)
+            {
+                float time = (frame + 1) * benchmarkFrameStep;
+                applyBenchmarkCameraPath(time);
+                submitFrame(pipeline, time, target.width, target.height);
+            }
+            renderFrame(scene, state);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            glFinish();
+            if (frame >= options.warmupFrames)
+                frameMs.push_back(ms);
+        }
+
+        double mean = 0.0;
+        for (size_t i = 0; i < frameMs.size(); i++)
+            mean += frameMs[i];
+        mean /= frameMs.size();
+        std::sort(frameMs.begin(), frameMs.end());
+        if (workers == 1)
+            singleWorkerMs = mean;
+        printf("  %2d workers: %8.3f ms mean, %8.3f ms p50, %5.2fx, %6.1f jobs stolen per frame\n", workers, mean,
+               frameMs[frameMs.size() / 2], singleWorkerMs / mean,
+               (double)scene.jobs.jobsStolen / (options.warmupFrames + options.frameCount));
+        if (workers == maxWorkers)
+            break;
+    }
+
+    destroyTextureStreamer(scene.textures);
+    destroyUniformRing(scene.uniformRing);
+    if (scene.atlas.texture)
+        destroyTextureArray(scene.atlas);
+    stopJobSystem(scene.jobs);
+    destroyOffscreenTarget(target);
+    destroyHeadlessContext();
+    return 0;
+}
+
+// Requests textureBenchmarkCount textures at once and streams them like the
+// render loop does, printing how long the requests took (the stall a scene
+// load would see), when every texture had its first level and when all were
+// resident. Stops after --frames frames if the budget keeps evicting.
+int runTextureBenchmark(const LaunchOptions& options) {
+    if (!initializeHeadlessContext())
+    {
+        fputs("Failed to create a headless OpenGL context\n", stderr);
+        return -1;
+    }
+    JobSystem jobs;
+    startJobSystem(jobs, options.threadCount);
+    TextureStreamer streamer;
+    createTextureStreamer(streamer, jobs, options.textureBudget);
+    RenderState state;
+    invalidateRenderState(state);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<int> handles;
+    for (int i = 0; i < options.textureBenchmarkCount; i++)
+        handles.push_back(requestTexture(streamer, options.textureFile.c_str(),
+                                         options.srgbTexture ? TEXTURE_USAGE_COLOR : TEXTURE_USAGE_DATA));
+    double requestMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    double firstLevelsMs = -1.0, residentMs = -1.0;
+    int frame = 0;
+    for (; frame < options.frameCount && residentMs < 0.0; frame++)
+    {
+        updateTextureStreaming(streamer, state);
+        int usable = 0;
+        for (size_t i = 0; i < handles.size(); i++)
+            usable += useTexture(streamer, handles[i]) != streamer.placeholder;
+        glFlush();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (firstLevelsMs < 0.0 && usable == (int)handles.size())
+            firstLevelsMs = ms;
+        if (streamer.stats.resident == streamer.stats.requested)
+            residentMs = ms;
+    }
+    glFinish();
+
+    const TextureStreamingStats& stats = streamer.stats;
+    printf("%d textures requested in %.3f ms (%d threads decoding)\n", options.textureBenchmarkCount, requestMs,
+           jobs.workerCount);
+    if (firstLevelsMs >= 0.0)
+        printf("All usable after %.1f ms\n", firstLevelsMs);
+    if (residentMs >= 0.0)
+        printf("All resident after %.1f ms, %d frames\n", residentMs, frame);
+    else
+        printf("%u of %u resident after %d frames\n", stats.resident, stats.requested, frame);
+    printf("Uploaded %.1f MB, %.1f MB resident, %u evictions\n", stats.uploadedBytes / 1048576.0,
+           stats.residentBytes / 1048576.0, stats.evictions);
+
+    destroyTextureStreamer(streamer);
+    stopJobSystem(jobs);
+    destroyHeadlessContext();
+    return 0;
+}
+
+// Software draw with the uniforms meshDrawCommand would give the shader
+SoftwareDraw softwareDraw(const Mesh& mesh, const glm::mat4& model, const ObjectTransform& transform,
+                          const SoftwareTexture* texture) {
+    SoftwareDraw draw;
+    draw.mesh = &mesh;
+    draw.lines = false;
+    draw.model = model;
+    draw.modelViewProjection = transform.modelViewProjection;
+    draw.normalMatrix = transform.normalMatrix;
+    draw.texture = texture;
+    draw.useLighting = true;
+    return draw;
+}
+
+// The headless scene rendered by the CPU rasterizer, for machines without a GPU
+int runSoftware(const LaunchOptions& options) {
+    Mesh cube;
+    buildCubeMesh(cube);
+    Mesh axes;
+    for (int i = 0; i < 6; i++)
+    {
+        Vertex vertex = {};
+        std::copy(&axisLinesVertices[i * 6], &axisLinesVertices[i * 6 + 3], vertex.position);
+        std::copy(&axisLinesVertices[i * 6 + 3], &axisLinesVertices[i * 6 + 6], vertex.color);
+        axes.vertices.push_back(vertex);
+        axes.indices.push_back(i);
+    }
+    Mesh model;
+    glm::mat4 modelFit(1.0f);
+    if (!options.meshFile.empty() && readMeshCache(options.meshFile.c_str(), model))
+        modelFit = fitModel(model.boundsMin, model.boundsMax);
+
+    SoftwareTexture texture;
+    TextureMip image;
+    int imgWidth, imgHeight, nrChannels;
+    const std::string& textureFile = options.textureFile;
+    if (textureFile.size() > 4 && textureFile.compare(textureFile.size() - 4, 4, ".tex") == 0)
+    {
+        // Blocks are decompressed, the rasterizer samples RGB8
+        if (readTextureCache(textureFile.c_str(), image))
+        {
+            texture.width = image.width;
+            texture.height = image.height;
+            texture.pixels.resize((size_t)image.width * image.height * 3);
+            for (size_t i = 0; i < texture.pixels.size() / 3; i++)
+                for (int k = 0; k < 3; k++)
+                    texture.pixels[i * 3 + k] = image.pixels[i * 4 + k];
+        }
+    }
+    else
+    {
+        unsigned char *data = stbi_load(textureFile.c_str(), &imgWidth, &imgHeight, &nrChannels, 3);
+        if (data)
+        {
+            texture.width = imgWidth;
+            texture.height = imgHeight;
+            texture.pixels.assign(data, data + imgWidth * imgHeight * 3);
+        }
+        stbi_image_free(data);
+    }
+    if (texture.pixels.empty())
+        std::cout << "Failed to load texture" << std::endl;
+
+    if (!options.outputDir.empty())
+        mkdir(options.outputDir.c_str(), 0755);
+
+    JobSystem jobs;
+    startJobSystem(jobs, options.threadCount);
+    SoftwareRenderer renderer;
+    SoftwareFramebuffer framebuffer;
+    resizeSoftwareFramebuffer(framebuffer, options.width, options.height);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)options.width / (float)options.height, 0.1f, 100.0f);
+    std::vector<glm::mat4> instanceModels;
+    std::vector<ObjectTransform> instanceTransforms;
+    std::vector<SoftwareDraw> draws;
+
+    // Same fixed 60Hz steps as runHeadless, so frames can be compared one to one
+    deltaTime = benchmarkFrameStep;
+    double totalSeconds = 0.0;
+    int renderedFrames = 0;
+    bool writeFailed = false;
+    for (int frame = 0; frame < options.frameCount; frame++)
+    {
+        float time = frame * benchmarkFrameStep;
+        if (options.benchmark)
+            applyBenchmarkCameraPath(time);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        glm::mat4 viewProjection = projection * updateCameraView();
+        glm::mat4 models[OBJECT_COUNT];
+        animateObjects(time, modelFit, models);
+        instanceModels.resize(options.instanceCount);
+        animateInstances(time, options.instanceCount, 0, options.instanceCount, instanceModels.data());
+        ObjectTransform transforms[OBJECT_COUNT];
+        computeObjectTransforms(viewProjection, models, OBJECT_COUNT, transforms);
+        instanceTransforms.resize(instanceModels.size());
+        computeObjectTransforms(viewProjection, instanceModels.data(), instanceModels.size(), instanceTransforms.data());
+
+        draws.clear();
+        draws.push_back(softwareDraw(cube, models[CUBE_OBJECT], transforms[CUBE_OBJECT], &texture));
+        if (!model.indices.empty())
+            draws.push_back(softwareDraw(model, models[MODEL_OBJECT], transforms[MODEL_OBJECT], NULL));
+        for (size_t i = 0; i < instanceModels.size(); i++)
+            draws.push_back(softwareDraw(cube, instanceModels[i], instanceTransforms[i], &texture));
+        SoftwareDraw axesDraw = softwareDraw(axes, models[AXES_OBJECT], transforms[AXES_OBJECT], NULL);
+        axesDraw.lines = true;
+        axesDraw.useLighting = false;
+        draws.push_back(axesDraw);
+
+        SoftwareLighting lighting;
+        lighting.viewPos = cameraPos;
+        lighting.lightPos = sceneLightPos;
+        lighting.lightColor = sceneLightColor;
+        renderSoftware(renderer, jobs, framebuffer, draws.data(), draws.size(), lighting, glm::vec3(0.0f, 0.0f, 0.0f));
+        double frameSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (!options.outputDir.empty())
+        {
+            char fileName[1024];
+            snprintf(fileName, sizeof(fileName), "%s/frame_%04d.ppm", options.outputDir.c_str(), frame);
+            if (!writeSoftwareFramebufferPPM(framebuffer, fileName))
+            {
+                writeFailed = true;
+                break;
+            }
+        }
+        totalSeconds += frameSeconds;
+        renderedFrames++;
+    }
+    stopJobSystem(jobs);
+    printf("Rendered %d software frames at %dx%d, %.3f ms per frame\n", renderedFrames,
+           options.width, options.height, totalSeconds * 1e3 / std::max(1, renderedFrames));
+    return writeFailed ? 1 : 0;
+}
+
+int convertMesh(const LaunchOptions& options) {
+    Mesh mesh;
+    if (!importModel(options.convertInput.c_str(), mesh))
+        return -1;
+    // Triangle and vertex order are baked into the cache, optimize them once here
+    MeshOptimizationReport report = optimizeMesh(mesh);
+    printf("Vertex cache: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+           report.before.acmr, report.after.acmr, report.before.atvr, report.after.atvr);
+    VertexFormat format = options.compactVertices ? VERTEX_FORMAT_COMPACT : VERTEX_FORMAT_FLOAT;
+    if (!writeMeshCache(mesh, options.convertOutput.c_str(), format))
+        return -1;
+    printf("Wrote %s: %d vertices (%d bytes each), %d triangles\n", options.convertOutput.c_str(),
+           (int)mesh.vertices.size(), vertexStride(format), (int)mesh.indices.size() / 3);
+    return 0;
+}
+
+// Bakes an image and its mip chain into a .tex, printing the size against
+// RGBA8 and the finest level's PSNR after the round trip through the blocks
+int convertTexture(const LaunchOptions& options) {
+    const char* input = options.convertTextureInput.c_str();
+    const char* output = options.convertTextureOutput.c_str();
+    int width, height, channels;
+    unsigned char* pixels = stbi_load(input, &width, &height, &channels, 4);
+    if (!pixels)
+    {
+        fprintf(stderr, "Failed to load texture %s\n", input);
+        return -1;
+    }
+    std::vector<TextureMip> mips(1);
+    mips[0].width = width;
+    mips[0].height = height;
+    mips[0].pixels.assign(pixels, pixels + (size_t)width * height * 4);
+    stbi_image_free(pixels);
+    // Offline, so the sharper filter is worth it
+    JobSystem jobs;
+    startJobSystem(jobs, options.threadCount);
+    MipChainSettings settings;
+    settings.filter = options.mipFilter;
+    settings.srgb = options.srgbTexture;
+    settings.jobs = &jobs;
+    std::chrono::steady_clock::time_point mipStart = std::chrono::steady_clock::now();
+    buildMipChain(mips, settings);
+    double mipMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mipStart).count();
+    stopJobSystem(jobs);
+
+    TextureFormat format = (TextureFormat)options.textureFormat;
+    if (options.textureFormat < 0)
+        format = channels == 2 || channels == 4 ? TEXTURE_FORMAT_BC3 : TEXTURE_FORMAT_BC1;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!writeTextureCache(mips, format, output))
+        return -1;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t bytes = 0, rgbaBytes = 0;
+    for (size_t i = 0; i < mips.size(); i++)
+    {
+        bytes += textureLevelSize(format, mips[i].width, mips[i].height);
+        rgbaBytes += mips[i].pixels.size();
+    }
+    TextureMip decoded;
+    if (!readTextureCache(output, decoded))
+        return -1;
+    double squaredError = 0.0;
+    for (size_t i = 0; i < decoded.pixels.size(); i++)
+    {
+        double delta = (double)decoded.pixels[i] - mips[0].pixels[i];
+        squaredError += delta * delta;
+    }
+    double meanSquaredError = squaredError / decoded.pixels.size();
+    printf("Wrote %s: %dx%d %s, %d levels, %.1f KB (%.1f KB as RGBA8), mips in %.1f ms, encoded in %.1f ms\n",
+           output, width, height, textureFormatName(format), (int)mips.size(), bytes / 1024.0, rgbaBytes / 1024.0,
+           mipMs, ms);
+    if (meanSquaredError > 0.0)
+        printf("Level 0 PSNR %.2f dB\n", 10.0 * log10(255.0 * 255.0 / meanSquaredError));
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    LaunchOptions options;
+    if (!parseCommandLine(argc, argv, options))
+        return -1;
+
+    if (!options.convertInput.empty())
+        return convertMesh(options);
+    if (!options.convertTextureInput.empty())
+        return convertTexture(options);
+    if (!options.objBenchmarkFile.empty())
+        return runObjParseBenchmark(options.objBenchmarkFile.c_str(), options.frameCount);
+    if (options.cullBenchmarkObjects > 0)
+        return runCullingBenchmark(options.cullBenchmarkObjects, options.frameCount);
+    if (options.bvhBenchmarkObjects > 0)
+        return runBvhBenchmark(options.bvhBenchmarkObjects, options.frameCount);
+    if (options.jobBenchmark)
+        return runJobBenchmark(options);
+    if (options.textureBenchmarkCount > 0)
+        return runTextureBenchmark(options);
+    if (options.mipBenchmark)
+        return runMipBenchmark(options.textureFile.c_str(), options.frameCount, options.threadCount);
+    if (options.software)
+        return runSoftware(options);
+    if (options.headless)
+        return runHeadless(options);
+    return runWindowed(options);
+}
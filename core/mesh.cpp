@@ -0,0 +1,139 @@
+#include "mesh.h"
+#include "opengl.h"
+#include <cfloat>
+#include <cstring>
+#include <unordered_map>
+
+void computeMeshBounds(Mesh& mesh) {
+    mesh.boundsMin = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    mesh.boundsMax = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        const float* p = mesh.vertices[i].position;
+        glm::vec3 position(p[0], p[1], p[2]);
+        mesh.boundsMin = glm::min(mesh.boundsMin, position);
+        mesh.boundsMax = glm::max(mesh.boundsMax, position);
+    }
+    if (mesh.vertices.empty())
+    {
+        mesh.boundsMin = glm::vec3(0.0f, 0.0f, 0.0f);
+        mesh.boundsMax = glm::vec3(0.0f, 0.0f, 0.0f);
+    }
+}
+
+// Vertices are compared bit for bit, the hash is FNV-1a over their bytes
+struct VertexHash {
+    size_t operator()(const Vertex& vertex) const {
+        const unsigned char* bytes = (const unsigned char*)&vertex;
+        size_t hash = 2166136261u;
+        for (size_t i = 0; i < sizeof(Vertex); i++)
+            hash = (hash ^ bytes[i]) * 16777619u;
+        return hash;
+    }
+};
+
+struct VertexEqual {
+    bool operator()(const Vertex& a, const Vertex& b) const {
+        return memcmp(&a, &b, sizeof(Vertex)) == 0;
+    }
+};
+
+void buildIndexedMesh(const Vertex* triangleVertices, size_t vertexCount, Mesh& mesh) {
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    mesh.indices.reserve(vertexCount);
+
+    std::unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> uniqueVertices;
+    uniqueVertices.reserve(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        std::pair<std::unordered_map<Vertex, unsigned int, VertexHash, VertexEqual>::iterator, bool> result =
+            uniqueVertices.insert(std::make_pair(triangleVertices[i], (unsigned int)mesh.vertices.size()));
+        if (result.second)
+            mesh.vertices.push_back(triangleVertices[i]);
+        mesh.indices.push_back(result.first->second);
+    }
+    computeMeshBounds(mesh);
+}
+
+void weldVertices(Mesh& mesh) {
+    std::vector<Vertex> corners(mesh.indices.size());
+    for (size_t i = 0; i < mesh.indices.size(); i++)
+        corners[i] = mesh.vertices[mesh.indices[i]];
+    buildIndexedMesh(corners.data(), corners.size(), mesh);
+}
+
+unsigned int chooseIndexSize(const Mesh& mesh) {
+    return mesh.vertices.size() <= 65536 ? 2 : 4;
+}
+
+std::vector<unsigned char> packIndices(const Mesh& mesh, unsigned int indexSize) {
+    std::vector<unsigned char> bytes(mesh.indices.size() * indexSize);
+    if (indexSize == 4)
+    {
+        if (!bytes.empty())
+            memcpy(bytes.data(), mesh.indices.data(), bytes.size());
+        return bytes;
+    }
+    unsigned short* shortIndices = (unsigned short*)bytes.data();
+    for (size_t i = 0; i < mesh.indices.size(); i++)
+        shortIndices[i] = (unsigned short)mesh.indices[i];
+    return bytes;
+}
+
+std::vector<unsigned char> packVertices(const Mesh& mesh, VertexFormat format) {
+    std::vector<unsigned char> bytes(mesh.vertices.size() * vertexStride(format));
+    if (bytes.empty())
+        return bytes;
+    if (format == VERTEX_FORMAT_COMPACT)
+    {
+        std::vector<CompactVertex> compact;
+        compressVertices(mesh.vertices, mesh.boundsMin, mesh.boundsMax, compact);
+        memcpy(bytes.data(), compact.data(), bytes.size());
+    }
+    else
+    {
+        memcpy(bytes.data(), mesh.vertices.data(), bytes.size());
+    }
+    return bytes;
+}
+
+void uploadMeshData(GpuMesh& gpuMesh, VertexFormat format, const void* vertexData, size_t vertexBytes,
+                    const void* indexData, size_t indexBytes, unsigned int indexSize) {
+    glGenVertexArrays(1, &gpuMesh.VAO);
+    glBindVertexArray(gpuMesh.VAO);
+
+    glGenBuffers(1, &gpuMesh.VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, gpuMesh.VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexData, GL_STATIC_DRAW);
+    setupVertexAttributes(format);
+    gpuMesh.vertexFormat = format;
+    if (format == VERTEX_FORMAT_COMPACT)
+        quantizationRange(gpuMesh.boundsMin, gpuMesh.boundsMax, gpuMesh.positionOffset, gpuMesh.positionScale);
+
+    // The element buffer binding is part of the VAO state
+    glGenBuffers(1, &gpuMesh.EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpuMesh.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indexData, GL_STATIC_DRAW);
+
+    gpuMesh.indexCount = indexBytes / indexSize;
+    gpuMesh.indexType = indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    glBindVertexArray(0);
+}
+
+void uploadMesh(GpuMesh& gpuMesh, const Mesh& mesh, VertexFormat format) {
+    unsigned int indexSize = chooseIndexSize(mesh);
+    std::vector<unsigned char> vertexBytes = packVertices(mesh, format);
+    std::vector<unsigned char> indexBytes = packIndices(mesh, indexSize);
+    gpuMesh.boundsMin = mesh.boundsMin;
+    gpuMesh.boundsMax = mesh.boundsMax;
+    uploadMeshData(gpuMesh, format, vertexBytes.data(), vertexBytes.size(),
+                   indexBytes.data(), indexBytes.size(), indexSize);
+}
+
+void destroyGpuMesh(GpuMesh& gpuMesh) {
+    glDeleteVertexArrays(1, &gpuMesh.VAO);
+    glDeleteBuffers(1, &gpuMesh.VBO);
+    glDeleteBuffers(1, &gpuMesh.EBO);
+    gpuMesh = GpuMesh();
+}
@@ -0,0 +1,69 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "vertex_format.h"
+
+// Interleaved vertex, same layout as the cube in main.cpp:
+// position, normal, color, texture coords (11 floats, 44 bytes)
+struct Vertex {
+    float position[3];
+    float normal[3];
+    float color[3];
+    float texCoord[2];
+};
+
+// CPU side triangle mesh
+struct Mesh {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+};
+
+// Mesh living in GPU buffers, ready for glDrawElements
+struct GpuMesh {
+    unsigned int VAO = 0;
+    unsigned int VBO = 0;
+    unsigned int EBO = 0;
+    unsigned int indexCount = 0;
+    unsigned int indexType = 0; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    VertexFormat vertexFormat = VERTEX_FORMAT_FLOAT;
+    // Empty at the origin until a mesh is uploaded, culling reads them either way
+    glm::vec3 boundsMin = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f, 0.0f, 0.0f);
+    // positionOffset/positionScale uniforms decoding compact positions,
+    // identity for float vertices
+    glm::vec3 positionOffset = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::vec3 positionScale = glm::vec3(1.0f, 1.0f, 1.0f);
+};
+
+void computeMeshBounds(Mesh& mesh);
+
+// Builds an indexed mesh from a flat triangle list, vertices that are
+// identical in every attribute are stored once and shared through indices
+void buildIndexedMesh(const Vertex* triangleVertices, size_t vertexCount, Mesh& mesh);
+
+// Merges identical vertices of an already indexed mesh and drops the unused ones
+void weldVertices(Mesh& mesh);
+
+// 2 when every index fits in 16 bits, 4 otherwise
+unsigned int chooseIndexSize(const Mesh& mesh);
+
+// Indices narrowed to the size picked by chooseIndexSize, as raw bytes
+std::vector<unsigned char> packIndices(const Mesh& mesh, unsigned int indexSize);
+
+// Vertex buffer contents of the mesh in the given format, as raw bytes
+std::vector<unsigned char> packVertices(const Mesh& mesh, VertexFormat format);
+
+// Creates VAO/VBO/EBO straight from raw vertex and index data, the data is
+// handed to glBufferData as is so it can point into a mapped file.
+// Bounds must be set beforehand when the format is compact.
+void uploadMeshData(GpuMesh& gpuMesh, VertexFormat format, const void* vertexData, size_t vertexBytes,
+                    const void* indexData, size_t indexBytes, unsigned int indexSize);
+// Uploads with 16-bit indices whenever the vertex count allows it
+void uploadMesh(GpuMesh& gpuMesh, const Mesh& mesh, VertexFormat format = VERTEX_FORMAT_FLOAT);
+void destroyGpuMesh(GpuMesh& gpuMesh);
+
+#endif
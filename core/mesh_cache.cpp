@@ -0,0 +1,173 @@
+#include "mesh_cache.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static unsigned long long alignTo16(unsigned long long offset) {
+    return (offset + 15) & ~15ULL;
+}
+
+bool writeMeshCache(const Mesh& mesh, const char* fileName, VertexFormat format) {
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "JBMS", 4);
+    header.version = MESH_CACHE_VERSION;
+    header.vertexCount = mesh.vertices.size();
+    header.indexCount = mesh.indices.size();
+    header.vertexStride = vertexStride(format);
+    header.indexSize = chooseIndexSize(mesh);
+    header.vertexFormat = format;
+    for (int i = 0; i < 3; i++)
+    {
+        header.boundsMin[i] = mesh.boundsMin[i];
+        header.boundsMax[i] = mesh.boundsMax[i];
+    }
+    std::vector<unsigned char> packedVertices = packVertices(mesh, format);
+    size_t vertexBytes = packedVertices.size();
+    std::vector<unsigned char> packedIndices = packIndices(mesh, header.indexSize);
+    size_t indexBytes = packedIndices.size();
+    header.vertexOffset = alignTo16(sizeof(header));
+    header.indexOffset = alignTo16(header.vertexOffset + vertexBytes);
+
+    FILE* file = fopen(fileName, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "Failed to open %s for writing\n", fileName);
+        return false;
+    }
+    static const char padding[16] = { 0 };
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(padding, 1, header.vertexOffset - sizeof(header), file);
+    fwrite(packedVertices.data(), 1, vertexBytes, file);
+    fwrite(padding, 1, header.indexOffset - (header.vertexOffset + vertexBytes), file);
+    fwrite(packedIndices.data(), 1, indexBytes, file);
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+// True when every index of the blob points at one of the vertices
+static bool indicesInRange(const unsigned char* indices, unsigned int indexCount, unsigned int indexSize,
+                           unsigned int vertexCount) {
+    for (unsigned int i = 0; i < indexCount; i++)
+    {
+        unsigned int index = indexSize == 2 ? ((const unsigned short*)indices)[i] : ((const unsigned int*)indices)[i];
+        if (index >= vertexCount)
+            return false;
+    }
+    return true;
+}
+
+// The offsets are untrusted, adding them to a size could wrap. Both blobs
+// are read through vertex and index pointers, so they must be 4 byte aligned.
+static bool blobInFile(unsigned long long offset, size_t bytes, size_t fileSize) {
+    return offset % 4 == 0 && offset <= fileSize && bytes <= fileSize - offset;
+}
+
+// Maps a mesh cache and checks its header and indices, the caller unmaps fileSize bytes
+static const MeshCacheHeader* mapMeshCache(const char* fileName, size_t& fileSize) {
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open mesh cache %s\n", fileName);
+        return NULL;
+    }
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) != 0 || (size_t)fileInfo.st_size < sizeof(MeshCacheHeader))
+    {
+        fprintf(stderr, "Mesh cache %s is truncated\n", fileName);
+        close(fd);
+        return NULL;
+    }
+    fileSize = fileInfo.st_size;
+    void* mapping = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map mesh cache %s\n", fileName);
+        return NULL;
+    }
+
+    const MeshCacheHeader* header = (const MeshCacheHeader*)mapping;
+    size_t vertexBytes = (size_t)header->vertexCount * header->vertexStride;
+    size_t indexBytes = (size_t)header->indexCount * header->indexSize;
+    bool valid = memcmp(header->magic, "JBMS", 4) == 0 &&
+                 header->version == MESH_CACHE_VERSION &&
+                 (header->vertexFormat == VERTEX_FORMAT_FLOAT || header->vertexFormat == VERTEX_FORMAT_COMPACT) &&
+                 header->vertexStride == vertexStride((VertexFormat)header->vertexFormat) &&
+                 (header->indexSize == 2 || header->indexSize == 4) &&
+                 blobInFile(header->vertexOffset, vertexBytes, fileSize) &&
+                 blobInFile(header->indexOffset, indexBytes, fileSize);
+    if (!valid)
+    {
+        fprintf(stderr, "Mesh cache %s is invalid or from another version\n", fileName);
+        munmap(mapping, fileSize);
+        return NULL;
+    }
+    // A corrupt index would send every consumer (GPU draws, software and
+    // occlusion rasterizers, the optimizer) past the end of the vertices
+    if (!indicesInRange((const unsigned char*)mapping + header->indexOffset, header->indexCount, header->indexSize,
+                        header->vertexCount))
+    {
+        fprintf(stderr, "Mesh cache %s has indices past its %u vertices\n", fileName, header->vertexCount);
+        munmap(mapping, fileSize);
+        return NULL;
+    }
+    return header;
+}
+
+bool loadMeshCache(const char* fileName, GpuMesh& gpuMesh) {
+    size_t fileSize;
+    const MeshCacheHeader* header = mapMeshCache(fileName, fileSize);
+    if (!header)
+        return false;
+
+    const unsigned char* bytes = (const unsigned char*)header;
+    size_t vertexBytes = (size_t)header->vertexCount * header->vertexStride;
+    size_t indexBytes = (size_t)header->indexCount * header->indexSize;
+    gpuMesh.boundsMin = glm::vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]);
+    gpuMesh.boundsMax = glm::vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]);
+    // Pages are faulted in by the driver as it copies them into the buffers
+    uploadMeshData(gpuMesh, (VertexFormat)header->vertexFormat, bytes + header->vertexOffset, vertexBytes,
+                   bytes + header->indexOffset, indexBytes, header->indexSize);
+
+    munmap((void*)header, fileSize);
+    return true;
+}
+
+bool readMeshCache(const char* fileName, Mesh& mesh) {
+    size_t fileSize;
+    const MeshCacheHeader* header = mapMeshCache(fileName, fileSize);
+    if (!header)
+        return false;
+
+    const unsigned char* bytes = (const unsigned char*)header;
+    mesh.boundsMin = glm::vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]);
+    mesh.boundsMax = glm::vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]);
+    if (header->vertexFormat == VERTEX_FORMAT_COMPACT)
+    {
+        decompressVertices((const CompactVertex*)(bytes + header->vertexOffset), header->vertexCount,
+                           mesh.boundsMin, mesh.boundsMax, mesh.vertices);
+    }
+    else
+    {
+        const Vertex* vertices = (const Vertex*)(bytes + header->vertexOffset);
+        mesh.vertices.assign(vertices, vertices + header->vertexCount);
+    }
+
+    mesh.indices.resize(header->indexCount);
+    const unsigned char* indices = bytes + header->indexOffset;
+    for (unsigned int i = 0; i < header->indexCount; i++)
+    {
+        if (header->indexSize == 2)
+            mesh.indices[i] = ((const unsigned short*)indices)[i];
+        else
+            mesh.indices[i] = ((const unsigned int*)indices)[i];
+    }
+
+    munmap((void*)header, fileSize);
+    return true;
+}
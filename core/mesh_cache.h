@@ -0,0 +1,37 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "mesh.h"
+
+// Packed binary mesh format (.mesh), produced offline with --convert-mesh.
+// Layout: MeshCacheHeader, then the interleaved vertex blob (Vertex or
+// CompactVertex, see vertexFormat), then the index
+// blob, each blob starting on a 16 byte boundary. Everything is little
+// endian and stored exactly as it is uploaded to the GPU.
+struct MeshCacheHeader {
+    char magic[4];            // "JBMS"
+    unsigned int version;
+    unsigned int vertexCount;
+    unsigned int indexCount;
+    unsigned int vertexStride; // sizeof(Vertex) or sizeof(CompactVertex)
+    unsigned int indexSize;    // 2 or 4 bytes
+    unsigned int vertexFormat; // VertexFormat
+    float boundsMin[3];
+    float boundsMax[3];
+    unsigned long long vertexOffset;
+    unsigned long long indexOffset;
+};
+
+const unsigned int MESH_CACHE_VERSION = 2;
+
+bool writeMeshCache(const Mesh& mesh, const char* fileName, VertexFormat format = VERTEX_FORMAT_FLOAT);
+
+// Memory-maps the file and hands the vertex/index blobs directly to
+// glBufferData, no intermediate copy or parsing.
+bool loadMeshCache(const char* fileName, GpuMesh& gpuMesh);
+
+// Reads the file back into a CPU mesh with float vertices, for code that
+// has no GL context (the software rasterizer)
+bool readMeshCache(const char* fileName, Mesh& mesh);
+
+#endif
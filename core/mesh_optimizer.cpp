@@ -0,0 +1,317 @@
+#include "mesh_optimizer.h"
+#include <math.h>
+#include <algorithm>
+
+// Cache size the vertex scores are tuned for, larger than real FIFOs on purpose
+static const int SCORE_CACHE_SIZE = 32;
+// FIFO size used to find cluster boundaries for the overdraw pass
+static const unsigned int FIFO_CACHE_SIZE = 16;
+
+// Simulates one vertex reference against a FIFO cache. `clock` counts
+// misses, a vertex stays cached until FIFO_CACHE_SIZE newer misses happened.
+static inline bool fifoCacheMiss(unsigned int vertex, std::vector<unsigned int>& insertedAt, unsigned int& clock) {
+    if (insertedAt[vertex] != 0 && clock - insertedAt[vertex] < FIFO_CACHE_SIZE)
+        return false;
+    clock++;
+    insertedAt[vertex] = clock;
+    return true;
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize) {
+    // FIFO cache: a vertex is a hit if it was inserted less than cacheSize misses ago
+    std::vector<unsigned int> insertedAt(vertexCount, 0);
+    unsigned int misses = 0;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int vertex = indices[i];
+        if (insertedAt[vertex] == 0 || misses - insertedAt[vertex] + 1 > (unsigned int)cacheSize)
+        {
+            misses++;
+            insertedAt[vertex] = misses;
+        }
+    }
+
+    VertexCacheStats stats;
+    size_t triangleCount = indices.size() / 3;
+    stats.acmr = triangleCount > 0 ? (float)misses / triangleCount : 0.0f;
+    stats.atvr = vertexCount > 0 ? (float)misses / vertexCount : 0.0f;
+    return stats;
+}
+
+static float vertexScore(int cachePosition, unsigned int liveTriangles) {
+    if (liveTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        // The last triangle's vertices get a fixed score so strips don't win by default
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+            score = powf(1.0f - (cachePosition - 3) / (float)(SCORE_CACHE_SIZE - 3), 1.5f);
+    }
+    // Boost vertices with few triangles left so they get finished off
+    score += 2.0f * powf((float)liveTriangles, -0.5f);
+    return score;
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Triangle adjacency per vertex, the first liveTriangles[v] entries are still unemitted
+    std::vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        liveTriangles[indices[i]]++;
+    std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = t;
+
+    std::vector<float> scores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        scores[v] = vertexScore(-1, liveTriangles[v]);
+
+    std::vector<bool> emitted(triangleCount, false);
+    int bestTriangle = 0;
+    float bestScore = -1.0f;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const unsigned int* corners = &indices[t * 3];
+        float score = scores[corners[0]] + scores[corners[1]] + scores[corners[2]];
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestTriangle = t;
+        }
+    }
+
+    std::vector<unsigned int> output;
+    output.reserve(triangleCount * 3);
+    unsigned int cache[SCORE_CACHE_SIZE + 3];
+    unsigned int newCache[SCORE_CACHE_SIZE + 3];
+    int cacheCount = 0;
+    size_t nextUnemitted = 0;
+
+    for (size_t step = 0; step < triangleCount; step++)
+    {
+        if (bestTriangle < 0)
+        {
+            // Nothing adjacent to the cache is left, continue in input order
+            while (emitted[nextUnemitted])
+                nextUnemitted++;
+            bestTriangle = nextUnemitted;
+        }
+
+        const unsigned int* corners = &indices[bestTriangle * 3];
+        output.push_back(corners[0]);
+        output.push_back(corners[1]);
+        output.push_back(corners[2]);
+        emitted[bestTriangle] = true;
+
+        // Remove the triangle from its vertices' live lists
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int vertex = corners[k];
+            unsigned int* list = &adjacency[adjacencyOffset[vertex]];
+            unsigned int count = liveTriangles[vertex];
+            for (unsigned int i = 0; i < count; i++)
+            {
+                if (list[i] == (unsigned int)bestTriangle)
+                {
+                    list[i] = list[count - 1];
+                    break;
+                }
+            }
+            liveTriangles[vertex]--;
+        }
+
+        // The emitted triangle moves to the front of the cache
+        int newCount = 0;
+        for (int k = 0; k < 3; k++)
+            newCache[newCount++] = corners[k];
+        for (int i = 0; i < cacheCount; i++)
+        {
+            unsigned int vertex = cache[i];
+            if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2])
+                newCache[newCount++] = vertex;
+        }
+        // Vertices pushed out of the cache lose their cache bonus
+        for (int i = SCORE_CACHE_SIZE; i < newCount; i++)
+            scores[newCache[i]] = vertexScore(-1, liveTriangles[newCache[i]]);
+        cacheCount = std::min(newCount, SCORE_CACHE_SIZE);
+        std::copy(newCache, newCache + cacheCount, cache);
+
+        // Rescore everything in the cache and pick the best triangle touching it
+        for (int i = 0; i < cacheCount; i++)
+            scores[cache[i]] = vertexScore(i, liveTriangles[cache[i]]);
+        bestTriangle = -1;
+        bestScore = -1.0f;
+        for (int i = 0; i < cacheCount; i++)
+        {
+            unsigned int vertex = cache[i];
+            const unsigned int* list = &adjacency[adjacencyOffset[vertex]];
+            for (unsigned int j = 0; j < liveTriangles[vertex]; j++)
+            {
+                unsigned int triangle = list[j];
+                const unsigned int* triangleCorners = &indices[triangle * 3];
+                float score = scores[triangleCorners[0]] + scores[triangleCorners[1]] + scores[triangleCorners[2]];
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestTriangle = triangle;
+                }
+            }
+        }
+    }
+
+    indices.swap(output);
+}
+
+struct TriangleCluster {
+    size_t firstTriangle;
+    size_t triangleCount;
+    float sortKey;
+};
+
+// Cache misses of the triangles [first, last) with a cache that starts cold
+static unsigned int countClusterMisses(const std::vector<unsigned int>& indices, size_t first, size_t last,
+                                       std::vector<unsigned int>& insertedAt, unsigned int& clock) {
+    // Stamps from before the bump are all old enough to miss
+    clock += FIFO_CACHE_SIZE;
+    unsigned int misses = 0;
+    for (size_t i = first * 3; i < last * 3; i++)
+        misses += fifoCacheMiss(indices[i], insertedAt, clock);
+    return misses;
+}
+
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Hard boundaries: triangles where all three vertices miss the cache, the
+    // cache ordering restarts there so moving clusters around costs nothing
+    std::vector<size_t> hardStarts;
+    {
+        std::vector<unsigned int> insertedAt(vertices.size(), 0);
+        unsigned int clock = 0;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            int misses = 0;
+            for (int k = 0; k < 3; k++)
+                misses += fifoCacheMiss(indices[t * 3 + k], insertedAt, clock);
+            if (misses == 3 || t == 0)
+                hardStarts.push_back(t);
+        }
+    }
+    hardStarts.push_back(triangleCount);
+
+    // Soft boundaries: split a hard cluster wherever the part so far is
+    // already nearly as cache friendly as the whole cluster
+    std::vector<TriangleCluster> clusters;
+    std::vector<unsigned int> insertedAt(vertices.size(), 0);
+    unsigned int clock = 0;
+    for (size_t c = 0; c + 1 < hardStarts.size(); c++)
+    {
+        size_t first = hardStarts[c];
+        size_t last = hardStarts[c + 1];
+        float clusterAcmr = (float)countClusterMisses(indices, first, last, insertedAt, clock) / (last - first);
+
+        size_t start = first;
+        unsigned int misses = 0;
+        clock += FIFO_CACHE_SIZE;
+        for (size_t t = first; t < last; t++)
+        {
+            for (int k = 0; k < 3; k++)
+                misses += fifoCacheMiss(indices[t * 3 + k], insertedAt, clock);
+            size_t count = t + 1 - start;
+            if (t + 1 == last || (float)misses / count <= clusterAcmr * threshold)
+            {
+                TriangleCluster cluster = { start, count, 0.0f };
+                clusters.push_back(cluster);
+                start = t + 1;
+                misses = 0;
+                clock += FIFO_CACHE_SIZE;
+            }
+        }
+    }
+
+    // Sort key: how much the cluster faces away from the mesh center
+    glm::vec3 meshCenter(0.0f, 0.0f, 0.0f);
+    float meshArea = 0.0f;
+    std::vector<glm::vec3> clusterCenters(clusters.size());
+    std::vector<glm::vec3> clusterNormals(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        glm::vec3 center(0.0f, 0.0f, 0.0f);
+        glm::vec3 normal(0.0f, 0.0f, 0.0f);
+        float area = 0.0f;
+        for (size_t t = clusters[c].firstTriangle; t < clusters[c].firstTriangle + clusters[c].triangleCount; t++)
+        {
+            const float* a = vertices[indices[t * 3]].position;
+            const float* b = vertices[indices[t * 3 + 1]].position;
+            const float* d = vertices[indices[t * 3 + 2]].position;
+            glm::vec3 p0(a[0], a[1], a[2]), p1(b[0], b[1], b[2]), p2(d[0], d[1], d[2]);
+            glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+            float faceArea = glm::length(faceNormal);
+            center += (p0 + p1 + p2) * (faceArea / 3.0f);
+            normal += faceNormal;
+            area += faceArea;
+        }
+        meshCenter += center;
+        meshArea += area;
+        clusterCenters[c] = area > 0.0f ? center / area : center;
+        clusterNormals[c] = glm::length(normal) > 0.0f ? glm::normalize(normal) : normal;
+    }
+    if (meshArea > 0.0f)
+        meshCenter = meshCenter / meshArea;
+    for (size_t c = 0; c < clusters.size(); c++)
+        clusters[c].sortKey = glm::dot(clusterCenters[c] - meshCenter, clusterNormals[c]);
+
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [](const TriangleCluster& a, const TriangleCluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        size_t first = clusters[c].firstTriangle * 3;
+        output.insert(output.end(), indices.begin() + first, indices.begin() + first + clusters[c].triangleCount * 3);
+    }
+    indices.swap(output);
+}
+
+void optimizeVertexFetch(Mesh& mesh) {
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(mesh.vertices.size(), unused);
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.indices.size(); i++)
+    {
+        unsigned int& newIndex = remap[mesh.indices[i]];
+        if (newIndex == unused)
+        {
+            newIndex = vertices.size();
+            vertices.push_back(mesh.vertices[mesh.indices[i]]);
+        }
+        mesh.indices[i] = newIndex;
+    }
+    mesh.vertices.swap(vertices);
+}
+
+MeshOptimizationReport optimizeMesh(Mesh& mesh) {
+    MeshOptimizationReport report;
+    report.before = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+    optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    optimizeOverdraw(mesh.indices, mesh.vertices);
+    optimizeVertexFetch(mesh);
+    report.after = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+    return report;
+}
@@ -0,0 +1,39 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+#include "mesh.h"
+
+// Results of running an index buffer through a simulated FIFO vertex cache
+struct VertexCacheStats {
+    float acmr; // average cache miss ratio: transformed vertices per triangle (0.5 - 3)
+    float atvr; // average transformed vertex ratio: transformed / unique vertices (1 is ideal)
+};
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize = 16);
+
+// Reorders triangles for the post-transform vertex cache (Forsyth's linear-speed
+// algorithm): greedily emits the triangle whose vertices score best, where
+// recently used vertices and vertices with few remaining triangles score high.
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+// Reorders clusters of an already cache optimized index buffer so triangles
+// facing outwards from the mesh center are drawn first and occlude the rest
+// (Sander et al. "Fast triangle reordering"). Clusters are split at cache
+// restarts and wherever the local ACMR stays under threshold times the
+// cluster ACMR, so threshold trades cache efficiency for overdraw.
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+// Renumbers vertices in the order the index buffer first uses them so vertex
+// fetch walks memory linearly, unused vertices are dropped.
+void optimizeVertexFetch(Mesh& mesh);
+
+struct MeshOptimizationReport {
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+// Runs the three passes above in order
+MeshOptimizationReport optimizeMesh(Mesh& mesh);
+
+#endif
@@ -0,0 +1,357 @@
+#include "mip_chain.h"
+#include <math.h>
+#include <algorithm>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Kaiser windowed sinc reaching 3 destination pixels each side: 12 source taps
+static const int KAISER_TAPS = 12;
+static const float KAISER_WIDTH = 3.0f;
+static const float KAISER_ALPHA = 4.0f;
+// Linear to sRGB lookup resolution, fine enough to round dark values right
+static const int SRGB_TABLE_SIZE = 8192;
+// Fewer rows than this per job aren't worth the scheduling
+static const int MIN_ROWS_PER_JOB = 8;
+
+struct MipTables {
+    float toLinear[256];
+    float toUnorm[256];     // i / 255, for linear channels
+    unsigned char fromLinear[SRGB_TABLE_SIZE];
+    float kaiser[KAISER_TAPS];
+};
+
+// Modified Bessel function of the first kind, order 0
+static double bessel0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static MipTables buildMipTables() {
+    MipTables tables;
+    for (int i = 0; i < 256; i++)
+    {
+        double value = i / 255.0;
+        tables.toLinear[i] = value <= 0.04045 ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4);
+        tables.toUnorm[i] = value;
+    }
+    for (int i = 0; i < SRGB_TABLE_SIZE; i++)
+    {
+        double value = i / (double)(SRGB_TABLE_SIZE - 1);
+        double encoded = value <= 0.0031308 ? value * 12.92 : 1.055 * pow(value, 1.0 / 2.4) - 0.055;
+        tables.fromLinear[i] = (unsigned char)(encoded * 255.0 + 0.5);
+    }
+    // Tap k reads source pixel 2x - 5 + k, whose center is k - 5.5 source
+    // pixels from the destination pixel's center
+    double total = 0.0, weights[KAISER_TAPS];
+    for (int k = 0; k < KAISER_TAPS; k++)
+    {
+        double t = (k - 5.5) / 2.0;
+        double sinc = sin(M_PI * t) / (M_PI * t);
+        double window = t / KAISER_WIDTH;
+        weights[k] = sinc * bessel0(KAISER_ALPHA * sqrt(std::max(0.0, 1.0 - window * window))) / bessel0(KAISER_ALPHA);
+        total += weights[k];
+    }
+    for (int k = 0; k < KAISER_TAPS; k++)
+        tables.kaiser[k] = weights[k] / total;
+    return tables;
+}
+
+static const MipTables& mipTables() {
+    static const MipTables tables = buildMipTables();
+    return tables;
+}
+
+// One RGBA pixel of floats at a time, the four channels fill a SIMD register
+struct ScalarPixels {
+    struct Pixel {
+        float v[4];
+    };
+    static Pixel zero() {
+        Pixel pixel = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+        return pixel;
+    }
+    static Pixel load(const float* p) {
+        Pixel pixel = { { p[0], p[1], p[2], p[3] } };
+        return pixel;
+    }
+    static void store(float* p, const Pixel& a) {
+        for (int c = 0; c < 4; c++)
+            p[c] = a.v[c];
+    }
+    static Pixel add(const Pixel& a, const Pixel& b) {
+        Pixel pixel;
+        for (int c = 0; c < 4; c++)
+            pixel.v[c] = a.v[c] + b.v[c];
+        return pixel;
+    }
+    // sum + a * weight
+    static Pixel multiplyAdd(const Pixel& sum, const Pixel& a, float weight) {
+        Pixel pixel;
+        for (int c = 0; c < 4; c++)
+            pixel.v[c] = sum.v[c] + a.v[c] * weight;
+        return pixel;
+    }
+    static Pixel scale(const Pixel& a, float factor) {
+        return multiplyAdd(zero(), a, factor);
+    }
+    static Pixel saturate(const Pixel& a) {
+        Pixel pixel;
+        for (int c = 0; c < 4; c++)
+            pixel.v[c] = std::min(1.0f, std::max(0.0f, a.v[c]));
+        return pixel;
+    }
+};
+
+#if defined(__SSE__)
+struct SimdPixels {
+    typedef __m128 Pixel;
+    static Pixel zero() { return _mm_setzero_ps(); }
+    static Pixel load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, Pixel a) { _mm_storeu_ps(p, a); }
+    static Pixel add(Pixel a, Pixel b) { return _mm_add_ps(a, b); }
+    static Pixel multiplyAdd(Pixel sum, Pixel a, float weight) { return _mm_add_ps(sum, _mm_mul_ps(a, _mm_set1_ps(weight))); }
+    static Pixel scale(Pixel a, float factor) { return _mm_mul_ps(a, _mm_set1_ps(factor)); }
+    static Pixel saturate(Pixel a) { return _mm_min_ps(_mm_max_ps(a, _mm_setzero_ps()), _mm_set1_ps(1.0f)); }
+};
+#elif defined(__ARM_NEON)
+struct SimdPixels {
+    typedef float32x4_t Pixel;
+    static Pixel zero() { return vdupq_n_f32(0.0f); }
+    static Pixel load(const float* p) { return vld1q_f32(p); }
+    static void store(float* p, Pixel a) { vst1q_f32(p, a); }
+    static Pixel add(Pixel a, Pixel b) { return vaddq_f32(a, b); }
+    static Pixel multiplyAdd(Pixel sum, Pixel a, float weight) { return vmlaq_n_f32(sum, a, weight); }
+    static Pixel scale(Pixel a, float factor) { return vmulq_n_f32(a, factor); }
+    static Pixel saturate(Pixel a) { return vminq_f32(vmaxq_f32(a, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f)); }
+};
+#else
+typedef ScalarPixels SimdPixels;
+#endif
+
+// Level in linear float RGBA, 4 floats per pixel
+struct FloatLevel {
+    int width, height;
+    std::vector<float> pixels;
+};
+
+// What the row jobs of one level read and write
+struct MipLevelWork {
+    const MipChainSettings* settings;
+    const MipTables* tables;
+    const TextureMip* image;    // level 0 bytes, read by linearizeRowsJob
+    FloatLevel* source;
+    FloatLevel* filtered;       // Kaiser: horizontally filtered, destination width by source height
+    FloatLevel* destination;
+    TextureMip* mip;            // destination quantized back to bytes
+};
+
+// Row y of the source level as floats. Level 0 never exists in float, its
+// rows are linearized into scratch (a row of floats) as they are read.
+static const float* sourceRow(const MipLevelWork& work, int y, float* scratch) {
+    if (!work.image)
+        return &work.source->pixels[(size_t)y * work.source->width * 4];
+    const float* color = work.settings->srgb ? work.tables->toLinear : work.tables->toUnorm;
+    const float* alpha = work.tables->toUnorm;
+    const unsigned char* in = &work.image->pixels[(size_t)y * work.image->width * 4];
+    float* out = scratch;
+    for (int x = 0; x < work.image->width; x++, in += 4, out += 4)
+    {
+        out[0] = color[in[0]];
+        out[1] = color[in[1]];
+        out[2] = color[in[2]];
+        out[3] = alpha[in[3]];
+    }
+    return scratch;
+}
+
+// Destination values are already within [0, 1]
+static void quantizeRow(const MipLevelWork& work, int y) {
+    const float* in = &work.destination->pixels[(size_t)y * work.destination->width * 4];
+    unsigned char* out = &work.mip->pixels[(size_t)y * work.mip->width * 4];
+    int width = work.mip->width;
+    if (work.settings->srgb)
+    {
+        const unsigned char* fromLinear = work.tables->fromLinear;
+        for (int x = 0; x < width; x++, in += 4, out += 4)
+        {
+            out[0] = fromLinear[(int)(in[0] * (SRGB_TABLE_SIZE - 1) + 0.5f)];
+            out[1] = fromLinear[(int)(in[1] * (SRGB_TABLE_SIZE - 1) + 0.5f)];
+            out[2] = fromLinear[(int)(in[2] * (SRGB_TABLE_SIZE - 1) + 0.5f)];
+            out[3] = (unsigned char)(in[3] * 255.0f + 0.5f);
+        }
+    }
+    else
+    {
+        for (int x = 0; x < width * 4; x++)
+            out[x] = (unsigned char)(in[x] * 255.0f + 0.5f);
+    }
+}
+
+// 2x2 box filter, odd edges repeat the last row or column
+template <class Ops>
+static void boxRowsJob(void* data, int begin, int end) {
+    const MipLevelWork& work = *(const MipLevelWork*)data;
+    const FloatLevel& source = *work.source;
+    FloatLevel& destination = *work.destination;
+    std::vector<float> scratch(work.image ? (size_t)source.width * 8 : 0);
+    for (int y = begin; y < end; y++)
+    {
+        const float* row0 = sourceRow(work, std::min(y * 2, source.height - 1), scratch.data());
+        const float* row1 = sourceRow(work, std::min(y * 2 + 1, source.height - 1), scratch.data() + source.width * 4);
+        float* out = &destination.pixels[(size_t)y * destination.width * 4];
+        for (int x = 0; x < destination.width; x++)
+        {
+            int x0 = std::min(x * 2, source.width - 1) * 4, x1 = std::min(x * 2 + 1, source.width - 1) * 4;
+            typename Ops::Pixel sum = Ops::add(Ops::add(Ops::load(row0 + x0), Ops::load(row0 + x1)),
+                                               Ops::add(Ops::load(row1 + x0), Ops::load(row1 + x1)));
+            Ops::store(out + x * 4, Ops::scale(sum, 0.25f));
+        }
+        quantizeRow(work, y);
+    }
+}
+
+// Horizontal Kaiser pass over source rows; edges clamp. A 1 pixel wide
+// source can't shrink and is copied.
+template <class Ops>
+static void kaiserRowsJob(void* data, int begin, int end) {
+    const MipLevelWork& work = *(const MipLevelWork*)data;
+    const FloatLevel& source = *work.source;
+    FloatLevel& filtered = *work.filtered;
+    const float* weights = work.tables->kaiser;
+    std::vector<float> scratch(work.image ? (size_t)source.width * 4 : 0);
+    for (int y = begin; y < end; y++)
+    {
+        const float* in = sourceRow(work, y, scratch.data());
+        float* out = &filtered.pixels[(size_t)y * filtered.width * 4];
+        if (source.width == 1)
+        {
+            Ops::store(out, Ops::load(in));
+            continue;
+        }
+        for (int x = 0; x < filtered.width; x++)
+        {
+            typename Ops::Pixel sum = Ops::zero();
+            int first = x * 2 - KAISER_TAPS / 2 + 1;
+            if (first >= 0 && first + KAISER_TAPS <= source.width)
+            {
+                for (int k = 0; k < KAISER_TAPS; k++)
+                    sum = Ops::multiplyAdd(sum, Ops::load(in + (first + k) * 4), weights[k]);
+            }
+            else
+            {
+                for (int k = 0; k < KAISER_TAPS; k++)
+                {
+                    int sx = std::min(std::max(first + k, 0), source.width - 1);
+                    sum = Ops::multiplyAdd(sum, Ops::load(in + sx * 4), weights[k]);
+                }
+            }
+            Ops::store(out + x * 4, sum);
+        }
+    }
+}
+
+// Vertical Kaiser pass into destination rows, clamped to [0, 1] since the
+// negative lobes can overshoot
+template <class Ops>
+static void kaiserColumnsJob(void* data, int begin, int end) {
+    const MipLevelWork& work = *(const MipLevelWork*)data;
+    const FloatLevel& filtered = *work.filtered;
+    FloatLevel& destination = *work.destination;
+    const float* weights = work.tables->kaiser;
+    size_t rowFloats = (size_t)destination.width * 4;
+    for (int y = begin; y < end; y++)
+    {
+        float* out = &destination.pixels[y * rowFloats];
+        if (filtered.height == 1)
+        {
+            std::copy(filtered.pixels.begin(), filtered.pixels.begin() + rowFloats, out);
+        }
+        else
+        {
+            const float* rows[KAISER_TAPS];
+            for (int k = 0; k < KAISER_TAPS; k++)
+            {
+                int sy = std::min(std::max(y * 2 - KAISER_TAPS / 2 + 1 + k, 0), filtered.height - 1);
+                rows[k] = &filtered.pixels[sy * rowFloats];
+            }
+            for (size_t i = 0; i < rowFloats; i += 4)
+            {
+                typename Ops::Pixel sum = Ops::zero();
+                for (int k = 0; k < KAISER_TAPS; k++)
+                    sum = Ops::multiplyAdd(sum, Ops::load(rows[k] + i), weights[k]);
+                Ops::store(out + i, Ops::saturate(sum));
+            }
+        }
+        quantizeRow(work, y);
+    }
+}
+
+static void runRows(const MipChainSettings& settings, JobFunction function, MipLevelWork& work, int rows) {
+    if (!settings.jobs)
+    {
+        function(&work, 0, rows);
+        return;
+    }
+    JobCounter counter;
+    parallelFor(*settings.jobs, function, &work, rows, MIN_ROWS_PER_JOB, &counter);
+    waitForCounter(*settings.jobs, counter);
+}
+
+void buildMipChain(std::vector<TextureMip>& mips, const MipChainSettings& settings) {
+    mips.resize(1);
+    // Level 0 is read while the others are appended, it must not move
+    int levelCount = 1;
+    for (int size = std::max(mips[0].width, mips[0].height); size > 1; size /= 2)
+        levelCount++;
+    mips.reserve(levelCount);
+    MipLevelWork work;
+    work.settings = &settings;
+    work.tables = &mipTables();
+
+    FloatLevel levels[2], filtered;
+    levels[0].width = mips[0].width;
+    levels[0].height = mips[0].height;
+
+    JobFunction boxRows = settings.scalar ? boxRowsJob<ScalarPixels> : boxRowsJob<SimdPixels>;
+    JobFunction kaiserRows = settings.scalar ? kaiserRowsJob<ScalarPixels> : kaiserRowsJob<SimdPixels>;
+    JobFunction kaiserColumns = settings.scalar ? kaiserColumnsJob<ScalarPixels> : kaiserColumnsJob<SimdPixels>;
+    for (int level = 1; mips.back().width > 1 || mips.back().height > 1; level++)
+    {
+        // Levels ping-pong between two float buffers
+        FloatLevel& source = levels[(level - 1) % 2];
+        FloatLevel& destination = levels[level % 2];
+        destination.width = std::max(1, source.width / 2);
+        destination.height = std::max(1, source.height / 2);
+        destination.pixels.resize((size_t)destination.width * destination.height * 4);
+        mips.push_back(TextureMip());
+        TextureMip& mip = mips.back();
+        mip.width = destination.width;
+        mip.height = destination.height;
+        mip.pixels.resize((size_t)mip.width * mip.height * 4);
+        work.image = level == 1 ? &mips[0] : NULL;
+        work.source = &source;
+        work.destination = &destination;
+        work.mip = &mip;
+
+        if (settings.filter == MIP_FILTER_KAISER)
+        {
+            filtered.width = destination.width;
+            filtered.height = source.height;
+            filtered.pixels.resize((size_t)filtered.width * filtered.height * 4);
+            work.filtered = &filtered;
+            runRows(settings, kaiserRows, work, source.height);
+            runRows(settings, kaiserColumns, work, destination.height);
+        }
+        else
+            runRows(settings, boxRows, work, destination.height);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef MIP_CHAIN_H
+#define MIP_CHAIN_H
+
+#include <vector>
+#include "job_system.h"
+
+// Pixels of one mip level, rows bottom-up like glTexSubImage2D expects. RGBA8
+// for buildMipChain, streamed levels may hold another PixelFormat.
+struct TextureMip {
+    int width, height;
+    std::vector<unsigned char> pixels;
+};
+
+enum MipFilter {
+    MIP_FILTER_BOX,     // 2x2 average, cheap, a little blurry and aliased
+    MIP_FILTER_KAISER   // Kaiser windowed sinc over 12 taps, sharper, for offline cooking
+};
+
+struct MipChainSettings {
+    MipFilter filter = MIP_FILTER_BOX;
+    bool srgb = true;           // RGB is sRGB encoded color and is filtered in linear light, alpha is always linear
+    JobSystem* jobs = NULL;     // rows of each level are split across its workers, NULL filters on the caller
+    bool scalar = false;        // plain C++ filters instead of SSE/NEON, for comparison in the benchmark
+};
+
+// Appends levels to mips[0] down to 1x1. Levels are filtered from the
+// previous one kept in float, so rounding doesn't build up down the chain.
+void buildMipChain(std::vector<TextureMip>& mips, const MipChainSettings& settings = MipChainSettings());
+
+#endif
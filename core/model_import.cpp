@@ -0,0 +1,84 @@
+#include "model_import.h"
+#include "obj_parser.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+static bool hasExtension(const char* fileName, const char* extension) {
+    size_t nameLength = strlen(fileName);
+    size_t extensionLength = strlen(extension);
+    return nameLength >= extensionLength &&
+           strcasecmp(fileName + nameLength - extensionLength, extension) == 0;
+}
+
+bool importModel(const char* fileName, Mesh& mesh) {
+    if (hasExtension(fileName, ".obj"))
+    {
+        ObjModel model;
+        if (!parseObjFile(fileName, model))
+            return false;
+        mesh.vertices.swap(model.mesh.vertices);
+        mesh.indices.swap(model.mesh.indices);
+        mesh.boundsMin = model.mesh.boundsMin;
+        mesh.boundsMax = model.mesh.boundsMax;
+        return true;
+    }
+    return importModelWithAssimp(fileName, mesh);
+}
+
+bool importModelWithAssimp(const char* fileName, Mesh& mesh) {
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(fileName,
+                                             aiProcess_Triangulate |
+                                             aiProcess_FlipUVs |
+                                             aiProcess_GenNormals |
+                                             aiProcess_JoinIdenticalVertices);
+    if (!scene)
+    {
+        fprintf(stderr, "Failed to import %s: %s\n", fileName, importer.GetErrorString());
+        return false;
+    }
+
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+    {
+        const aiMesh* source = scene->mMeshes[m];
+        unsigned int baseVertex = mesh.vertices.size();
+
+        for (unsigned int i = 0; i < source->mNumVertices; i++)
+        {
+            Vertex vertex;
+            vertex.position[0] = source->mVertices[i].x;
+            vertex.position[1] = source->mVertices[i].y;
+            vertex.position[2] = source->mVertices[i].z;
+            vertex.normal[0] = source->HasNormals() ? source->mNormals[i].x : 0.0f;
+            vertex.normal[1] = source->HasNormals() ? source->mNormals[i].y : 0.0f;
+            vertex.normal[2] = source->HasNormals() ? source->mNormals[i].z : 0.0f;
+            // Models without vertex colors are white so lighting shows through
+            vertex.color[0] = source->HasVertexColors(0) ? source->mColors[0][i].r : 1.0f;
+            vertex.color[1] = source->HasVertexColors(0) ? source->mColors[0][i].g : 1.0f;
+            vertex.color[2] = source->HasVertexColors(0) ? source->mColors[0][i].b : 1.0f;
+            vertex.texCoord[0] = source->HasTextureCoords(0) ? source->mTextureCoords[0][i].x : 0.0f;
+            vertex.texCoord[1] = source->HasTextureCoords(0) ? source->mTextureCoords[0][i].y : 0.0f;
+            mesh.vertices.push_back(vertex);
+        }
+
+        for (unsigned int f = 0; f < source->mNumFaces; f++)
+        {
+            const aiFace& face = source->mFaces[f];
+            // Triangulate leaves points and lines as they are, skip those
+            if (face.mNumIndices != 3)
+                continue;
+            for (unsigned int i = 0; i < 3; i++)
+                mesh.indices.push_back(baseVertex + face.mIndices[i]);
+        }
+    }
+
+    computeMeshBounds(mesh);
+    return true;
+}
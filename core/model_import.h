@@ -0,0 +1,14 @@
+#ifndef MODEL_IMPORT_H
+#define MODEL_IMPORT_H
+
+#include "mesh.h"
+
+// Loads a model file (e.g. models/suzanne.obj) into one indexed Mesh with
+// computed bounds. .obj files go through our own parser (obj_parser.h),
+// any other format falls back to Assimp.
+bool importModel(const char* fileName, Mesh& mesh);
+
+// Assimp path, merges all meshes of the scene
+bool importModelWithAssimp(const char* fileName, Mesh& mesh);
+
+#endif
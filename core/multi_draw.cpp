@@ -0,0 +1,200 @@
+#include "multi_draw.h"
+#include "opengl.h"
+#include <stdio.h>
+
+bool multiDrawIndirectSupported() {
+#ifdef GL_VERSION_4_3
+    int major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    return major > 4 || (major == 4 && minor >= 3);
+#else
+    return false;
+#endif
+}
+
+static unsigned int bufferSize(unsigned int buffer) {
+    GLint size = 0;
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+    return size;
+}
+
+// Grows the per-draw buffers so `draws` draws fit
+static void reserveDraws(MeshBatch& batch, size_t draws) {
+    if (draws <= batch.drawCapacity)
+        return;
+    size_t capacity = batch.drawCapacity ? batch.drawCapacity : 64;
+    while (capacity < draws)
+        capacity *= 2;
+
+    std::vector<unsigned int> drawIds(capacity);
+    for (size_t i = 0; i < capacity; i++)
+        drawIds[i] = i;
+    glBindBuffer(GL_ARRAY_BUFFER, batch.drawIdBuffer);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(unsigned int), drawIds.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch.indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, batch.drawDataBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(MultiDrawData), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    batch.drawCapacity = capacity;
+}
+
+bool createMeshBatch(MeshBatch& batch, const GpuMesh* const* meshes, size_t count) {
+    if (count == 0)
+        return false;
+    batch.vertexFormat = meshes[0]->vertexFormat;
+    unsigned int stride = vertexStride(batch.vertexFormat);
+
+    // Indices are read back and widened to 32 bits, meshes may mix index sizes
+    std::vector<unsigned int> indices;
+    std::vector<unsigned int> vertexBytes(count);
+    unsigned int totalVertexBytes = 0;
+    batch.meshes.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        const GpuMesh& mesh = *meshes[i];
+        if (mesh.vertexFormat != batch.vertexFormat)
+        {
+            fputs("Meshes of a batch must share their vertex format\n", stderr);
+            return false;
+        }
+        BatchedMesh batched;
+        batched.firstIndex = indices.size();
+        batched.indexCount = mesh.indexCount;
+        batched.baseVertex = totalVertexBytes / stride;
+        batched.positionOffset = mesh.positionOffset;
+        batched.positionScale = mesh.positionScale;
+        batch.meshes.push_back(batched);
+
+        vertexBytes[i] = bufferSize(mesh.VBO);
+        totalVertexBytes += vertexBytes[i];
+
+        // Read through the copy target, the element binding belongs to a VAO
+        glBindBuffer(GL_COPY_READ_BUFFER, mesh.EBO);
+        if (mesh.indexType == GL_UNSIGNED_SHORT)
+        {
+            std::vector<unsigned short> narrow(mesh.indexCount);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, 0, narrow.size() * sizeof(unsigned short), narrow.data());
+            indices.insert(indices.end(), narrow.begin(), narrow.end());
+        }
+        else
+        {
+            indices.resize(indices.size() + mesh.indexCount);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, 0, mesh.indexCount * sizeof(unsigned int),
+                               &indices[batched.firstIndex]);
+        }
+    }
+
+    glGenVertexArrays(1, &batch.VAO);
+    glBindVertexArray(batch.VAO);
+
+    // Vertices are copied on the GPU, they never come back to the CPU
+    glGenBuffers(1, &batch.VBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, batch.VBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, totalVertexBytes, NULL, GL_STATIC_DRAW);
+    unsigned int offset = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, meshes[i]->VBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, offset, vertexBytes[i]);
+        offset += vertexBytes[i];
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, batch.VBO);
+    setupVertexAttributes(batch.vertexFormat);
+
+    glGenBuffers(1, &batch.EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &batch.drawIdBuffer);
+    glGenBuffers(1, &batch.indirectBuffer);
+    glGenBuffers(1, &batch.drawDataBuffer);
+    batch.drawCapacity = 0;
+    reserveDraws(batch, 64);
+
+    // Draw index, advancing once per instance so baseInstance selects it
+    glBindBuffer(GL_ARRAY_BUFFER, batch.drawIdBuffer);
+    glEnableVertexAttribArray(DRAW_ID_ATTRIBUTE_LOCATION);
+    glVertexAttribIPointer(DRAW_ID_ATTRIBUTE_LOCATION, 1, GL_UNSIGNED_INT, 0, (void*)0);
+    glVertexAttribDivisor(DRAW_ID_ATTRIBUTE_LOCATION, 1);
+    glBindVertexArray(0);
+
+    glGenTextures(1, &batch.drawDataTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, batch.drawDataTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, batch.drawDataBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    return glGetError() == GL_NO_ERROR;
+}
+
+void destroyMeshBatch(MeshBatch& batch) {
+    glDeleteVertexArrays(1, &batch.VAO);
+    unsigned int buffers[] = { batch.VBO, batch.EBO, batch.drawIdBuffer, batch.indirectBuffer, batch.drawDataBuffer };
+    glDeleteBuffers(5, buffers);
+    glDeleteTextures(1, &batch.drawDataTexture);
+    batch = MeshBatch();
+}
+
+void addBatchDraw(MeshBatch& batch, unsigned int mesh, const glm::mat4& model, const glm::mat3& normalMatrix,
+                  int textureLayer) {
+    const BatchedMesh& batched = batch.meshes[mesh];
+    DrawElementsIndirectCommand command;
+    command.count = batched.indexCount;
+    command.instanceCount = 1;
+    command.firstIndex = batched.firstIndex;
+    command.baseVertex = batched.baseVertex;
+    command.baseInstance = batch.commands.size();
+    batch.commands.push_back(command);
+
+    MultiDrawData data;
+    data.model = model;
+    for (int i = 0; i < 3; i++)
+        data.normalMatrix[i] = glm::vec4(normalMatrix[i], 0.0f);
+    data.positionOffset = glm::vec4(batched.positionOffset, (float)textureLayer);
+    data.positionScale = glm::vec4(batched.positionScale, 0.0f);
+    batch.drawData.push_back(data);
+}
+
+void flushBatchDraws(MeshBatch& batch, bool useMultiDrawIndirect, ShaderProgram& shader, int drawOffsetSlot) {
+    size_t drawCount = batch.commands.size();
+    if (drawCount == 0)
+        return;
+    reserveDraws(batch, drawCount);
+
+    // Orphan and refill, the previous frame's draws may still read the old storage
+    glBindBuffer(GL_TEXTURE_BUFFER, batch.drawDataBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, batch.drawCapacity * sizeof(MultiDrawData), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, drawCount * sizeof(MultiDrawData), batch.drawData.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+#ifdef GL_VERSION_4_3
+    if (useMultiDrawIndirect)
+    {
+        shader.setInt(drawOffsetSlot, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch.indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, batch.drawCapacity * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, drawCount * sizeof(DrawElementsIndirectCommand), batch.commands.data());
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, drawCount, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    else
+#endif
+    {
+        // GL 4.1: baseInstance must be 0, the draw ID attribute reads 0 and
+        // the uniform supplies the index
+        for (size_t i = 0; i < drawCount; i++)
+        {
+            const DrawElementsIndirectCommand& command = batch.commands[i];
+            shader.setInt(drawOffsetSlot, i);
+            glDrawElementsBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+                                     (void*)(command.firstIndex * sizeof(unsigned int)), command.baseVertex);
+        }
+    }
+
+    batch.commands.clear();
+    batch.drawData.clear();
+}
@@ -0,0 +1,75 @@
+#ifndef MULTI_DRAW_H
+#define MULTI_DRAW_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "mesh.h"
+#include "shader_program.h"
+
+// Layout glDrawElementsIndirect / glMultiDrawElementsIndirect read
+struct DrawElementsIndirectCommand {
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+};
+
+// Per-draw data the vertex shader fetches from a buffer texture (RGBA32F,
+// 9 texels per draw) instead of per-object uniforms
+struct MultiDrawData {
+    glm::mat4 model;
+    glm::vec4 normalMatrix[3]; // columns, w unused
+    glm::vec4 positionOffset;  // compact vertex decoding, w is the texture array layer
+    glm::vec4 positionScale;
+};
+
+// Where one of the batch's meshes lives inside the shared buffers
+struct BatchedMesh {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    int baseVertex;
+    glm::vec3 positionOffset;
+    glm::vec3 positionScale;
+};
+
+const unsigned int DRAW_ID_ATTRIBUTE_LOCATION = 11;
+const int DRAW_DATA_TEXTURE_UNIT = 1;
+
+// Meshes sharing a vertex format packed into one vertex and one index buffer
+// so any number of them can be drawn with a single glMultiDrawElementsIndirect.
+// The shader can't use gl_DrawID on GL 4.1, so the draw index arrives through
+// an instanced attribute (0, 1, 2...) selected by each command's baseInstance.
+// On contexts older than 4.3 the commands are issued in a loop with
+// glDrawElementsBaseVertex and the index is passed in the drawOffset uniform.
+struct MeshBatch {
+    unsigned int VAO = 0;
+    unsigned int VBO = 0;
+    unsigned int EBO = 0;
+    unsigned int drawIdBuffer = 0;
+    unsigned int indirectBuffer = 0;
+    unsigned int drawDataBuffer = 0;
+    unsigned int drawDataTexture = 0;
+    size_t drawCapacity = 0;
+    VertexFormat vertexFormat = VERTEX_FORMAT_FLOAT;
+    std::vector<BatchedMesh> meshes;
+    // Draws collected since the last flush
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<MultiDrawData> drawData;
+};
+
+// True when the context and headers provide glMultiDrawElementsIndirect (GL 4.3)
+bool multiDrawIndirectSupported();
+
+// Copies the meshes' buffers into the batch, they must share a vertex
+// format. Mesh i of the batch is meshes[i].
+bool createMeshBatch(MeshBatch& batch, const GpuMesh* const* meshes, size_t count);
+void destroyMeshBatch(MeshBatch& batch);
+
+void addBatchDraw(MeshBatch& batch, unsigned int mesh, const glm::mat4& model, const glm::mat3& normalMatrix,
+                  int textureLayer = 0);
+// Uploads the collected draws and issues them, with one multi-draw call or
+// the fallback loop. The batch VAO and draw data texture must be bound.
+void flushBatchDraws(MeshBatch& batch, bool useMultiDrawIndirect, ShaderProgram& shader, int drawOffsetSlot);
+
+#endif
@@ -0,0 +1,560 @@
+#include "obj_parser.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <climits>
+#include <algorithm>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Files smaller than this per thread are not worth splitting
+static const size_t MIN_CHUNK_BYTES = 256 * 1024;
+static const int MISSING_INDEX = INT_MIN;
+
+// One triangle corner. Indices are zero based and global, except the ones
+// flagged in `relative` which came from negative OBJ indices and are still
+// relative to the start of their chunk.
+struct ObjCorner {
+    int index[3]; // position, texture coord, normal
+    unsigned char relative;
+};
+
+// g/o or usemtl seen before corner `cornerIndex` of the chunk
+struct ObjEvent {
+    unsigned int cornerIndex;
+    bool isMaterial;
+    std::string name;
+};
+
+struct ObjChunk {
+    const char* begin;
+    const char* end;
+    std::vector<float> positions; // xyz
+    std::vector<float> texCoords; // uv
+    std::vector<float> normals;   // xyz
+    std::vector<ObjCorner> corners;
+    std::vector<ObjEvent> events;
+    std::vector<std::string> materialLibraries;
+    bool failed;
+};
+
+static const double powersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+// Decimal float parser without locale lookups or allocation. Keeps up to 19
+// significant digits in an integer mantissa and scales once at the end,
+// which is exact for the values exporters write out in practice.
+static const char* parseFloat(const char* p, const char* end, float& value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+
+    unsigned long long mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    const char* start = p;
+    for (; p < end && isDigit(*p); p++)
+    {
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa != 0)
+                digits++;
+        }
+        else
+        {
+            exponent++;
+        }
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && isDigit(*p); p++)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+                if (mantissa != 0)
+                    digits++;
+            }
+        }
+    }
+    if (p == start)
+    {
+        value = 0.0f;
+        return start;
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+'))
+        {
+            negativeExponent = *q == '-';
+            q++;
+        }
+        if (q < end && isDigit(*q))
+        {
+            int e = 0;
+            for (; q < end && isDigit(*q); q++)
+                e = e < 10000 ? e * 10 + (*q - '0') : e;
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+
+    double result = (double)mantissa;
+    if (exponent < 0)
+        result = exponent >= -22 ? result / powersOf10[-exponent] : result * pow(10.0, exponent);
+    else if (exponent > 0)
+        result = exponent <= 22 ? result * powersOf10[exponent] : result * pow(10.0, exponent);
+    value = (float)(negative ? -result : result);
+    return p;
+}
+
+static const char* parseInt(const char* p, const char* end, int& value, bool& found) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+    long long result = 0;
+    found = false;
+    for (; p < end && isDigit(*p); p++)
+    {
+        result = result < INT_MAX ? result * 10 + (*p - '0') : result;
+        found = true;
+    }
+    value = (int)(negative ? -result : result);
+    return p;
+}
+
+static const char* parseFloats(const char* p, const char* end, std::vector<float>& out, int count) {
+    for (int i = 0; i < count; i++)
+    {
+        float value;
+        p = parseFloat(skipSpaces(p, end), end, value);
+        out.push_back(value);
+    }
+    return p;
+}
+
+static std::string restOfLine(const char* p, const char* end) {
+    p = skipSpaces(p, end);
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t'))
+        end--;
+    return std::string(p, end);
+}
+
+// Parses one "v/vt/vn" token of a face
+static const char* parseCorner(const char* p, const char* end, const ObjChunk& chunk, ObjCorner& corner) {
+    int counts[3] = {
+        (int)(chunk.positions.size() / 3),
+        (int)(chunk.texCoords.size() / 2),
+        (int)(chunk.normals.size() / 3)
+    };
+    corner.relative = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        corner.index[k] = MISSING_INDEX;
+        if (k > 0)
+        {
+            if (p >= end || *p != '/')
+                continue;
+            p++;
+        }
+        int value;
+        bool found;
+        p = parseInt(p, end, value, found);
+        if (!found || value == 0)
+            continue;
+        if (value > 0)
+        {
+            corner.index[k] = value - 1;
+        }
+        else
+        {
+            corner.index[k] = counts[k] + value;
+            corner.relative |= 1 << k;
+        }
+    }
+    return p;
+}
+
+static void parseChunk(ObjChunk* chunk) {
+    const char* p = chunk->begin;
+    const char* end = chunk->end;
+    std::vector<ObjCorner> polygon;
+
+    while (p < end)
+    {
+        const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+        if (!lineEnd)
+            lineEnd = end;
+        const char* next = lineEnd + 1;
+        if (lineEnd > p && lineEnd[-1] == '\r')
+            lineEnd--;
+
+        p = skipSpaces(p, lineEnd);
+        size_t length = lineEnd - p;
+        if (length >= 2 && p[0] == 'v' && p[1] == ' ')
+        {
+            parseFloats(p + 2, lineEnd, chunk->positions, 3);
+        }
+        else if (length >= 3 && p[0] == 'v' && p[1] == 't' && p[2] == ' ')
+        {
+            parseFloats(p + 3, lineEnd, chunk->texCoords, 2);
+        }
+        else if (length >= 3 && p[0] == 'v' && p[1] == 'n' && p[2] == ' ')
+        {
+            parseFloats(p + 3, lineEnd, chunk->normals, 3);
+        }
+        else if (length >= 2 && p[0] == 'f' && p[1] == ' ')
+        {
+            polygon.clear();
+            const char* q = skipSpaces(p + 2, lineEnd);
+            while (q < lineEnd)
+            {
+                ObjCorner corner;
+                const char* after = parseCorner(q, lineEnd, *chunk, corner);
+                if (after == q || corner.index[0] == MISSING_INDEX)
+                {
+                    chunk->failed = true;
+                    break;
+                }
+                polygon.push_back(corner);
+                q = skipSpaces(after, lineEnd);
+            }
+            // Fan triangulation, fine for the convex polygons exporters write
+            for (size_t i = 2; i < polygon.size(); i++)
+            {
+                chunk->corners.push_back(polygon[0]);
+                chunk->corners.push_back(polygon[i - 1]);
+                chunk->corners.push_back(polygon[i]);
+            }
+        }
+        else if (length >= 1 && (p[0] == 'g' || p[0] == 'o') && (length == 1 || p[1] == ' ' || p[1] == '\t'))
+        {
+            ObjEvent event = { (unsigned int)chunk->corners.size(), false, restOfLine(p + 1, lineEnd) };
+            chunk->events.push_back(event);
+        }
+        else if (length > 7 && strncmp(p, "usemtl", 6) == 0 && (p[6] == ' ' || p[6] == '\t'))
+        {
+            ObjEvent event = { (unsigned int)chunk->corners.size(), true, restOfLine(p + 6, lineEnd) };
+            chunk->events.push_back(event);
+        }
+        else if (length > 7 && strncmp(p, "mtllib", 6) == 0 && (p[6] == ' ' || p[6] == '\t'))
+        {
+            const char* q = skipSpaces(p + 6, lineEnd);
+            while (q < lineEnd)
+            {
+                const char* nameEnd = q;
+                while (nameEnd < lineEnd && *nameEnd != ' ' && *nameEnd != '\t')
+                    nameEnd++;
+                chunk->materialLibraries.push_back(std::string(q, nameEnd));
+                q = skipSpaces(nameEnd, lineEnd);
+            }
+        }
+        p = next;
+    }
+}
+
+// Open addressing table from (position, texture coord, normal) to the welded
+// vertex index, much cheaper than std::unordered_map for millions of corners
+struct CornerTable {
+    std::vector<int> keys; // 3 ints per slot
+    std::vector<unsigned int> values;
+    size_t mask;
+    size_t used;
+
+    explicit CornerTable(size_t expected) : used(0) {
+        size_t capacity = 16;
+        while (capacity < expected * 2)
+            capacity *= 2;
+        allocate(capacity);
+    }
+
+    void allocate(size_t capacity) {
+        keys.assign(capacity * 3, MISSING_INDEX);
+        values.assign(capacity, 0);
+        mask = capacity - 1;
+    }
+
+    static size_t hash(const int* key) {
+        return (size_t)key[0] * 73856093u ^ (size_t)key[1] * 19349663u ^ (size_t)key[2] * 83492791u;
+    }
+
+    size_t findSlot(const int* key) const {
+        size_t slot = hash(key) & mask;
+        while (keys[slot * 3] != MISSING_INDEX &&
+               (keys[slot * 3] != key[0] || keys[slot * 3 + 1] != key[1] || keys[slot * 3 + 2] != key[2]))
+            slot = (slot + 1) & mask;
+        return slot;
+    }
+
+    // Keeps the load factor under one half
+    void grow() {
+        std::vector<int> oldKeys;
+        std::vector<unsigned int> oldValues;
+        oldKeys.swap(keys);
+        oldValues.swap(values);
+        allocate(oldValues.size() * 2);
+        for (size_t i = 0; i < oldValues.size(); i++)
+        {
+            if (oldKeys[i * 3] == MISSING_INDEX)
+                continue;
+            size_t slot = findSlot(&oldKeys[i * 3]);
+            memcpy(&keys[slot * 3], &oldKeys[i * 3], sizeof(int) * 3);
+            values[slot] = oldValues[i];
+        }
+    }
+
+    // Returns the existing vertex for the key or stores newValue for it
+    unsigned int findOrInsert(const int* key, unsigned int newValue, bool& inserted) {
+        size_t slot = findSlot(key);
+        if (keys[slot * 3] != MISSING_INDEX)
+        {
+            inserted = false;
+            return values[slot];
+        }
+        if ((used + 1) * 2 > values.size())
+        {
+            grow();
+            slot = findSlot(key);
+        }
+        memcpy(&keys[slot * 3], key, sizeof(int) * 3);
+        values[slot] = newValue;
+        used++;
+        inserted = true;
+        return newValue;
+    }
+};
+
+static void generateMissingNormals(Mesh& mesh, const std::vector<bool>& needsNormal) {
+    for (size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        if (needsNormal[i])
+            memset(mesh.vertices[i].normal, 0, sizeof(mesh.vertices[i].normal));
+    }
+    // Unnormalized cross products weight each face by its area
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        Vertex* corners[3] = {
+            &mesh.vertices[mesh.indices[i]],
+            &mesh.vertices[mesh.indices[i + 1]],
+            &mesh.vertices[mesh.indices[i + 2]]
+        };
+        glm::vec3 a(corners[0]->position[0], corners[0]->position[1], corners[0]->position[2]);
+        glm::vec3 b(corners[1]->position[0], corners[1]->position[1], corners[1]->position[2]);
+        glm::vec3 c(corners[2]->position[0], corners[2]->position[1], corners[2]->position[2]);
+        glm::vec3 faceNormal = glm::cross(b - a, c - a);
+        for (int k = 0; k < 3; k++)
+        {
+            if (!needsNormal[mesh.indices[i + k]])
+                continue;
+            corners[k]->normal[0] += faceNormal.x;
+            corners[k]->normal[1] += faceNormal.y;
+            corners[k]->normal[2] += faceNormal.z;
+        }
+    }
+    for (size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        if (!needsNormal[i])
+            continue;
+        float* n = mesh.vertices[i].normal;
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length > 0.0f)
+        {
+            n[0] /= length;
+            n[1] /= length;
+            n[2] /= length;
+        }
+    }
+}
+
+bool parseObj(const char* data, size_t size, ObjModel& model, int threadCount) {
+    if (threadCount <= 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    int chunkCount = (int)std::min<size_t>(threadCount, std::max<size_t>(1, size / MIN_CHUNK_BYTES));
+
+    // Split at line boundaries
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* dataEnd = data + size;
+    const char* chunkBegin = data;
+    for (int i = 0; i < chunkCount; i++)
+    {
+        const char* chunkEnd = i + 1 == chunkCount ? dataEnd : data + size / chunkCount * (i + 1);
+        if (chunkEnd < chunkBegin)
+            chunkEnd = chunkBegin;
+        const char* newline = chunkEnd < dataEnd ? (const char*)memchr(chunkEnd, '\n', dataEnd - chunkEnd) : NULL;
+        chunkEnd = newline ? newline + 1 : dataEnd;
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = chunkEnd;
+        chunks[i].failed = false;
+        chunkBegin = chunkEnd;
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < chunkCount; i++)
+        threads.push_back(std::thread(parseChunk, &chunks[i]));
+    parseChunk(&chunks[0]);
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    // Concatenate the attribute streams and turn chunk relative indices global
+    std::vector<float> positions, texCoords, normals;
+    size_t cornerCount = 0;
+    for (int i = 0; i < chunkCount; i++)
+        cornerCount += chunks[i].corners.size();
+
+    model.mesh.vertices.clear();
+    model.mesh.indices.clear();
+    model.groups.clear();
+    model.materialLibraries.clear();
+    model.mesh.indices.reserve(cornerCount);
+
+    // Smooth meshes share each vertex between ~6 corners, the table grows if needed
+    CornerTable table(cornerCount / 4);
+    std::vector<bool> needsNormal;
+    std::vector<ObjEvent> events;
+    ObjGroup current = { "default", "", 0, 0 };
+
+    for (int i = 0; i < chunkCount; i++)
+    {
+        ObjChunk& chunk = chunks[i];
+        if (chunk.failed)
+        {
+            fputs("OBJ: malformed face\n", stderr);
+            return false;
+        }
+        int bases[3] = { (int)(positions.size() / 3), (int)(texCoords.size() / 2), (int)(normals.size() / 3) };
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+        normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+        int counts[3] = { (int)(positions.size() / 3), (int)(texCoords.size() / 2), (int)(normals.size() / 3) };
+        model.materialLibraries.insert(model.materialLibraries.end(),
+                                       chunk.materialLibraries.begin(), chunk.materialLibraries.end());
+
+        size_t nextEvent = 0;
+        for (size_t c = 0; c <= chunk.corners.size(); c++)
+        {
+            // Group and material changes close the current index range
+            for (; nextEvent < chunk.events.size() && chunk.events[nextEvent].cornerIndex == c; nextEvent++)
+            {
+                const ObjEvent& event = chunk.events[nextEvent];
+                if (current.indexCount > 0)
+                {
+                    model.groups.push_back(current);
+                    current.firstIndex += current.indexCount;
+                    current.indexCount = 0;
+                }
+                if (event.isMaterial)
+                    current.material = event.name;
+                else
+                    current.name = event.name;
+            }
+            if (c == chunk.corners.size())
+                break;
+
+            ObjCorner corner = chunk.corners[c];
+            for (int k = 0; k < 3; k++)
+            {
+                if (corner.relative & (1 << k))
+                    corner.index[k] += bases[k];
+                if (corner.index[k] != MISSING_INDEX && (corner.index[k] < 0 || corner.index[k] >= counts[k]))
+                {
+                    fprintf(stderr, "OBJ: face index out of range\n");
+                    return false;
+                }
+            }
+
+            bool inserted;
+            unsigned int vertexIndex = table.findOrInsert(corner.index, model.mesh.vertices.size(), inserted);
+            if (inserted)
+            {
+                Vertex vertex;
+                const float* position = &positions[corner.index[0] * 3];
+                memcpy(vertex.position, position, sizeof(vertex.position));
+                if (corner.index[1] != MISSING_INDEX)
+                {
+                    vertex.texCoord[0] = texCoords[corner.index[1] * 2];
+                    vertex.texCoord[1] = 1.0f - texCoords[corner.index[1] * 2 + 1];
+                }
+                else
+                {
+                    vertex.texCoord[0] = vertex.texCoord[1] = 0.0f;
+                }
+                if (corner.index[2] != MISSING_INDEX)
+                    memcpy(vertex.normal, &normals[corner.index[2] * 3], sizeof(vertex.normal));
+                vertex.color[0] = vertex.color[1] = vertex.color[2] = 1.0f;
+                model.mesh.vertices.push_back(vertex);
+                needsNormal.push_back(corner.index[2] == MISSING_INDEX);
+            }
+            model.mesh.indices.push_back(vertexIndex);
+            current.indexCount++;
+        }
+    }
+    if (current.indexCount > 0)
+        model.groups.push_back(current);
+
+    for (size_t i = 0; i < needsNormal.size(); i++)
+    {
+        if (needsNormal[i])
+        {
+            generateMissingNormals(model.mesh, needsNormal);
+            break;
+        }
+    }
+    computeMeshBounds(model.mesh);
+    return true;
+}
+
+bool parseObjFile(const char* fileName, ObjModel& model, int threadCount) {
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open %s\n", fileName);
+        return false;
+    }
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    size_t fileSize = fileInfo.st_size;
+    if (fileSize == 0)
+    {
+        close(fd);
+        return parseObj("", 0, model, 1);
+    }
+    void* mapping = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map %s\n", fileName);
+        return false;
+    }
+    bool ok = parseObj((const char*)mapping, fileSize, model, threadCount);
+    munmap(mapping, fileSize);
+    return ok;
+}
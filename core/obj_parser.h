@@ -0,0 +1,31 @@
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+#include <string>
+#include <vector>
+#include "mesh.h"
+
+// Range of mesh.indices that belongs to one g/o group and usemtl material
+struct ObjGroup {
+    std::string name;
+    std::string material;
+    unsigned int firstIndex;
+    unsigned int indexCount;
+};
+
+struct ObjModel {
+    Mesh mesh;
+    std::vector<ObjGroup> groups;
+    std::vector<std::string> materialLibraries; // mtllib file names, not loaded
+};
+
+// Wavefront OBJ parser for the subset we use: v, vt, vn, f (polygons are fan
+// triangulated, negative indices allowed), g/o, mtllib and usemtl.
+// Large files are split at line boundaries and parsed on threadCount threads
+// (0 picks the hardware thread count). Identical v/vt/vn corners are welded
+// into one vertex, texture coords are flipped to match OpenGL and missing
+// normals are generated by averaging the adjacent face normals.
+bool parseObj(const char* data, size_t size, ObjModel& model, int threadCount = 0);
+bool parseObjFile(const char* fileName, ObjModel& model, int threadCount = 0);
+
+#endif
@@ -0,0 +1,297 @@
+#include "occlusion_culling.h"
+#include <math.h>
+#include <algorithm>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Triangles are clipped to a band slightly wider than the screen so edge
+// functions stay small enough for float precision
+static const float GUARD_BAND = 1.25f;
+// Fewer triangles than this aren't worth splitting into jobs
+static const size_t MIN_PARALLEL_TRIANGLES = 256;
+static const int MIN_TILE_ROWS_PER_JOB = 2;
+
+void resizeOcclusionBuffer(OcclusionBuffer& buffer, int width, int height) {
+    if (width <= 0 || height <= 0)
+        return;
+    width = (width + OCCLUSION_TILE_SIZE - 1) / OCCLUSION_TILE_SIZE * OCCLUSION_TILE_SIZE;
+    height = (height + OCCLUSION_TILE_SIZE - 1) / OCCLUSION_TILE_SIZE * OCCLUSION_TILE_SIZE;
+    if (buffer.width == width && buffer.height == height)
+        return;
+
+    buffer.width = width;
+    buffer.height = height;
+    buffer.tilesX = width / OCCLUSION_TILE_SIZE;
+    buffer.tilesY = height / OCCLUSION_TILE_SIZE;
+    buffer.depth.assign(width * height, 1.0f);
+    buffer.tileMax.assign(buffer.tilesX * buffer.tilesY, 1.0f);
+}
+
+void clearOccluders(OcclusionBuffer& buffer) {
+    buffer.triangles.clear();
+}
+
+static float planeDistance(const glm::vec4& plane, const glm::vec4& v) {
+    return plane.x * v.x + plane.y * v.y + plane.z * v.z + plane.w * v.w;
+}
+
+// Sutherland-Hodgman against one clip space plane, keeps dot(plane, v) >= 0
+static int clipPolygon(const glm::vec4* in, int count, const glm::vec4& plane, glm::vec4* out) {
+    int outCount = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const glm::vec4& a = in[i];
+        const glm::vec4& b = in[(i + 1) % count];
+        float da = planeDistance(plane, a), db = planeDistance(plane, b);
+        if (da >= 0.0f)
+            out[outCount++] = a;
+        if ((da >= 0.0f) != (db >= 0.0f))
+            out[outCount++] = a + (b - a) * (da / (da - db));
+    }
+    return outCount;
+}
+
+static void setupTriangle(OcclusionBuffer& buffer, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2) {
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    if (area == 0.0f)
+        return;
+
+    OccluderTriangle triangle;
+    triangle.minX = std::max(0, (int)floorf(std::min(v0.x, std::min(v1.x, v2.x))));
+    triangle.minY = std::max(0, (int)floorf(std::min(v0.y, std::min(v1.y, v2.y))));
+    triangle.maxX = std::min(buffer.width - 1, (int)ceilf(std::max(v0.x, std::max(v1.x, v2.x))));
+    triangle.maxY = std::min(buffer.height - 1, (int)ceilf(std::max(v0.y, std::max(v1.y, v2.y))));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        return;
+
+    // Edge i runs from vertex i to i + 1 and is positive inside. The pixel is
+    // covered completely when the center is half a pixel's reach inside.
+    const glm::vec3* v[3] = { &v0, &v1, &v2 };
+    float orientation = area > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < 3; i++)
+    {
+        const glm::vec3& from = *v[i];
+        const glm::vec3& to = *v[(i + 1) % 3];
+        float a = -(to.y - from.y) * orientation;
+        float b = (to.x - from.x) * orientation;
+        float c = -(a * from.x + b * from.y);
+        triangle.edgeA[i] = a;
+        triangle.edgeB[i] = b;
+        triangle.edgeC[i] = c + 0.5f * (a + b) - 0.5f * (fabsf(a) + fabsf(b));
+    }
+
+    // Depth is planar in screen space, its maximum over a pixel is at a corner
+    float depthA = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+    float depthB = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+    float depthC = v0.z - depthA * v0.x - depthB * v0.y;
+    triangle.depthA = depthA;
+    triangle.depthB = depthB;
+    triangle.depthC = depthC + 0.5f * (depthA + depthB) + 0.5f * (fabsf(depthA) + fabsf(depthB));
+    triangle.maxDepth = std::max(v0.z, std::max(v1.z, v2.z));
+    buffer.triangles.push_back(triangle);
+}
+
+void addOccluder(OcclusionBuffer& buffer, const Mesh& mesh, const glm::mat4& modelViewProjection) {
+    static const glm::vec4 clipPlanes[5] = {
+        glm::vec4(0.0f, 0.0f, 1.0f, 1.0f),          // near
+        glm::vec4(1.0f, 0.0f, 0.0f, GUARD_BAND),    // left
+        glm::vec4(-1.0f, 0.0f, 0.0f, GUARD_BAND),   // right
+        glm::vec4(0.0f, 1.0f, 0.0f, GUARD_BAND),    // bottom
+        glm::vec4(0.0f, -1.0f, 0.0f, GUARD_BAND),   // top
+    };
+
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        glm::vec4 polygon[8], clipped[8];
+        int count = 3;
+        unsigned int outside = 0;
+        for (int corner = 0; corner < 3; corner++)
+        {
+            const float* position = mesh.vertices[mesh.indices[i + corner]].position;
+            polygon[corner] = modelViewProjection * glm::vec4(position[0], position[1], position[2], 1.0f);
+            for (int p = 0; p < 5; p++)
+            {
+                if (planeDistance(clipPlanes[p], polygon[corner]) < 0.0f)
+                    outside |= 1u << p;
+            }
+        }
+
+        // Most triangles are inside every plane and skip clipping
+        for (int p = 0; p < 5 && count >= 3; p++)
+        {
+            if (!(outside & (1u << p)))
+                continue;
+            count = clipPolygon(polygon, count, clipPlanes[p], clipped);
+            std::copy(clipped, clipped + count, polygon);
+        }
+
+        glm::vec3 screen[8];
+        for (int corner = 0; corner < count; corner++)
+        {
+            float inverseW = 1.0f / polygon[corner].w;
+            screen[corner] = glm::vec3((polygon[corner].x * inverseW * 0.5f + 0.5f) * buffer.width,
+                                       (polygon[corner].y * inverseW * 0.5f + 0.5f) * buffer.height,
+                                       polygon[corner].z * inverseW * 0.5f + 0.5f);
+        }
+        for (int corner = 2; corner < count; corner++)
+            setupTriangle(buffer, screen[0], screen[corner - 1], screen[corner]);
+    }
+}
+
+// Rasterizes every triangle into rows [rowBegin, rowEnd), 4 pixels at a time
+static void rasterizeRows(OcclusionBuffer* buffer, int rowBegin, int rowEnd) {
+    int width = buffer->width;
+    std::fill(buffer->depth.begin() + rowBegin * width, buffer->depth.begin() + rowEnd * width, 1.0f);
+
+    for (size_t t = 0; t < buffer->triangles.size(); t++)
+    {
+        const OccluderTriangle& triangle = buffer->triangles[t];
+        int yBegin = std::max(triangle.minY, rowBegin);
+        int yEnd = std::min(triangle.maxY + 1, rowEnd);
+        // Rows are a multiple of 4 wide, so aligned groups never run past the end
+        int xBegin = triangle.minX & ~3;
+
+        for (int y = yBegin; y < yEnd; y++)
+        {
+            float* row = &buffer->depth[y * width];
+#if defined(__SSE__)
+            __m128 a0 = _mm_set1_ps(triangle.edgeA[0]), a1 = _mm_set1_ps(triangle.edgeA[1]), a2 = _mm_set1_ps(triangle.edgeA[2]);
+            __m128 rowEdge0 = _mm_set1_ps(triangle.edgeB[0] * y + triangle.edgeC[0]);
+            __m128 rowEdge1 = _mm_set1_ps(triangle.edgeB[1] * y + triangle.edgeC[1]);
+            __m128 rowEdge2 = _mm_set1_ps(triangle.edgeB[2] * y + triangle.edgeC[2]);
+            __m128 depthA = _mm_set1_ps(triangle.depthA);
+            __m128 rowDepth = _mm_set1_ps(triangle.depthB * y + triangle.depthC);
+            __m128 maxDepth = _mm_set1_ps(triangle.maxDepth);
+            __m128 zero = _mm_setzero_ps();
+            __m128 x = _mm_setr_ps(xBegin, xBegin + 1, xBegin + 2, xBegin + 3);
+            __m128 four = _mm_set1_ps(4.0f);
+            for (int px = xBegin; px <= triangle.maxX; px += 4, x = _mm_add_ps(x, four))
+            {
+                __m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, x), rowEdge0), zero),
+                                _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, x), rowEdge1), zero),
+                                           _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, x), rowEdge2), zero)));
+                if (!_mm_movemask_ps(inside))
+                    continue;
+                __m128 depth = _mm_min_ps(_mm_add_ps(_mm_mul_ps(depthA, x), rowDepth), maxDepth);
+                __m128 current = _mm_loadu_ps(row + px);
+                __m128 nearest = _mm_min_ps(current, depth);
+                _mm_storeu_ps(row + px, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+            }
+#elif defined(__ARM_NEON)
+            float32x4_t a0 = vdupq_n_f32(triangle.edgeA[0]), a1 = vdupq_n_f32(triangle.edgeA[1]), a2 = vdupq_n_f32(triangle.edgeA[2]);
+            float32x4_t rowEdge0 = vdupq_n_f32(triangle.edgeB[0] * y + triangle.edgeC[0]);
+            float32x4_t rowEdge1 = vdupq_n_f32(triangle.edgeB[1] * y + triangle.edgeC[1]);
+            float32x4_t rowEdge2 = vdupq_n_f32(triangle.edgeB[2] * y + triangle.edgeC[2]);
+            float32x4_t depthA = vdupq_n_f32(triangle.depthA);
+            float32x4_t rowDepth = vdupq_n_f32(triangle.depthB * y + triangle.depthC);
+            float32x4_t maxDepth = vdupq_n_f32(triangle.maxDepth);
+            float32x4_t zero = vdupq_n_f32(0.0f);
+            float offsets[4] = { (float)xBegin, xBegin + 1.0f, xBegin + 2.0f, xBegin + 3.0f };
+            float32x4_t x = vld1q_f32(offsets);
+            float32x4_t four = vdupq_n_f32(4.0f);
+            for (int px = xBegin; px <= triangle.maxX; px += 4, x = vaddq_f32(x, four))
+            {
+                uint32x4_t inside = vandq_u32(vcgeq_f32(vmlaq_f32(rowEdge0, a0, x), zero),
+                                    vandq_u32(vcgeq_f32(vmlaq_f32(rowEdge1, a1, x), zero),
+                                              vcgeq_f32(vmlaq_f32(rowEdge2, a2, x), zero)));
+                float32x4_t depth = vminq_f32(vmlaq_f32(rowDepth, depthA, x), maxDepth);
+                float32x4_t current = vld1q_f32(row + px);
+                vst1q_f32(row + px, vbslq_f32(inside, vminq_f32(current, depth), current));
+            }
+#else
+            for (int px = triangle.minX; px <= triangle.maxX; px++)
+            {
+                bool inside = true;
+                for (int e = 0; e < 3; e++)
+                    inside = inside && triangle.edgeA[e] * px + triangle.edgeB[e] * y + triangle.edgeC[e] >= 0.0f;
+                if (!inside)
+                    continue;
+                float depth = std::min(triangle.depthA * px + triangle.depthB * y + triangle.depthC, triangle.maxDepth);
+                row[px] = std::min(row[px], depth);
+            }
+#endif
+        }
+    }
+
+    // Tile maxima of the rows this band owns
+    for (int tileY = rowBegin / OCCLUSION_TILE_SIZE; tileY < rowEnd / OCCLUSION_TILE_SIZE; tileY++)
+    {
+        for (int tileX = 0; tileX < buffer->tilesX; tileX++)
+        {
+            float farthest = 0.0f;
+            for (int y = 0; y < OCCLUSION_TILE_SIZE; y++)
+            {
+                const float* row = &buffer->depth[(tileY * OCCLUSION_TILE_SIZE + y) * width + tileX * OCCLUSION_TILE_SIZE];
+                for (int x = 0; x < OCCLUSION_TILE_SIZE; x++)
+                    farthest = std::max(farthest, row[x]);
+            }
+            buffer->tileMax[tileY * buffer->tilesX + tileX] = farthest;
+        }
+    }
+}
+
+// Job over rows of tiles, each job owns their pixels and tile maxima
+static void rasterizeTileRowsJob(void* data, int begin, int end) {
+    rasterizeRows((OcclusionBuffer*)data, begin * OCCLUSION_TILE_SIZE, end * OCCLUSION_TILE_SIZE);
+}
+
+void rasterizeOccluders(OcclusionBuffer& buffer, JobSystem& jobs) {
+    if (buffer.triangles.size() < MIN_PARALLEL_TRIANGLES)
+    {
+        rasterizeRows(&buffer, 0, buffer.height);
+        return;
+    }
+    JobCounter rasterized;
+    parallelFor(jobs, rasterizeTileRowsJob, &buffer, buffer.tilesY, MIN_TILE_ROWS_PER_JOB, &rasterized);
+    waitForCounter(jobs, rasterized);
+}
+
+bool testOcclusion(const OcclusionBuffer& buffer, const glm::vec3& center, const glm::vec3& extent,
+                   const glm::mat4& viewProjection) {
+    if (buffer.tileMax.empty())
+        return true;
+
+    glm::vec4 clipCenter = viewProjection * glm::vec4(center, 1.0f);
+    glm::vec4 axes[3] = { viewProjection[0] * extent.x, viewProjection[1] * extent.y, viewProjection[2] * extent.z };
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1e30f;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec4 clip = clipCenter;
+        clip += corner & 1 ? axes[0] : -axes[0];
+        clip += corner & 2 ? axes[1] : -axes[1];
+        clip += corner & 4 ? axes[2] : -axes[2];
+        // Boxes crossing the near plane are too close to be hidden
+        if (clip.z < -clip.w || clip.w <= 0.0f)
+            return true;
+        float inverseW = 1.0f / clip.w;
+        float x = (clip.x * inverseW * 0.5f + 0.5f) * buffer.width;
+        float y = (clip.y * inverseW * 0.5f + 0.5f) * buffer.height;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, clip.z * inverseW * 0.5f + 0.5f);
+    }
+
+    // Off screen, leave it to frustum culling
+    if (maxX < 0.0f || maxY < 0.0f || minX >= buffer.width || minY >= buffer.height)
+        return true;
+    int tileMinX = std::max(0, (int)floorf(minX) / OCCLUSION_TILE_SIZE);
+    int tileMinY = std::max(0, (int)floorf(minY) / OCCLUSION_TILE_SIZE);
+    int tileMaxX = std::min(buffer.tilesX - 1, (int)floorf(maxX) / OCCLUSION_TILE_SIZE);
+    int tileMaxY = std::min(buffer.tilesY - 1, (int)floorf(maxY) / OCCLUSION_TILE_SIZE);
+
+    for (int tileY = tileMinY; tileY <= tileMaxY; tileY++)
+    {
+        for (int tileX = tileMinX; tileX <= tileMaxX; tileX++)
+        {
+            if (nearest <= buffer.tileMax[tileY * buffer.tilesX + tileX])
+                return true;
+        }
+    }
+    return false;
+}
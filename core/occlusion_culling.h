@@ -0,0 +1,48 @@
+#ifndef OCCLUSION_CULLING_H
+#define OCCLUSION_CULLING_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "mesh.h"
+#include "job_system.h"
+
+static const int OCCLUSION_TILE_SIZE = 8;
+
+// Triangle set up for the rasterizer, edges and depth are evaluated at
+// integer pixel coordinates and already include the half pixel offsets
+struct OccluderTriangle {
+    float edgeA[3], edgeB[3], edgeC[3]; // pixel fully inside when every a x + b y + c >= 0
+    float depthA, depthB, depthC;       // farthest depth inside the pixel
+    float maxDepth;
+    int minX, minY, maxX, maxY;         // inclusive pixel bounds
+};
+
+// Low resolution depth buffer of a few big occluders, rasterized on the CPU
+// so objects behind them are dropped before submission without reading
+// anything back from the GPU. Conservative: occluders only write pixels they
+// cover completely, with the farthest depth inside the pixel, and objects
+// test the nearest corner of their box against the farthest depth of every
+// 8x8 tile they overlap.
+struct OcclusionBuffer {
+    int width = 0, height = 0;      // multiples of OCCLUSION_TILE_SIZE
+    int tilesX = 0, tilesY = 0;
+    std::vector<float> depth;       // window depth, 1 is the far plane, row 0 at the bottom
+    std::vector<float> tileMax;     // farthest depth of each tile
+    std::vector<OccluderTriangle> triangles;
+};
+
+// Rounds the size up to whole tiles, keeps the buffer when the size is unchanged
+// or empty.
+void resizeOcclusionBuffer(OcclusionBuffer& buffer, int width, int height);
+// Drops the previous frame's occluders
+void clearOccluders(OcclusionBuffer& buffer);
+// Clips the mesh's triangles to the near plane and a guard band and queues them
+void addOccluder(OcclusionBuffer& buffer, const Mesh& mesh, const glm::mat4& modelViewProjection);
+// Clears the depth buffer and rasterizes every queued occluder, then builds
+// the tile maxima. Rows of tiles are split across jobs, safe inside a job.
+void rasterizeOccluders(OcclusionBuffer& buffer, JobSystem& jobs);
+// False when the world space box is hidden behind the occluders
+bool testOcclusion(const OcclusionBuffer& buffer, const glm::vec3& center, const glm::vec3& extent,
+                   const glm::mat4& viewProjection);
+
+#endif
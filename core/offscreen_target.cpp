@@ -0,0 +1,65 @@
+#include "offscreen_target.h"
+#include "opengl.h"
+#include <stdio.h>
+#include <vector>
+
+bool createOffscreenTarget(OffscreenTarget& target, int width, int height) {
+    target.width = width;
+    target.height = height;
+
+    glGenRenderbuffers(1, &target.colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &target.depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glGenFramebuffers(1, &target.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depthBuffer);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        fprintf(stderr, "Offscreen framebuffer is incomplete (0x%x)\n", status);
+        destroyOffscreenTarget(target);
+        return false;
+    }
+    return true;
+}
+
+void destroyOffscreenTarget(OffscreenTarget& target) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &target.framebuffer);
+    glDeleteRenderbuffers(1, &target.colorBuffer);
+    glDeleteRenderbuffers(1, &target.depthBuffer);
+    target = OffscreenTarget();
+}
+
+bool writeOffscreenTargetPPM(const OffscreenTarget& target, const char* fileName) {
+    int rowSize = target.width * 3;
+    std::vector<unsigned char> pixels(rowSize * target.height);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target.framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, target.width, target.height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+    FILE* file = fopen(fileName, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "Failed to open %s for writing\n", fileName);
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", target.width, target.height);
+    // OpenGL rows start at the bottom, image rows start at the top
+    for (int y = target.height - 1; y >= 0; y--)
+        fwrite(&pixels[y * rowSize], 1, rowSize, file);
+    // A full disk may only show up when the buffered rows are flushed by fclose
+    bool ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+        fprintf(stderr, "Failed to write %s\n", fileName);
+    return ok;
+}
@@ -0,0 +1,20 @@
+#ifndef OFFSCREEN_TARGET_H
+#define OFFSCREEN_TARGET_H
+
+// Framebuffer object with a color and depth renderbuffer, used as the render
+// target when there is no window to draw into.
+struct OffscreenTarget {
+    unsigned int framebuffer = 0;
+    unsigned int colorBuffer = 0;
+    unsigned int depthBuffer = 0;
+    int width = 0;
+    int height = 0;
+};
+
+bool createOffscreenTarget(OffscreenTarget& target, int width, int height);
+void destroyOffscreenTarget(OffscreenTarget& target);
+
+// Reads the color buffer back and writes it as a binary PPM (P6) image.
+bool writeOffscreenTargetPPM(const OffscreenTarget& target, const char* fileName);
+
+#endif
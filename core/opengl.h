@@ -0,0 +1,15 @@
+#ifndef OPENGL_H
+#define OPENGL_H
+
+// Single place that pulls in the OpenGL 4.1 core profile declarations.
+// macOS ships them as a framework, everywhere else we use the Khronos header
+// (Mesa / llvmpipe exports the entry points directly).
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#include <OpenGL/gl3.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glcorearb.h>
+#endif
+
+#endif
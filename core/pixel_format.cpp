@@ -0,0 +1,199 @@
+#include "pixel_format.h"
+#include "vertex_format.h"
+#include "libraries/stb_image.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+static const PixelFormatInfo PIXEL_FORMATS[PIXEL_FORMAT_COUNT] = {
+    { "r8", GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, 1 },
+    { "rg8", GL_RG8, GL_RG, GL_UNSIGNED_BYTE, 2, 2 },
+    { "rgba8", GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, 4 },
+    { "srgb8_alpha8", GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, 4 },
+    { "r16", GL_R16, GL_RED, GL_UNSIGNED_SHORT, 1, 2 },
+    { "rg16", GL_RG16, GL_RG, GL_UNSIGNED_SHORT, 2, 4 },
+    { "rgba16", GL_RGBA16, GL_RGBA, GL_UNSIGNED_SHORT, 4, 8 },
+    { "r16f", GL_R16F, GL_RED, GL_HALF_FLOAT, 1, 2 },
+    { "rg16f", GL_RG16F, GL_RG, GL_HALF_FLOAT, 2, 4 },
+    { "rgba16f", GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 4, 8 },
+};
+
+const PixelFormatInfo& pixelFormatInfo(PixelFormat format) {
+    return PIXEL_FORMATS[format];
+}
+
+PixelFormat choosePixelFormat(int channels, int bitsPerChannel, bool hdr, TextureUsage usage) {
+    // R, RG and RGBA are consecutive in every group
+    int index = channels == 1 ? 0 : channels == 2 ? 1 : 2;
+    if (hdr)
+        return (PixelFormat)(PIXEL_FORMAT_R16F + index);
+    if (usage == TEXTURE_USAGE_SRGB)
+        return PIXEL_FORMAT_SRGB8_ALPHA8;
+    if (bitsPerChannel == 16)
+        return (PixelFormat)(PIXEL_FORMAT_R16 + index);
+    return (PixelFormat)(PIXEL_FORMAT_R8 + index);
+}
+
+// Keeps grey (the red channel of stb_image's expansion) and alpha
+static void packGreyLevel(TextureMip& mip, int channels) {
+    size_t pixelCount = (size_t)mip.width * mip.height;
+    unsigned char* pixels = mip.pixels.data();
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        pixels[i * channels] = pixels[i * 4];
+        if (channels == 2)
+            pixels[i * 2 + 1] = pixels[i * 4 + 3];
+    }
+    mip.pixels.resize(pixelCount * channels);
+}
+
+static float loadChannel(const unsigned char* texel, int channel, GLenum type) {
+    unsigned short value;
+    memcpy(&value, texel + channel * 2, 2);
+    return type == GL_HALF_FLOAT ? halfToFloat(value) : value;
+}
+
+static void storeChannel(unsigned char* texel, int channel, GLenum type, float value) {
+    unsigned short stored = type == GL_HALF_FLOAT ? floatToHalf(value) : (unsigned short)(value + 0.5f);
+    memcpy(texel + channel * 2, &stored, 2);
+}
+
+// 2x2 box filter down to 1x1 for 16 bit channels, odd edges repeat their
+// last texel. These files are rare enough to stay scalar.
+static void buildWideMipChain(std::vector<TextureMip>& mips, const PixelFormatInfo& info) {
+    while (mips.back().width > 1 || mips.back().height > 1)
+    {
+        mips.push_back(TextureMip());
+        const TextureMip& source = mips[mips.size() - 2];
+        TextureMip& target = mips.back();
+        target.width = std::max(1, source.width / 2);
+        target.height = std::max(1, source.height / 2);
+        target.pixels.resize((size_t)target.width * target.height * info.pixelBytes);
+        for (int y = 0; y < target.height; y++)
+        {
+            const unsigned char* row0 = &source.pixels[(size_t)(y * 2) * source.width * info.pixelBytes];
+            const unsigned char* row1 = &source.pixels[(size_t)std::min(y * 2 + 1, source.height - 1) * source.width * info.pixelBytes];
+            for (int x = 0; x < target.width; x++)
+            {
+                size_t x0 = (size_t)(x * 2) * info.pixelBytes;
+                size_t x1 = (size_t)std::min(x * 2 + 1, source.width - 1) * info.pixelBytes;
+                unsigned char* texel = &target.pixels[((size_t)y * target.width + x) * info.pixelBytes];
+                for (int c = 0; c < info.channels; c++)
+                {
+                    float sum = loadChannel(row0 + x0, c, info.type) + loadChannel(row0 + x1, c, info.type) +
+                                loadChannel(row1 + x0, c, info.type) + loadChannel(row1 + x1, c, info.type);
+                    storeChannel(texel, c, info.type, sum * 0.25f);
+                }
+            }
+        }
+    }
+}
+
+bool loadPixelLevels(const char* fileName, TextureUsage usage, PixelFormat& format, std::vector<TextureMip>& mips) {
+    int width, height, channels;
+    if (!stbi_info(fileName, &width, &height, &channels))
+    {
+        fprintf(stderr, "Failed to load texture %s\n", fileName);
+        return false;
+    }
+    format = choosePixelFormat(channels, stbi_is_16_bit(fileName) ? 16 : 8, stbi_is_hdr(fileName) != 0, usage);
+    const PixelFormatInfo& info = pixelFormatInfo(format);
+    mips.resize(1);
+    TextureMip& base = mips[0];
+    size_t pixelCount = (size_t)width * height;
+    if (info.type == GL_UNSIGNED_BYTE)
+    {
+        // Always expanded to RGBA8 for buildMipChain, packed afterwards
+        unsigned char* pixels = stbi_load(fileName, &width, &height, &channels, 4);
+        if (!pixels)
+        {
+            fprintf(stderr, "Failed to load texture %s\n", fileName);
+            return false;
+        }
+        base.width = width;
+        base.height = height;
+        base.pixels.assign(pixels, pixels + pixelCount * 4);
+        stbi_image_free(pixels);
+        MipChainSettings settings;
+        settings.srgb = usage != TEXTURE_USAGE_DATA;
+        buildMipChain(mips, settings);
+        if (info.channels < 4)
+            for (size_t i = 0; i < mips.size(); i++)
+                packGreyLevel(mips[i], info.channels);
+        return true;
+    }
+
+    base.width = width;
+    base.height = height;
+    base.pixels.resize(pixelCount * info.pixelBytes);
+    if (info.type == GL_UNSIGNED_SHORT)
+    {
+        unsigned short* pixels = stbi_load_16(fileName, &width, &height, &channels, info.channels);
+        if (!pixels)
+        {
+            fprintf(stderr, "Failed to load texture %s\n", fileName);
+            return false;
+        }
+        memcpy(base.pixels.data(), pixels, base.pixels.size());
+        stbi_image_free(pixels);
+    }
+    else
+    {
+        float* pixels = stbi_loadf(fileName, &width, &height, &channels, info.channels);
+        if (!pixels)
+        {
+            fprintf(stderr, "Failed to load texture %s\n", fileName);
+            return false;
+        }
+        unsigned short* halves = (unsigned short*)base.pixels.data();
+        for (size_t i = 0; i < pixelCount * info.channels; i++)
+            halves[i] = floatToHalf(pixels[i]);
+        stbi_image_free(pixels);
+    }
+    buildWideMipChain(mips, info);
+    return true;
+}
+
+void setPixelSwizzle(GLenum target, PixelFormat format) {
+    int channels = pixelFormatInfo(format).channels;
+    if (channels == 4)
+        return;
+    GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, channels == 2 ? GL_GREEN : GL_ONE };
+    glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+}
+
+int unpackAlignment(size_t rowBytes) {
+    int alignment = 8;
+    while (rowBytes % alignment)
+        alignment /= 2;
+    return alignment;
+}
+
+bool hasGLExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+            return true;
+    return false;
+}
+
+bool textureStorageSupported() {
+#ifdef GL_VERSION_4_2
+    int major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    return major > 4 || (major == 4 && minor >= 2) || hasGLExtension("GL_ARB_texture_storage");
+#else
+    return false;
+#endif
+}
+
+void allocateTextureStorage(GLenum target, int levelCount, GLenum internalFormat, int width, int height, int layers) {
+#ifdef GL_VERSION_4_2
+    if (layers > 0)
+        glTexStorage3D(target, levelCount, internalFormat, width, height, layers);
+    else
+        glTexStorage2D(target, levelCount, internalFormat, width, height);
+#endif
+}
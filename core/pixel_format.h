@@ -0,0 +1,71 @@
+#ifndef PIXEL_FORMAT_H
+#define PIXEL_FORMAT_H
+
+#include <vector>
+#include "opengl.h"
+#include "mip_chain.h"
+
+// What a texture's values mean, decides the mip filtering and whether the
+// GPU decodes sRGB when sampling
+enum TextureUsage {
+    TEXTURE_USAGE_COLOR,    // sRGB color, mips filtered in linear light, sampled as stored (the shaders don't linearize)
+    TEXTURE_USAGE_SRGB,     // sRGB color sampled through SRGB8_ALPHA8, the GPU returns linear values
+    TEXTURE_USAGE_DATA      // normal maps, masks, heights: filtered and sampled as stored
+};
+
+// Uncompressed layouts of decoded texture levels, rows tightly packed.
+// One and two channel files are grey and grey + alpha: their formats are
+// swizzled so shaders still read grey in rgb (see setPixelSwizzle).
+enum PixelFormat {
+    PIXEL_FORMAT_R8,
+    PIXEL_FORMAT_RG8,
+    PIXEL_FORMAT_RGBA8,
+    PIXEL_FORMAT_SRGB8_ALPHA8,
+    PIXEL_FORMAT_R16,       // 16 bit PNGs
+    PIXEL_FORMAT_RG16,
+    PIXEL_FORMAT_RGBA16,
+    PIXEL_FORMAT_R16F,      // HDR files, stored as half floats
+    PIXEL_FORMAT_RG16F,
+    PIXEL_FORMAT_RGBA16F,
+    PIXEL_FORMAT_COUNT
+};
+
+struct PixelFormatInfo {
+    const char* name;
+    GLenum internalFormat;
+    GLenum format;          // glTexSubImage2D format and type of the rows
+    GLenum type;
+    int channels;
+    int pixelBytes;
+};
+
+const PixelFormatInfo& pixelFormatInfo(PixelFormat format);
+
+// Smallest format holding a file's channels at its bit depth (8, 16, or
+// hdr for float files). RGB gets RGBA, GPUs pad three channel texels to
+// four anyway. sRGB sampling has only an RGBA8 format in core GL, so it
+// widens grey and drops 16 bit files to 8.
+PixelFormat choosePixelFormat(int channels, int bitsPerChannel, bool hdr, TextureUsage usage);
+
+// Loads fileName into mips[0] in the format choosePixelFormat picks for it
+// and appends its mip chain. 8 bit levels are filtered by buildMipChain
+// (in linear light unless usage is data) and packed to one or two channels
+// afterwards, 16 bit and half float levels with a 2x2 box filter as stored.
+bool loadPixelLevels(const char* fileName, TextureUsage usage, PixelFormat& format, std::vector<TextureMip>& mips);
+
+// Grey formats read their single channel into rgb, and a second one as alpha
+void setPixelSwizzle(GLenum target, PixelFormat format);
+
+// Row alignment for GL_UNPACK_ALIGNMENT: the largest of 8, 4, 2, 1 dividing rowBytes
+int unpackAlignment(size_t rowBytes);
+
+bool hasGLExtension(const char* name);
+// glTexStorage2D/3D (core since 4.2, or ARB_texture_storage) in the headers and the context
+bool textureStorageSupported();
+
+// Allocates every level at once, immutable: the driver never has to
+// reallocate when levels arrive or check them for completeness. A 2D array
+// when layers > 0. Only valid when textureStorageSupported().
+void allocateTextureStorage(GLenum target, int levelCount, GLenum internalFormat, int width, int height, int layers = 0);
+
+#endif
@@ -0,0 +1,73 @@
+#include "render_queue.h"
+#include <algorithm>
+
+static const int DEPTH_BITS = 24;
+static const uint64_t ID_MASK = 0xFFF;
+
+uint64_t makeSortKey(RenderPass pass, unsigned int program, unsigned int material,
+                     unsigned int texture, float depth) {
+    depth = std::min(std::max(depth, 0.0f), 1.0f);
+    uint64_t depthBits = (uint64_t)(depth * ((1 << DEPTH_BITS) - 1));
+    // Transparent surfaces blend correctly only back to front
+    if (pass == RENDER_PASS_TRANSPARENT)
+        depthBits = ((1 << DEPTH_BITS) - 1) - depthBits;
+
+    return ((uint64_t)pass << 60) |
+           ((program & ID_MASK) << 48) |
+           ((material & ID_MASK) << 36) |
+           ((texture & ID_MASK) << 24) |
+           depthBits;
+}
+
+void clearRenderQueue(RenderQueue& queue) {
+    queue.commands.clear();
+    queue.packets.clear();
+}
+
+void submitDraw(RenderQueue& queue, uint64_t key, const DrawCommand& command) {
+    DrawPacket packet;
+    packet.key = key;
+    packet.command = (unsigned int)queue.commands.size();
+    queue.commands.push_back(command);
+    queue.packets.push_back(packet);
+}
+
+void sortRenderQueue(RenderQueue& queue) {
+    std::vector<DrawPacket>& packets = queue.packets;
+    size_t count = packets.size();
+    if (count < 2)
+        return;
+
+    // One pass over the keys builds all eight histograms
+    unsigned int histograms[8][256] = {};
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t key = packets[i].key;
+        for (int byte = 0; byte < 8; byte++)
+            histograms[byte][(key >> (byte * 8)) & 0xFF]++;
+    }
+
+    queue.scratch.resize(count);
+    DrawPacket* source = &packets[0];
+    DrawPacket* destination = &queue.scratch[0];
+    for (int byte = 0; byte < 8; byte++)
+    {
+        unsigned int* histogram = histograms[byte];
+        if (histogram[(packets[0].key >> (byte * 8)) & 0xFF] == count)
+            continue;
+
+        unsigned int offset = 0;
+        for (int i = 0; i < 256; i++)
+        {
+            unsigned int bucket = histogram[i];
+            histogram[i] = offset;
+            offset += bucket;
+        }
+        for (size_t i = 0; i < count; i++)
+            destination[histogram[(source[i].key >> (byte * 8)) & 0xFF]++] = source[i];
+        std::swap(source, destination);
+    }
+
+    if (source != &packets[0])
+        packets.swap(queue.scratch);
+}
@@ -0,0 +1,69 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <vector>
+#include <stdint.h>
+#include <glm/glm.hpp>
+#include "vertex_format.h"
+#include "transform_batch.h"
+
+struct MeshBatch;
+
+// Passes execute in this order, inside a pass draws are grouped by
+// program, material and texture, then sorted front to back
+enum RenderPass {
+    RENDER_PASS_OPAQUE = 0,
+    RENDER_PASS_LINES = 1,
+    RENDER_PASS_TRANSPARENT = 2 // back to front
+};
+
+// Everything needed to issue one draw call
+struct DrawCommand {
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int texture;       // GL_TEXTURE_2D on unit 0, 0 for untextured
+    bool textureArray;          // texture is a GL_TEXTURE_2D_ARRAY on TEXTURE_ARRAY_UNIT instead,
+    int textureLayer;           // sampled at this layer (see texture_array.h)
+    bool useLighting;
+    unsigned int primitive;     // GL_TRIANGLES, GL_LINES...
+    unsigned int indexType;     // 0 draws non-indexed with glDrawArrays
+    unsigned int first;         // first index or vertex
+    unsigned int count;
+    unsigned int instanceCount; // 0 for a single draw using model/transform,
+                                // otherwise the VAO's instance buffer provides the models
+    MeshBatch* batch;           // set for meshes packed into a multi-draw batch
+    unsigned int batchMesh;     // mesh index inside the batch
+    // Vertex decoding, see GpuMesh
+    VertexFormat vertexFormat;
+    glm::vec3 positionOffset;
+    glm::vec3 positionScale;
+    glm::mat4 model;
+    ObjectTransform transform;
+};
+
+struct DrawPacket {
+    uint64_t key;
+    unsigned int command; // index into RenderQueue::commands
+};
+
+// Draws submitted during the frame, sorted by key before execution
+struct RenderQueue {
+    std::vector<DrawCommand> commands;
+    std::vector<DrawPacket> packets;
+    std::vector<DrawPacket> scratch; // radix sort ping-pong buffer
+};
+
+// Key layout, most significant first:
+// pass 4 | program 12 | material 12 | texture 12 | depth 24.
+// Ids are truncated to 12 bits, GL names of a small scene fit. depth is
+// the view distance divided by the far plane, clamped to 0..1.
+uint64_t makeSortKey(RenderPass pass, unsigned int program, unsigned int material,
+                     unsigned int texture, float depth);
+
+void clearRenderQueue(RenderQueue& queue);
+void submitDraw(RenderQueue& queue, uint64_t key, const DrawCommand& command);
+// Stable LSD radix sort on the keys, 8 bits per pass, passes where every
+// key has the same byte are skipped
+void sortRenderQueue(RenderQueue& queue);
+
+#endif
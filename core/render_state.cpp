@@ -0,0 +1,116 @@
+#include "render_state.h"
+#include <stddef.h>
+
+static const unsigned int UNKNOWN = ~0u;
+
+static int capabilityIndex(GLenum capability) {
+    switch (capability)
+    {
+    case GL_DEPTH_TEST: return 0;
+    case GL_CULL_FACE: return 1;
+    case GL_BLEND: return 2;
+    case GL_SCISSOR_TEST: return 3;
+    default: return -1;
+    }
+}
+
+// Counts the call and returns true when it has to be issued
+static bool update(RenderState& state, unsigned int& current, unsigned int value) {
+    if (current == value)
+    {
+        state.counters.skipped++;
+        return false;
+    }
+    current = value;
+    state.counters.issued++;
+    return true;
+}
+
+void invalidateRenderState(RenderState& state) {
+    state.program = UNKNOWN;
+    state.vertexArray = UNKNOWN;
+    state.activeTexture = UNKNOWN;
+    for (int i = 0; i < RenderState::TEXTURE_UNITS; i++)
+    {
+        state.textures2D[i] = UNKNOWN;
+        state.textureArrays[i] = UNKNOWN;
+        state.textureBuffers[i] = UNKNOWN;
+    }
+    for (int i = 0; i < 4; i++)
+        state.viewport[i] = -1;
+    for (int i = 0; i < RenderState::CAPABILITIES; i++)
+        state.capabilities[i] = -1;
+}
+
+void resetRenderStateCounters(RenderState& state) {
+    state.counters.issued = 0;
+    state.counters.skipped = 0;
+}
+
+void useProgram(RenderState& state, unsigned int program) {
+    if (update(state, state.program, program))
+        glUseProgram(program);
+}
+
+void bindVertexArray(RenderState& state, unsigned int vertexArray) {
+    if (update(state, state.vertexArray, vertexArray))
+        glBindVertexArray(vertexArray);
+}
+
+void bindTexture(RenderState& state, unsigned int unit, GLenum target, unsigned int texture) {
+    unsigned int* bound = NULL;
+    if (unit < (unsigned int)RenderState::TEXTURE_UNITS)
+    {
+        if (target == GL_TEXTURE_2D)
+            bound = &state.textures2D[unit];
+        else if (target == GL_TEXTURE_2D_ARRAY)
+            bound = &state.textureArrays[unit];
+        else if (target == GL_TEXTURE_BUFFER)
+            bound = &state.textureBuffers[unit];
+    }
+    if (bound && *bound == texture)
+    {
+        state.counters.skipped++;
+        return;
+    }
+
+    if (update(state, state.activeTexture, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+    if (bound)
+        *bound = texture;
+    state.counters.issued++;
+    glBindTexture(target, texture);
+}
+
+void setViewport(RenderState& state, int x, int y, int width, int height) {
+    if (state.viewport[0] == x && state.viewport[1] == y &&
+        state.viewport[2] == width && state.viewport[3] == height)
+    {
+        state.counters.skipped++;
+        return;
+    }
+    state.viewport[0] = x;
+    state.viewport[1] = y;
+    state.viewport[2] = width;
+    state.viewport[3] = height;
+    state.counters.issued++;
+    glViewport(x, y, width, height);
+}
+
+void setCapability(RenderState& state, GLenum capability, bool enabled) {
+    int index = capabilityIndex(capability);
+    if (index >= 0)
+    {
+        if (state.capabilities[index] == (signed char)enabled)
+        {
+            state.counters.skipped++;
+            return;
+        }
+        state.capabilities[index] = enabled;
+    }
+    state.counters.issued++;
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
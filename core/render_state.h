@@ -0,0 +1,43 @@
+#ifndef RENDER_STATE_H
+#define RENDER_STATE_H
+
+#include "opengl.h"
+
+struct RenderStateCounters {
+    unsigned int issued;  // calls that reached the driver
+    unsigned int skipped; // calls filtered because the state was already set
+};
+
+// Shadow copy of the GL state the draw loop touches. Every set/bind goes
+// through here and only reaches the driver when the value differs from the
+// last one set. Code that changes this state with raw GL calls (mesh upload,
+// texture loading) must call invalidateRenderState afterwards.
+struct RenderState {
+    static const int TEXTURE_UNITS = 16;
+    static const int CAPABILITIES = 4;
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int activeTexture;              // unit index, not GL_TEXTUREi
+    unsigned int textures2D[TEXTURE_UNITS];
+    unsigned int textureArrays[TEXTURE_UNITS];
+    unsigned int textureBuffers[TEXTURE_UNITS];
+    int viewport[4];
+    signed char capabilities[CAPABILITIES];  // -1 unknown, see capabilityIndex
+    RenderStateCounters counters;
+};
+
+// Forgets the shadowed values so the next call of each kind is issued
+void invalidateRenderState(RenderState& state);
+void resetRenderStateCounters(RenderState& state);
+
+void useProgram(RenderState& state, unsigned int program);
+void bindVertexArray(RenderState& state, unsigned int vertexArray);
+// target is GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY or GL_TEXTURE_BUFFER, switches
+// the active unit only when needed
+void bindTexture(RenderState& state, unsigned int unit, GLenum target, unsigned int texture);
+void setViewport(RenderState& state, int x, int y, int width, int height);
+// GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND or GL_SCISSOR_TEST, others are always issued
+void setCapability(RenderState& state, GLenum capability, bool enabled);
+
+#endif
@@ -0,0 +1,235 @@
+#include "shader_program.h"
+#include "opengl.h"
+#include "uniform_buffers.h"
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <glm/gtc/type_ptr.hpp>
+
+static std::string readShaderCode(const char* fileName) {
+    std::ifstream meInput(fileName);
+    if (!meInput.good())
+    {
+        fprintf(stderr, "File failed to load... %s\n", fileName);
+        return std::string();
+    }
+    return std::string(
+        std::istreambuf_iterator<char>(meInput),
+        std::istreambuf_iterator<char>());
+}
+
+static unsigned int compileShader(GLenum stage, const char* fileName) {
+    std::string source = readShaderCode(fileName);
+    if (source.empty())
+        return 0;
+
+    unsigned int shader = glCreateShader(stage);
+    const char* adapter[1] = { source.c_str() };
+    glShaderSource(shader, 1, adapter, 0);
+    glCompileShader(shader);
+
+    int success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        char infoLog[1024];
+        glGetShaderInfoLog(shader, sizeof(infoLog), NULL, infoLog);
+        fprintf(stderr, "%s: %s", fileName, infoLog);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// FNV-1a, names are short so this is cheaper than anything fancier
+static unsigned int hashName(const char* name) {
+    unsigned int hash = 2166136261u;
+    for (; *name; name++)
+        hash = (hash ^ (unsigned char)*name) * 16777619u;
+    return hash;
+}
+
+ShaderProgram::ShaderProgram() : uploadsIssued(0), uploadsSkipped(0), program(0) {
+}
+
+bool ShaderProgram::load(const char* vertexFile, const char* fragmentFile) {
+    unsigned int vertexShader = compileShader(GL_VERTEX_SHADER, vertexFile);
+    unsigned int fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentFile);
+    if (!vertexShader || !fragmentShader)
+    {
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return false;
+    }
+
+    program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        char infoLog[1024];
+        glGetProgramInfoLog(program, sizeof(infoLog), NULL, infoLog);
+        fputs(infoLog, stderr);
+        destroy();
+        return false;
+    }
+
+    bindSharedUniformBlocks(program);
+    reflect();
+    return true;
+}
+
+void ShaderProgram::destroy() {
+    glDeleteProgram(program);
+    program = 0;
+    uniforms.clear();
+    attributes.clear();
+    slotTable.clear();
+    slotHashes.clear();
+}
+
+void ShaderProgram::reflect() {
+    int uniformCount = 0, attributeCount = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attributeCount);
+
+    size_t tableSize = 16;
+    while (tableSize < (size_t)uniformCount * 4)
+        tableSize *= 2;
+    slotTable.assign(tableSize, -1);
+    slotHashes.assign(tableSize, 0);
+    uniforms.clear();
+
+    char name[256];
+    for (int i = 0; i < uniformCount; i++)
+    {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(program, i, sizeof(name), NULL, &size, &type, name);
+        int location = glGetUniformLocation(program, name);
+        // Uniforms inside blocks have no location
+        if (location < 0)
+            continue;
+
+        UniformInfo info;
+        info.name = name;
+        info.location = location;
+        info.type = type;
+        info.size = size;
+        // Start from the program's current value (GLSL initializers included)
+        memset(info.value, 0, sizeof(info.value));
+        bool isInteger = type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D ||
+                         type == GL_SAMPLER_2D_ARRAY || type == GL_UNSIGNED_INT;
+        if (isInteger)
+            glGetUniformiv(program, location, (GLint*)info.value);
+        else
+            glGetUniformfv(program, location, (GLfloat*)info.value);
+
+        int slot = uniforms.size();
+        uniforms.push_back(info);
+        insertName(info.name, slot);
+        size_t bracket = info.name.find("[0]");
+        if (bracket != std::string::npos)
+            insertName(info.name.substr(0, bracket), slot);
+    }
+
+    attributes.clear();
+    for (int i = 0; i < attributeCount; i++)
+    {
+        GLint size;
+        GLenum type;
+        glGetActiveAttrib(program, i, sizeof(name), NULL, &size, &type, name);
+        AttributeInfo info = { name, glGetAttribLocation(program, name) };
+        attributes.push_back(info);
+    }
+}
+
+void ShaderProgram::insertName(const std::string& name, int slot) {
+    unsigned int hash = hashName(name.c_str());
+    size_t mask = slotTable.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        if (slotTable[i] < 0)
+        {
+            slotTable[i] = slot;
+            slotHashes[i] = hash;
+            return;
+        }
+    }
+}
+
+int ShaderProgram::uniformSlot(const char* name) const {
+    if (slotTable.empty())
+        return -1;
+    unsigned int hash = hashName(name);
+    size_t mask = slotTable.size() - 1;
+    for (size_t i = hash & mask; slotTable[i] >= 0; i = (i + 1) & mask)
+    {
+        if (slotHashes[i] != hash)
+            continue;
+        // The table also holds array names without their "[0]"
+        const std::string& candidate = uniforms[slotTable[i]].name;
+        size_t length = strlen(name);
+        if (candidate.compare(0, length, name) == 0 &&
+            (candidate.size() == length || candidate.compare(length, std::string::npos, "[0]") == 0))
+            return slotTable[i];
+    }
+    return -1;
+}
+
+int ShaderProgram::attributeLocation(const char* name) const {
+    for (size_t i = 0; i < attributes.size(); i++)
+    {
+        if (attributes[i].name == name)
+            return attributes[i].location;
+    }
+    return -1;
+}
+
+bool ShaderProgram::changed(int slot, const void* data, size_t bytes) {
+    UniformInfo& info = uniforms[slot];
+    if (memcmp(info.value, data, bytes) == 0)
+    {
+        uploadsSkipped++;
+        return false;
+    }
+    memcpy(info.value, data, bytes);
+    uploadsIssued++;
+    return true;
+}
+
+void ShaderProgram::setInt(int slot, int value) {
+    if (slot >= 0 && changed(slot, &value, sizeof(value)))
+        glProgramUniform1i(program, uniforms[slot].location, value);
+}
+
+void ShaderProgram::setFloat(int slot, float value) {
+    if (slot >= 0 && changed(slot, &value, sizeof(value)))
+        glProgramUniform1f(program, uniforms[slot].location, value);
+}
+
+void ShaderProgram::setVec3(int slot, const glm::vec3& value) {
+    if (slot >= 0 && changed(slot, glm::value_ptr(value), sizeof(float) * 3))
+        glProgramUniform3fv(program, uniforms[slot].location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::setMat3(int slot, const glm::mat3& value) {
+    if (slot >= 0 && changed(slot, glm::value_ptr(value), sizeof(float) * 9))
+        glProgramUniformMatrix3fv(program, uniforms[slot].location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void ShaderProgram::setMat4(int slot, const glm::mat4& value) {
+    if (slot >= 0 && changed(slot, glm::value_ptr(value), sizeof(float) * 16))
+        glProgramUniformMatrix4fv(program, uniforms[slot].location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void ShaderProgram::resetCounters() {
+    uploadsIssued = 0;
+    uploadsSkipped = 0;
+}
@@ -0,0 +1,67 @@
+#ifndef SHADER_PROGRAM_H
+#define SHADER_PROGRAM_H
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Linked GLSL program with its active uniforms and attributes reflected once
+// after glLinkProgram. Uniforms are addressed by slot: look the name up once
+// with uniformSlot() at setup and keep the integer, the set* calls then skip
+// the driver entirely when the value did not change since the last upload.
+// Uploads go through glProgramUniform*, so the program doesn't need to be bound.
+class ShaderProgram {
+public:
+    ShaderProgram();
+
+    // Compiles both stages from files and links them, logs errors to stderr.
+    // The shared uniform blocks are bound to their fixed binding points.
+    bool load(const char* vertexFile, const char* fragmentFile);
+    void destroy();
+
+    unsigned int id() const { return program; }
+
+    // Slot of an active uniform, -1 if the linker removed it or it doesn't exist.
+    // Array uniforms can be looked up with or without the "[0]" suffix.
+    int uniformSlot(const char* name) const;
+    int attributeLocation(const char* name) const;
+
+    // Setters are no-ops for slot -1, like glUniform* with location -1
+    void setInt(int slot, int value);
+    void setFloat(int slot, float value);
+    void setVec3(int slot, const glm::vec3& value);
+    void setMat3(int slot, const glm::mat3& value);
+    void setMat4(int slot, const glm::mat4& value);
+
+    // Uniform uploads issued vs. filtered out since the last reset
+    unsigned int uploadsIssued;
+    unsigned int uploadsSkipped;
+    void resetCounters();
+
+private:
+    struct UniformInfo {
+        std::string name;
+        int location;
+        unsigned int type;
+        int size;
+        unsigned char value[64]; // last uploaded value, enough for a mat4
+    };
+    struct AttributeInfo {
+        std::string name;
+        int location;
+    };
+
+    void reflect();
+    void insertName(const std::string& name, int slot);
+    // True when the value differs from the cached one, updates the cache
+    bool changed(int slot, const void* data, size_t bytes);
+
+    unsigned int program;
+    std::vector<UniformInfo> uniforms;
+    std::vector<AttributeInfo> attributes;
+    // Open addressing table of uniform slots keyed by name hash, -1 is empty
+    std::vector<int> slotTable;
+    std::vector<unsigned int> slotHashes;
+};
+
+#endif
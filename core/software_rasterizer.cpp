@@ -0,0 +1,513 @@
+#include "software_rasterizer.h"
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Clip space vertex between the vertex stage and clipping
+struct ClipVertex {
+    glm::vec4 position;
+    float attributes[RASTER_ATTRIBUTE_COUNT];
+};
+
+// Clipping against a band wider than the screen keeps edge functions
+// precise, the rest is left to the scissoring by tile bounds
+static const float GUARD_BAND = 1.25f;
+static const int CLIP_PLANE_COUNT = 6;
+static const glm::vec4 CLIP_PLANES[CLIP_PLANE_COUNT] = {
+    glm::vec4(0.0f, 0.0f, 1.0f, 1.0f),          // near
+    glm::vec4(0.0f, 0.0f, -1.0f, 1.0f),         // far
+    glm::vec4(1.0f, 0.0f, 0.0f, GUARD_BAND),    // left
+    glm::vec4(-1.0f, 0.0f, 0.0f, GUARD_BAND),   // right
+    glm::vec4(0.0f, 1.0f, 0.0f, GUARD_BAND),    // bottom
+    glm::vec4(0.0f, -1.0f, 0.0f, GUARD_BAND),   // top
+};
+// Window coordinates snap to 1/256 pixel like GL's subpixel precision
+static const float SUBPIXEL_STEPS = 256.0f;
+
+void resizeSoftwareFramebuffer(SoftwareFramebuffer& framebuffer, int width, int height) {
+    framebuffer.width = width;
+    framebuffer.height = height;
+    framebuffer.color.resize(width * height * 3);
+    framebuffer.depth.resize(width * height);
+}
+
+static float planeDistance(const glm::vec4& plane, const glm::vec4& v) {
+    return plane.x * v.x + plane.y * v.y + plane.z * v.z + plane.w * v.w;
+}
+
+static ClipVertex lerpVertex(const ClipVertex& a, const ClipVertex& b, float t) {
+    ClipVertex result;
+    result.position = a.position + (b.position - a.position) * t;
+    for (int i = 0; i < RASTER_ATTRIBUTE_COUNT; i++)
+        result.attributes[i] = a.attributes[i] + (b.attributes[i] - a.attributes[i]) * t;
+    return result;
+}
+
+static RasterVertex projectVertex(const ClipVertex& vertex, int width, int height) {
+    RasterVertex result;
+    float inverseW = 1.0f / vertex.position.w;
+    float x = (vertex.position.x * inverseW * 0.5f + 0.5f) * width;
+    float y = (vertex.position.y * inverseW * 0.5f + 0.5f) * height;
+    result.x = floorf(x * SUBPIXEL_STEPS + 0.5f) / SUBPIXEL_STEPS;
+    result.y = floorf(y * SUBPIXEL_STEPS + 0.5f) / SUBPIXEL_STEPS;
+    result.z = vertex.position.z * inverseW * 0.5f + 0.5f;
+    result.inverseW = inverseW;
+    for (int i = 0; i < RASTER_ATTRIBUTE_COUNT; i++)
+        result.attributes[i] = vertex.attributes[i] * inverseW;
+    return result;
+}
+
+// The vertex shader's regular (non instanced) path for float vertices
+static void transformVertices(const SoftwareDraw& draw, std::vector<ClipVertex>& clipVertices) {
+    const std::vector<Vertex>& vertices = draw.mesh->vertices;
+    clipVertices.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex& vertex = vertices[i];
+        glm::vec4 position(vertex.position[0], vertex.position[1], vertex.position[2], 1.0f);
+        glm::vec3 normal = draw.normalMatrix * glm::vec3(vertex.normal[0], vertex.normal[1], vertex.normal[2]);
+        glm::vec4 worldPosition = draw.model * position;
+        ClipVertex& out = clipVertices[i];
+        out.position = draw.modelViewProjection * position;
+        float* attributes = out.attributes;
+        attributes[0] = vertex.color[0];
+        attributes[1] = vertex.color[1];
+        attributes[2] = vertex.color[2];
+        attributes[3] = normal.x;
+        attributes[4] = normal.y;
+        attributes[5] = normal.z;
+        attributes[6] = worldPosition.x;
+        attributes[7] = worldPosition.y;
+        attributes[8] = worldPosition.z;
+        attributes[9] = vertex.texCoord[0];
+        attributes[10] = vertex.texCoord[1];
+    }
+}
+
+static void setupTriangle(SoftwareRenderer& renderer, int width, int height, const RasterVertex& v0,
+                          const RasterVertex& v1, const RasterVertex& v2, unsigned int draw) {
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    if (area == 0.0f)
+        return;
+
+    RasterTriangle triangle;
+    triangle.minX = std::max(0, (int)floorf(std::min(v0.x, std::min(v1.x, v2.x))));
+    triangle.minY = std::max(0, (int)floorf(std::min(v0.y, std::min(v1.y, v2.y))));
+    triangle.maxX = std::min(width - 1, (int)ceilf(std::max(v0.x, std::max(v1.x, v2.x))));
+    triangle.maxY = std::min(height - 1, (int)ceilf(std::max(v0.y, std::max(v1.y, v2.y))));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        return;
+
+    triangle.vertices[0] = v0;
+    triangle.vertices[1] = v1;
+    triangle.vertices[2] = v2;
+    // Both windings are drawn (no face culling), flip clockwise edges so inside is positive
+    float orientation = area > 0.0f ? 1.0f : -1.0f;
+    triangle.topLeft = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        const RasterVertex& from = triangle.vertices[i];
+        const RasterVertex& to = triangle.vertices[(i + 1) % 3];
+        float a = -(to.y - from.y) * orientation;
+        float b = (to.x - from.x) * orientation;
+        triangle.edgeA[i] = a;
+        triangle.edgeB[i] = b;
+        triangle.edgeC[i] = -(a * from.x + b * from.y) + 0.5f * (a + b);
+        // Left edges run downwards, top edges are horizontal with the inside below
+        if (a > 0.0f || (a == 0.0f && b < 0.0f))
+            triangle.topLeft |= 1u << i;
+    }
+    triangle.inverseArea = 1.0f / fabsf(area);
+    triangle.draw = draw;
+    renderer.triangles.push_back(triangle);
+}
+
+static void clipTriangle(SoftwareRenderer& renderer, int width, int height, const ClipVertex& a,
+                         const ClipVertex& b, const ClipVertex& c, unsigned int draw) {
+    ClipVertex polygon[9], clipped[9];
+    polygon[0] = a;
+    polygon[1] = b;
+    polygon[2] = c;
+    int count = 3;
+    for (int p = 0; p < CLIP_PLANE_COUNT && count >= 3; p++)
+    {
+        const glm::vec4& plane = CLIP_PLANES[p];
+        if (planeDistance(plane, a.position) >= 0.0f && planeDistance(plane, b.position) >= 0.0f &&
+            planeDistance(plane, c.position) >= 0.0f)
+            continue;
+        // Sutherland-Hodgman
+        int clippedCount = 0;
+        for (int i = 0; i < count; i++)
+        {
+            const ClipVertex& from = polygon[i];
+            const ClipVertex& to = polygon[(i + 1) % count];
+            float dFrom = planeDistance(plane, from.position), dTo = planeDistance(plane, to.position);
+            if (dFrom >= 0.0f)
+                clipped[clippedCount++] = from;
+            if ((dFrom >= 0.0f) != (dTo >= 0.0f))
+                clipped[clippedCount++] = lerpVertex(from, to, dFrom / (dFrom - dTo));
+        }
+        std::copy(clipped, clipped + clippedCount, polygon);
+        count = clippedCount;
+    }
+    if (count < 3)
+        return;
+
+    RasterVertex projected[9];
+    for (int i = 0; i < count; i++)
+        projected[i] = projectVertex(polygon[i], width, height);
+    for (int i = 2; i < count; i++)
+        setupTriangle(renderer, width, height, projected[0], projected[i - 1], projected[i], draw);
+}
+
+static void clipLine(SoftwareRenderer& renderer, int width, int height, const ClipVertex& a,
+                     const ClipVertex& b, unsigned int draw) {
+    float tBegin = 0.0f, tEnd = 1.0f;
+    for (int p = 0; p < CLIP_PLANE_COUNT; p++)
+    {
+        float dA = planeDistance(CLIP_PLANES[p], a.position), dB = planeDistance(CLIP_PLANES[p], b.position);
+        if (dA < 0.0f && dB < 0.0f)
+            return;
+        if (dA < 0.0f)
+            tBegin = std::max(tBegin, dA / (dA - dB));
+        else if (dB < 0.0f)
+            tEnd = std::min(tEnd, dA / (dA - dB));
+    }
+    if (tBegin >= tEnd)
+        return;
+
+    RasterLine line;
+    line.vertices[0] = projectVertex(lerpVertex(a, b, tBegin), width, height);
+    line.vertices[1] = projectVertex(lerpVertex(a, b, tEnd), width, height);
+    line.minX = std::max(0, (int)floorf(std::min(line.vertices[0].x, line.vertices[1].x)));
+    line.minY = std::max(0, (int)floorf(std::min(line.vertices[0].y, line.vertices[1].y)));
+    line.maxX = std::min(width - 1, (int)floorf(std::max(line.vertices[0].x, line.vertices[1].x)));
+    line.maxY = std::min(height - 1, (int)floorf(std::max(line.vertices[0].y, line.vertices[1].y)));
+    if (line.minX > line.maxX || line.minY > line.maxY)
+        return;
+    line.draw = draw;
+    renderer.lines.push_back(line);
+}
+
+// GL_LINEAR filtering with GL_REPEAT wrapping
+static glm::vec3 sampleTexture(const SoftwareTexture& texture, float s, float t) {
+    if (texture.pixels.empty())
+        return glm::vec3(0.0f, 0.0f, 0.0f); // an incomplete GL texture samples black
+    float u = s * texture.width - 0.5f, v = t * texture.height - 0.5f;
+    float u0 = floorf(u), v0 = floorf(v);
+    float fu = u - u0, fv = v - v0;
+    int x0 = ((int)u0 % texture.width + texture.width) % texture.width;
+    int y0 = ((int)v0 % texture.height + texture.height) % texture.height;
+    int x1 = (x0 + 1) % texture.width, y1 = (y0 + 1) % texture.height;
+    const unsigned char* p00 = &texture.pixels[(y0 * texture.width + x0) * 3];
+    const unsigned char* p10 = &texture.pixels[(y0 * texture.width + x1) * 3];
+    const unsigned char* p01 = &texture.pixels[(y1 * texture.width + x0) * 3];
+    const unsigned char* p11 = &texture.pixels[(y1 * texture.width + x1) * 3];
+    glm::vec3 color;
+    for (int c = 0; c < 3; c++)
+    {
+        float top = p00[c] + (p10[c] - p00[c]) * fu;
+        float bottom = p01[c] + (p11[c] - p01[c]) * fu;
+        color[c] = (top + (bottom - top) * fv) / 255.0f;
+    }
+    return color;
+}
+
+// FragmentShaderCode.glsl
+static void shadeFragment(const SoftwareDraw& draw, const SoftwareLighting& lighting, const float* attributes,
+                          unsigned char* out) {
+    glm::vec3 result(attributes[0], attributes[1], attributes[2]);
+    if (draw.useLighting)
+    {
+        glm::vec3 ambient = 0.1f * lighting.lightColor;
+
+        glm::vec3 norm = glm::normalize(glm::vec3(attributes[3], attributes[4], attributes[5]));
+        glm::vec3 fragPos(attributes[6], attributes[7], attributes[8]);
+        glm::vec3 lightDir = glm::normalize(lighting.lightPos - fragPos);
+        float diff = std::max(glm::dot(norm, lightDir), 0.0f);
+        glm::vec3 diffuse = diff * lighting.lightColor;
+
+        glm::vec3 viewDir = glm::normalize(lighting.viewPos - fragPos);
+        glm::vec3 reflectDir = -lightDir - 2.0f * glm::dot(norm, -lightDir) * norm;
+        float spec = powf(std::max(glm::dot(viewDir, reflectDir), 0.0f), 32.0f);
+        glm::vec3 specular = 0.5f * spec * lighting.lightColor;
+
+        glm::vec3 texColor = draw.texture ? sampleTexture(*draw.texture, attributes[9], attributes[10])
+                                          : glm::vec3(1.0f, 1.0f, 1.0f);
+        result = (ambient + diffuse + specular) * texColor;
+    }
+    for (int c = 0; c < 3; c++)
+        out[c] = (unsigned char)(std::min(std::max(result[c], 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+struct TileContext {
+    SoftwareRenderer* renderer;
+    SoftwareFramebuffer* framebuffer;
+    const SoftwareDraw* draws;
+    const SoftwareLighting* lighting;
+    glm::vec3 clearColor;
+};
+
+// Depth tests and shades one pixel of a triangle from its three edge values
+static void shadeTrianglePixel(const TileContext& context, const RasterTriangle& triangle, int x, int y,
+                               float e0, float e1, float e2) {
+    SoftwareFramebuffer& framebuffer = *context.framebuffer;
+    // Edge i is the weight of vertex i + 2
+    float w0 = e1 * triangle.inverseArea, w1 = e2 * triangle.inverseArea, w2 = e0 * triangle.inverseArea;
+    const RasterVertex* v = triangle.vertices;
+    float z = w0 * v[0].z + w1 * v[1].z + w2 * v[2].z;
+    float& depth = framebuffer.depth[y * framebuffer.width + x];
+    if (!(z < depth))
+        return;
+    depth = z;
+
+    float inverseW = w0 * v[0].inverseW + w1 * v[1].inverseW + w2 * v[2].inverseW;
+    float correction = 1.0f / inverseW;
+    float attributes[RASTER_ATTRIBUTE_COUNT];
+    for (int i = 0; i < RASTER_ATTRIBUTE_COUNT; i++)
+        attributes[i] = (w0 * v[0].attributes[i] + w1 * v[1].attributes[i] + w2 * v[2].attributes[i]) * correction;
+    shadeFragment(context.draws[triangle.draw], *context.lighting, attributes,
+                  &framebuffer.color[(y * framebuffer.width + x) * 3]);
+}
+
+static void rasterizeTriangle(const TileContext& context, const RasterTriangle& triangle,
+                              int tileMinX, int tileMinY, int tileMaxX, int tileMaxY) {
+    int minX = std::max(triangle.minX, tileMinX), maxX = std::min(triangle.maxX, tileMaxX);
+    int minY = std::max(triangle.minY, tileMinY), maxY = std::min(triangle.maxY, tileMaxY);
+    for (int y = minY; y <= maxY; y++)
+    {
+        float rowC0 = triangle.edgeB[0] * y + triangle.edgeC[0];
+        float rowC1 = triangle.edgeB[1] * y + triangle.edgeC[1];
+        float rowC2 = triangle.edgeB[2] * y + triangle.edgeC[2];
+#if defined(__SSE__)
+        __m128 a0 = _mm_set1_ps(triangle.edgeA[0]), a1 = _mm_set1_ps(triangle.edgeA[1]), a2 = _mm_set1_ps(triangle.edgeA[2]);
+        __m128 c0 = _mm_set1_ps(rowC0), c1 = _mm_set1_ps(rowC1), c2 = _mm_set1_ps(rowC2);
+        __m128 zero = _mm_setzero_ps();
+        __m128 allLanes = _mm_cmpeq_ps(zero, zero);
+        // Pixels exactly on an edge belong to it only when it is a top or left edge
+        __m128 onEdge0 = triangle.topLeft & 1 ? allLanes : zero;
+        __m128 onEdge1 = triangle.topLeft & 2 ? allLanes : zero;
+        __m128 onEdge2 = triangle.topLeft & 4 ? allLanes : zero;
+        for (int x = minX; x <= maxX; x += 4)
+        {
+            __m128 px = _mm_setr_ps(x, x + 1, x + 2, x + 3);
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), c0);
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), c1);
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), c2);
+            __m128 inside0 = _mm_or_ps(_mm_cmpgt_ps(e0, zero), _mm_and_ps(_mm_cmpeq_ps(e0, zero), onEdge0));
+            __m128 inside1 = _mm_or_ps(_mm_cmpgt_ps(e1, zero), _mm_and_ps(_mm_cmpeq_ps(e1, zero), onEdge1));
+            __m128 inside2 = _mm_or_ps(_mm_cmpgt_ps(e2, zero), _mm_and_ps(_mm_cmpeq_ps(e2, zero), onEdge2));
+            int mask = _mm_movemask_ps(_mm_and_ps(inside0, _mm_and_ps(inside1, inside2)));
+            // Lanes past the right end of the triangle's span
+            mask &= (1 << std::min(4, maxX - x + 1)) - 1;
+            if (!mask)
+                continue;
+            float edges0[4], edges1[4], edges2[4];
+            _mm_storeu_ps(edges0, e0);
+            _mm_storeu_ps(edges1, e1);
+            _mm_storeu_ps(edges2, e2);
+            for (int lane = 0; lane < 4; lane++)
+            {
+                if (mask & (1 << lane))
+                    shadeTrianglePixel(context, triangle, x + lane, y, edges0[lane], edges1[lane], edges2[lane]);
+            }
+        }
+#elif defined(__ARM_NEON)
+        float32x4_t a0 = vdupq_n_f32(triangle.edgeA[0]), a1 = vdupq_n_f32(triangle.edgeA[1]), a2 = vdupq_n_f32(triangle.edgeA[2]);
+        float32x4_t c0 = vdupq_n_f32(rowC0), c1 = vdupq_n_f32(rowC1), c2 = vdupq_n_f32(rowC2);
+        float32x4_t zero = vdupq_n_f32(0.0f);
+        uint32x4_t onEdge0 = vdupq_n_u32(triangle.topLeft & 1 ? 0xFFFFFFFFu : 0);
+        uint32x4_t onEdge1 = vdupq_n_u32(triangle.topLeft & 2 ? 0xFFFFFFFFu : 0);
+        uint32x4_t onEdge2 = vdupq_n_u32(triangle.topLeft & 4 ? 0xFFFFFFFFu : 0);
+        for (int x = minX; x <= maxX; x += 4)
+        {
+            float offsets[4] = { (float)x, x + 1.0f, x + 2.0f, x + 3.0f };
+            float32x4_t px = vld1q_f32(offsets);
+            float32x4_t e0 = vmlaq_f32(c0, a0, px), e1 = vmlaq_f32(c1, a1, px), e2 = vmlaq_f32(c2, a2, px);
+            uint32x4_t inside = vandq_u32(vorrq_u32(vcgtq_f32(e0, zero), vandq_u32(vceqq_f32(e0, zero), onEdge0)),
+                                vandq_u32(vorrq_u32(vcgtq_f32(e1, zero), vandq_u32(vceqq_f32(e1, zero), onEdge1)),
+                                          vorrq_u32(vcgtq_f32(e2, zero), vandq_u32(vceqq_f32(e2, zero), onEdge2))));
+            unsigned int lanes[4];
+            float edges0[4], edges1[4], edges2[4];
+            vst1q_u32(lanes, inside);
+            vst1q_f32(edges0, e0);
+            vst1q_f32(edges1, e1);
+            vst1q_f32(edges2, e2);
+            for (int lane = 0; lane < 4 && x + lane <= maxX; lane++)
+            {
+                if (lanes[lane])
+                    shadeTrianglePixel(context, triangle, x + lane, y, edges0[lane], edges1[lane], edges2[lane]);
+            }
+        }
+#else
+        for (int x = minX; x <= maxX; x++)
+        {
+            float e[3] = { triangle.edgeA[0] * x + rowC0, triangle.edgeA[1] * x + rowC1, triangle.edgeA[2] * x + rowC2 };
+            bool inside = true;
+            for (int i = 0; i < 3; i++)
+                inside = inside && (e[i] > 0.0f || (e[i] == 0.0f && (triangle.topLeft & (1u << i))));
+            if (inside)
+                shadeTrianglePixel(context, triangle, x, y, e[0], e[1], e[2]);
+        }
+#endif
+    }
+}
+
+// One pixel per step along the major axis, sampled at pixel centers
+static void rasterizeLine(const TileContext& context, const RasterLine& line,
+                          int tileMinX, int tileMinY, int tileMaxX, int tileMaxY) {
+    SoftwareFramebuffer& framebuffer = *context.framebuffer;
+    const RasterVertex& a = line.vertices[0];
+    const RasterVertex& b = line.vertices[1];
+    float dx = b.x - a.x, dy = b.y - a.y;
+    bool xMajor = fabsf(dx) >= fabsf(dy);
+    float majorBegin = xMajor ? std::min(a.x, b.x) : std::min(a.y, b.y);
+    float majorEnd = xMajor ? std::max(a.x, b.x) : std::max(a.y, b.y);
+    float majorDelta = xMajor ? dx : dy;
+    if (majorDelta == 0.0f)
+        return;
+    int first = std::max((int)ceilf(majorBegin - 0.5f), xMajor ? tileMinX : tileMinY);
+    int last = std::min((int)ceilf(majorEnd - 0.5f) - 1, xMajor ? tileMaxX : tileMaxY);
+    for (int major = first; major <= last; major++)
+    {
+        float t = (major + 0.5f - (xMajor ? a.x : a.y)) / majorDelta;
+        float minor = xMajor ? a.y + dy * t : a.x + dx * t;
+        int x = xMajor ? major : (int)floorf(minor);
+        int y = xMajor ? (int)floorf(minor) : major;
+        if (x < tileMinX || x > tileMaxX || y < tileMinY || y > tileMaxY)
+            continue;
+
+        float z = a.z + (b.z - a.z) * t;
+        float& depth = framebuffer.depth[y * framebuffer.width + x];
+        if (!(z < depth))
+            continue;
+        depth = z;
+        float inverseW = a.inverseW + (b.inverseW - a.inverseW) * t;
+        float attributes[RASTER_ATTRIBUTE_COUNT];
+        for (int i = 0; i < RASTER_ATTRIBUTE_COUNT; i++)
+            attributes[i] = (a.attributes[i] + (b.attributes[i] - a.attributes[i]) * t) / inverseW;
+        shadeFragment(context.draws[line.draw], *context.lighting, attributes,
+                      &framebuffer.color[(y * framebuffer.width + x) * 3]);
+    }
+}
+
+// Job over a range of tiles, clears them and rasterizes their bins
+static void rasterizeTilesJob(void* data, int begin, int end) {
+    TileContext* context = (TileContext*)data;
+    SoftwareRenderer& renderer = *context->renderer;
+    SoftwareFramebuffer& framebuffer = *context->framebuffer;
+    unsigned char clear[3];
+    for (int c = 0; c < 3; c++)
+        clear[c] = (unsigned char)(std::min(std::max(context->clearColor[c], 0.0f), 1.0f) * 255.0f + 0.5f);
+
+    for (int tile = begin; tile < end; tile++)
+    {
+        int minX = tile % renderer.tilesX * SOFTWARE_TILE_SIZE;
+        int minY = tile / renderer.tilesX * SOFTWARE_TILE_SIZE;
+        int maxX = std::min(minX + SOFTWARE_TILE_SIZE, framebuffer.width) - 1;
+        int maxY = std::min(minY + SOFTWARE_TILE_SIZE, framebuffer.height) - 1;
+        for (int y = minY; y <= maxY; y++)
+        {
+            std::fill(&framebuffer.depth[y * framebuffer.width + minX], &framebuffer.depth[y * framebuffer.width + maxX] + 1, 1.0f);
+            for (int x = minX; x <= maxX; x++)
+                std::copy(clear, clear + 3, &framebuffer.color[(y * framebuffer.width + x) * 3]);
+        }
+
+        const std::vector<unsigned int>& triangles = renderer.triangleBins[tile];
+        for (size_t i = 0; i < triangles.size(); i++)
+            rasterizeTriangle(*context, renderer.triangles[triangles[i]], minX, minY, maxX, maxY);
+        const std::vector<unsigned int>& lines = renderer.lineBins[tile];
+        for (size_t i = 0; i < lines.size(); i++)
+            rasterizeLine(*context, renderer.lines[lines[i]], minX, minY, maxX, maxY);
+    }
+}
+
+void renderSoftware(SoftwareRenderer& renderer, JobSystem& jobs, SoftwareFramebuffer& framebuffer,
+                    const SoftwareDraw* draws, size_t drawCount, const SoftwareLighting& lighting,
+                    const glm::vec3& clearColor) {
+    int width = framebuffer.width, height = framebuffer.height;
+
+    // VERTEX STAGE, CLIPPING AND SETUP
+    renderer.triangles.clear();
+    renderer.lines.clear();
+    std::vector<ClipVertex> clipVertices;
+    for (size_t d = 0; d < drawCount; d++)
+    {
+        const SoftwareDraw& draw = draws[d];
+        transformVertices(draw, clipVertices);
+        const std::vector<unsigned int>& indices = draw.mesh->indices;
+        if (draw.lines)
+        {
+            for (size_t i = 0; i + 1 < indices.size(); i += 2)
+                clipLine(renderer, width, height, clipVertices[indices[i]], clipVertices[indices[i + 1]], d);
+            continue;
+        }
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+            clipTriangle(renderer, width, height, clipVertices[indices[i]], clipVertices[indices[i + 1]],
+                         clipVertices[indices[i + 2]], d);
+    }
+
+    // BINNING
+    // Primitives keep their submission order inside every bin
+    renderer.tilesX = (width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+    renderer.tilesY = (height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+    size_t tileCount = renderer.tilesX * renderer.tilesY;
+    renderer.triangleBins.resize(tileCount);
+    renderer.lineBins.resize(tileCount);
+    for (size_t i = 0; i < tileCount; i++)
+    {
+        renderer.triangleBins[i].clear();
+        renderer.lineBins[i].clear();
+    }
+    for (size_t i = 0; i < renderer.triangles.size(); i++)
+    {
+        const RasterTriangle& triangle = renderer.triangles[i];
+        for (int tileY = triangle.minY / SOFTWARE_TILE_SIZE; tileY <= triangle.maxY / SOFTWARE_TILE_SIZE; tileY++)
+            for (int tileX = triangle.minX / SOFTWARE_TILE_SIZE; tileX <= triangle.maxX / SOFTWARE_TILE_SIZE; tileX++)
+                renderer.triangleBins[tileY * renderer.tilesX + tileX].push_back(i);
+    }
+    for (size_t i = 0; i < renderer.lines.size(); i++)
+    {
+        const RasterLine& line = renderer.lines[i];
+        for (int tileY = line.minY / SOFTWARE_TILE_SIZE; tileY <= line.maxY / SOFTWARE_TILE_SIZE; tileY++)
+            for (int tileX = line.minX / SOFTWARE_TILE_SIZE; tileX <= line.maxX / SOFTWARE_TILE_SIZE; tileX++)
+                renderer.lineBins[tileY * renderer.tilesX + tileX].push_back(i);
+    }
+
+    // RASTERIZATION
+    // Jobs take whole tiles, no two jobs ever touch the same pixel
+    TileContext context;
+    context.renderer = &renderer;
+    context.framebuffer = &framebuffer;
+    context.draws = draws;
+    context.lighting = &lighting;
+    context.clearColor = clearColor;
+    JobCounter rasterized;
+    parallelFor(jobs, rasterizeTilesJob, &context, (int)tileCount, 1, &rasterized);
+    waitForCounter(jobs, rasterized);
+}
+
+bool writeSoftwareFramebufferPPM(const SoftwareFramebuffer& framebuffer, const char* fileName) {
+    FILE* file = fopen(fileName, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "Failed to open %s for writing\n", fileName);
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", framebuffer.width, framebuffer.height);
+    // Rows start at the bottom like OpenGL's, image rows start at the top
+    int rowSize = framebuffer.width * 3;
+    for (int y = framebuffer.height - 1; y >= 0; y--)
+        fwrite(&framebuffer.color[y * rowSize], 1, rowSize, file);
+    bool ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+        fprintf(stderr, "Failed to write %s\n", fileName);
+    return ok;
+}
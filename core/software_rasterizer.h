@@ -0,0 +1,92 @@
+#ifndef SOFTWARE_RASTERIZER_H
+#define SOFTWARE_RASTERIZER_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "mesh.h"
+#include "job_system.h"
+
+static const int SOFTWARE_TILE_SIZE = 64;
+
+// RGB8 image sampled like the GL_REPEAT / GL_LINEAR texture in main.cpp,
+// rows in upload order (t = 0 first)
+struct SoftwareTexture {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+// RGB8 color and float depth, row 0 at the bottom like a GL framebuffer
+struct SoftwareFramebuffer {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> color;
+    std::vector<float> depth;
+};
+
+// One draw with the uniforms VertexShaderCode.glsl and FragmentShaderCode.glsl would get
+struct SoftwareDraw {
+    const Mesh* mesh;
+    bool lines;                     // GL_LINES over index pairs instead of triangles
+    glm::mat4 model;
+    glm::mat4 modelViewProjection;
+    glm::mat3 normalMatrix;
+    const SoftwareTexture* texture; // NULL is useTexture = false
+    bool useLighting;
+};
+
+// The FrameUniforms / LightUniforms values the fragment shader reads
+struct SoftwareLighting {
+    glm::vec3 viewPos;
+    glm::vec3 lightPos;
+    glm::vec3 lightColor;
+};
+
+// Number of interpolated floats: color, normal, world position, texture coords
+static const int RASTER_ATTRIBUTE_COUNT = 11;
+
+// Vertex in window coordinates, attributes divided by w for perspective correct interpolation
+struct RasterVertex {
+    float x, y, z;
+    float inverseW;
+    float attributes[RASTER_ATTRIBUTE_COUNT];
+};
+
+struct RasterTriangle {
+    RasterVertex vertices[3];
+    float edgeA[3], edgeB[3], edgeC[3]; // edge i is the weight of vertex i + 2, evaluated at pixel centers
+    unsigned int topLeft;               // bit i set when edge i owns pixels exactly on it
+    float inverseArea;
+    int minX, minY, maxX, maxY;         // inclusive pixel bounds
+    unsigned int draw;
+};
+
+struct RasterLine {
+    RasterVertex vertices[2];
+    int minX, minY, maxX, maxY;
+    unsigned int draw;
+};
+
+// Tiled CPU rasterizer reproducing the GL path's output: vertices are
+// transformed, clipped and set up on the calling thread and binned into
+// SOFTWARE_TILE_SIZE squares, then jobs take ranges of whole tiles and
+// rasterize every primitive of a tile in submission order (SIMD edge
+// functions, 4 pixels at a time) with GL_LESS depth testing and the Phong
+// shading of FragmentShaderCode.glsl.
+struct SoftwareRenderer {
+    int tilesX = 0, tilesY = 0;
+    std::vector<RasterTriangle> triangles;
+    std::vector<RasterLine> lines;
+    std::vector<std::vector<unsigned int> > triangleBins;
+    std::vector<std::vector<unsigned int> > lineBins;
+};
+
+void resizeSoftwareFramebuffer(SoftwareFramebuffer& framebuffer, int width, int height);
+// Clears to clearColor and renders the draws, tiles are split across jobs
+void renderSoftware(SoftwareRenderer& renderer, JobSystem& jobs, SoftwareFramebuffer& framebuffer,
+                    const SoftwareDraw* draws, size_t drawCount, const SoftwareLighting& lighting,
+                    const glm::vec3& clearColor);
+// Writes the color buffer as a binary PPM (P6) image, top row first
+bool writeSoftwareFramebufferPPM(const SoftwareFramebuffer& framebuffer, const char* fileName);
+
+#endif
@@ -0,0 +1,57 @@
+#include "texture_array.h"
+#include "pixel_format.h"
+#include <stdio.h>
+#include <algorithm>
+
+bool createTextureArray(TextureArray& array, const TextureAtlas& atlas, RenderState& state, JobSystem* jobs) {
+    int maxLayers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    if (atlas.pages.empty() || (int)atlas.pages.size() > maxLayers)
+    {
+        fprintf(stderr, "Can't make a texture array of %d layers (at most %d)\n", (int)atlas.pages.size(), maxLayers);
+        return false;
+    }
+    array.width = atlas.pageSize;
+    array.height = atlas.pageSize;
+    array.layerCount = atlas.pages.size();
+    array.levelCount = 1;
+    for (int size = atlas.pageSize; size > 1 && array.levelCount < atlas.mipSafeLevels; size /= 2)
+        array.levelCount++;
+
+    glGenTextures(1, &array.texture);
+    bindTexture(state, TEXTURE_ARRAY_UNIT, GL_TEXTURE_2D_ARRAY, array.texture);
+    if (textureStorageSupported())
+        allocateTextureStorage(GL_TEXTURE_2D_ARRAY, array.levelCount, GL_RGBA8, array.width, array.height, array.layerCount);
+    else
+    {
+        for (int level = 0; level < array.levelCount; level++)
+        {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, std::max(1, array.width >> level),
+                         std::max(1, array.height >> level), array.layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        }
+    }
+    MipChainSettings settings;
+    settings.jobs = jobs;
+    for (int layer = 0; layer < array.layerCount; layer++)
+    {
+        std::vector<TextureMip> mips(1, atlas.pages[layer]);
+        buildMipChain(mips, settings);
+        for (int level = 0; level < array.levelCount; level++)
+        {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, mips[level].width, mips[level].height, 1,
+                            GL_RGBA, GL_UNSIGNED_BYTE, mips[level].pixels.data());
+        }
+    }
+    // Images sit inside the pages, their own padding does the clamping
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, array.levelCount - 1);
+    return true;
+}
+
+void destroyTextureArray(TextureArray& array) {
+    glDeleteTextures(1, &array.texture);
+    array = TextureArray();
+}
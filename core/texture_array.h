@@ -0,0 +1,29 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include "job_system.h"
+#include "render_state.h"
+#include "texture_atlas.h"
+
+// Unit the array is bound to, apart from the 2D textures on unit 0 since
+// samplers of different types can't share a unit
+const int TEXTURE_ARRAY_UNIT = 2;
+
+// Atlas pages as the layers of one GL_TEXTURE_2D_ARRAY. Every material in
+// it draws with the same texture bound: a draw picks its layer with a
+// uniform (or its multi-draw data) and its rect through the mesh's
+// remapped texture coordinates.
+struct TextureArray {
+    unsigned int texture = 0;
+    int width = 0;
+    int height = 0;
+    int layerCount = 0;
+    int levelCount = 0;     // mip levels, at most atlas.mipSafeLevels so none bleeds
+};
+
+// Builds the pages' mip chains (sRGB box filter, rows split over jobs) and
+// uploads them. False when the context has fewer layers than pages.
+bool createTextureArray(TextureArray& array, const TextureAtlas& atlas, RenderState& state, JobSystem* jobs);
+void destroyTextureArray(TextureArray& array);
+
+#endif
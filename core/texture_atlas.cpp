@@ -0,0 +1,148 @@
+#include "texture_atlas.h"
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+
+void createTextureAtlas(TextureAtlas& atlas, int pageSize, int padding, int mipSafeLevels) {
+    atlas.pageSize = pageSize;
+    atlas.padding = padding;
+    atlas.mipSafeLevels = std::max(1, mipSafeLevels);
+    while (atlas.mipSafeLevels > 1 && (1 << (atlas.mipSafeLevels - 1)) > padding)
+        atlas.mipSafeLevels--;
+    atlas.pages.clear();
+    atlas.skylines.clear();
+    atlas.rects.clear();
+}
+
+static int alignUp(int value, int alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Lowest y a cell with its left edge on segment `index` can sit at, -1 when
+// it would run off the page
+static int skylineFit(const std::vector<SkylineSegment>& skyline, size_t index, int width, int height, int pageSize) {
+    if (skyline[index].x + width > pageSize)
+        return -1;
+    int y = 0;
+    // The segments cover the whole page width, so the cell's span ends inside them
+    for (size_t i = index, covered = 0; covered < (size_t)width; covered += skyline[i].width, i++)
+    {
+        y = std::max(y, skyline[i].y);
+        if (y + height > pageSize)
+            return -1;
+    }
+    return y;
+}
+
+// Bottom-left rule: the position with the lowest top edge, ties go to the
+// narrowest segment so wide gaps stay open for wide images
+static bool placeCell(std::vector<SkylineSegment>& skyline, int width, int height, int pageSize, int& x, int& y) {
+    int bestIndex = -1, bestTop = INT_MAX, bestWidth = INT_MAX;
+    for (size_t i = 0; i < skyline.size(); i++)
+    {
+        int fitY = skylineFit(skyline, i, width, height, pageSize);
+        if (fitY < 0)
+            continue;
+        if (fitY + height < bestTop || (fitY + height == bestTop && skyline[i].width < bestWidth))
+        {
+            bestIndex = i;
+            bestTop = fitY + height;
+            bestWidth = skyline[i].width;
+            y = fitY;
+        }
+    }
+    if (bestIndex < 0)
+        return false;
+    x = skyline[bestIndex].x;
+
+    // The cell's top becomes a segment, the ones it covers shrink or go
+    SkylineSegment top = { x, y + height, width };
+    skyline.insert(skyline.begin() + bestIndex, top);
+    for (size_t i = bestIndex + 1; i < skyline.size();)
+    {
+        int covered = x + width - skyline[i].x;
+        if (covered <= 0)
+            break;
+        if (covered < skyline[i].width)
+        {
+            skyline[i].x += covered;
+            skyline[i].width -= covered;
+            break;
+        }
+        skyline.erase(skyline.begin() + i);
+    }
+    for (size_t i = 0; i + 1 < skyline.size();)
+    {
+        if (skyline[i].y == skyline[i + 1].y)
+        {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        }
+        else
+            i++;
+    }
+    return true;
+}
+
+int addAtlasImage(TextureAtlas& atlas, const TextureMip& image) {
+    int alignment = 1 << (atlas.mipSafeLevels - 1);
+    int cellWidth = alignUp(image.width + atlas.padding * 2, alignment);
+    int cellHeight = alignUp(image.height + atlas.padding * 2, alignment);
+    if (cellWidth > atlas.pageSize || cellHeight > atlas.pageSize)
+    {
+        fprintf(stderr, "A %dx%d image doesn't fit a %dx%d atlas page\n", image.width, image.height,
+                atlas.pageSize, atlas.pageSize);
+        return -1;
+    }
+
+    int page = 0, cellX = 0, cellY = 0;
+    while (page < (int)atlas.pages.size() && !placeCell(atlas.skylines[page], cellWidth, cellHeight, atlas.pageSize, cellX, cellY))
+        page++;
+    if (page == (int)atlas.pages.size())
+    {
+        TextureMip pixels;
+        pixels.width = atlas.pageSize;
+        pixels.height = atlas.pageSize;
+        pixels.pixels.assign((size_t)atlas.pageSize * atlas.pageSize * 4, 0);
+        atlas.pages.push_back(pixels);
+        atlas.skylines.push_back(std::vector<SkylineSegment>(1));
+        SkylineSegment& floor = atlas.skylines.back()[0];
+        floor.x = 0;
+        floor.y = 0;
+        floor.width = atlas.pageSize;
+        placeCell(atlas.skylines.back(), cellWidth, cellHeight, atlas.pageSize, cellX, cellY);
+    }
+
+    // The image sits past the padding, its edge texels are repeated out to the cell's border
+    AtlasRect rect;
+    rect.layer = page;
+    rect.x = cellX + atlas.padding;
+    rect.y = cellY + atlas.padding;
+    rect.width = image.width;
+    rect.height = image.height;
+    rect.uvOffset = glm::vec2(rect.x, rect.y) / (float)atlas.pageSize;
+    rect.uvScale = glm::vec2(rect.width, rect.height) / (float)atlas.pageSize;
+    TextureMip& target = atlas.pages[page];
+    for (int y = cellY; y < cellY + cellHeight; y++)
+    {
+        int sourceY = std::min(std::max(y - rect.y, 0), image.height - 1);
+        for (int x = cellX; x < cellX + cellWidth; x++)
+        {
+            int sourceX = std::min(std::max(x - rect.x, 0), image.width - 1);
+            memcpy(&target.pixels[((size_t)y * target.width + x) * 4],
+                   &image.pixels[((size_t)sourceY * image.width + sourceX) * 4], 4);
+        }
+    }
+    atlas.rects.push_back(rect);
+    return atlas.rects.size() - 1;
+}
+
+void remapTexCoords(Mesh& mesh, const AtlasRect& rect) {
+    for (size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        float* texCoord = mesh.vertices[i].texCoord;
+        texCoord[0] = texCoord[0] * rect.uvScale.x + rect.uvOffset.x;
+        texCoord[1] = texCoord[1] * rect.uvScale.y + rect.uvOffset.y;
+    }
+}
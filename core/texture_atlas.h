@@ -0,0 +1,51 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "mesh.h"
+#include "mip_chain.h"
+
+// Where an image landed: a page of the atlas (a layer of the texture array)
+// and its pixels there, without the padding
+struct AtlasRect {
+    int layer;
+    int x, y, width, height;
+    glm::vec2 uvOffset;     // texCoord * uvScale + uvOffset lands inside the rect
+    glm::vec2 uvScale;
+};
+
+// Top edge of the packed area from x to x + width
+struct SkylineSegment {
+    int x, y, width;
+};
+
+// Packs images into square RGBA8 pages with a skyline bottom-left packer,
+// opening a new page when one is full. Every image gets `padding` pixels of
+// its own edge texels around it, so bilinear filtering at the rect's edge
+// never reads a neighbour. Levels 0 to mipSafeLevels - 1 stay apart too:
+// cells (image and padding) start and end on multiples of
+// 2^(mipSafeLevels - 1), so no texel of those levels spans two cells, and
+// the padding is at least one texel of the coarsest of them wide, so the
+// bilinear footprint at a rect's edge stays in its own cell.
+struct TextureAtlas {
+    int pageSize;
+    int padding;
+    int mipSafeLevels;      // levels that may be sampled, finest included
+    std::vector<TextureMip> pages;
+    std::vector<std::vector<SkylineSegment> > skylines; // one per page
+    std::vector<AtlasRect> rects;                       // one per added image
+};
+
+// mipSafeLevels is lowered until 2^(mipSafeLevels - 1) <= padding
+void createTextureAtlas(TextureAtlas& atlas, int pageSize = 1024, int padding = 8, int mipSafeLevels = 4);
+
+// Packs the image and returns its rect index, -1 when it can't fit a page
+int addAtlasImage(TextureAtlas& atlas, const TextureMip& image);
+
+// Maps the mesh's texture coordinates (0..1 over the image) into the rect.
+// Coordinates outside 0..1 would wrap into other images, atlas meshes must
+// not rely on GL_REPEAT.
+void remapTexCoords(Mesh& mesh, const AtlasRect& rect);
+
+#endif
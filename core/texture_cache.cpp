@@ -0,0 +1,149 @@
+#include "texture_cache.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static unsigned long long alignTo16(unsigned long long offset) {
+    return (offset + 15) & ~15ULL;
+}
+
+bool writeTextureCache(const std::vector<TextureMip>& mips, TextureFormat format, const char* fileName) {
+    TextureCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "JBTX", 4);
+    header.version = TEXTURE_CACHE_VERSION;
+    header.format = format;
+    header.width = mips[0].width;
+    header.height = mips[0].height;
+    header.levelCount = mips.size();
+    for (size_t i = 3; i < mips[0].pixels.size(); i += 4)
+    {
+        if (mips[0].pixels[i] != 255)
+        {
+            header.flags |= TEXTURE_CACHE_HAS_ALPHA;
+            break;
+        }
+    }
+
+    std::vector<TextureCacheLevel> levels(mips.size());
+    std::vector<std::vector<unsigned char> > blocks(mips.size());
+    unsigned long long offset = sizeof(header) + levels.size() * sizeof(TextureCacheLevel);
+    for (size_t i = 0; i < mips.size(); i++)
+    {
+        levels[i].width = mips[i].width;
+        levels[i].height = mips[i].height;
+        levels[i].offset = alignTo16(offset);
+        levels[i].size = textureLevelSize(format, mips[i].width, mips[i].height);
+        blocks[i].resize(levels[i].size);
+        compressImage(format, mips[i].pixels.data(), mips[i].width, mips[i].height, blocks[i].data());
+        offset = levels[i].offset + levels[i].size;
+    }
+
+    FILE* file = fopen(fileName, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "Failed to open %s for writing\n", fileName);
+        return false;
+    }
+    static const char padding[16] = { 0 };
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(levels.data(), sizeof(TextureCacheLevel), levels.size(), file);
+    offset = sizeof(header) + levels.size() * sizeof(TextureCacheLevel);
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        fwrite(padding, 1, levels[i].offset - offset, file);
+        fwrite(blocks[i].data(), 1, blocks[i].size(), file);
+        offset = levels[i].offset + levels[i].size;
+    }
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+// Levels go straight to glTexStorage2D and the sub image uploads, so the
+// table must be an exact chain of the header's size: level i is
+// max(1, width >> i) by max(1, height >> i), at most down to 1x1
+static bool validTextureCache(const TextureCacheFile& file) {
+    const TextureCacheHeader* header = file.header;
+    if (memcmp(header->magic, "JBTX", 4) != 0 || header->version != TEXTURE_CACHE_VERSION ||
+        header->format >= TEXTURE_FORMAT_COUNT || header->width == 0 || header->height == 0 ||
+        header->levelCount == 0 ||
+        sizeof(TextureCacheHeader) + (size_t)header->levelCount * sizeof(TextureCacheLevel) > file.fileSize)
+        return false;
+    unsigned int largest = header->width > header->height ? header->width : header->height;
+    unsigned int maxLevels = 1;
+    while (maxLevels < 32 && (largest >> maxLevels) > 0)
+        maxLevels++;
+    if (header->levelCount > maxLevels)
+        return false;
+    for (unsigned int i = 0; i < header->levelCount; i++)
+    {
+        const TextureCacheLevel& level = file.levels[i];
+        unsigned int width = header->width >> i, height = header->height >> i;
+        // Offsets are untrusted, adding the size to one could wrap
+        if (level.width != (width > 0 ? width : 1) || level.height != (height > 0 ? height : 1) ||
+            level.size != textureLevelSize((TextureFormat)header->format, level.width, level.height) ||
+            level.offset > file.fileSize || level.size > file.fileSize - level.offset)
+            return false;
+    }
+    return true;
+}
+
+bool mapTextureCache(const char* fileName, TextureCacheFile& file) {
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open texture cache %s\n", fileName);
+        return false;
+    }
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) != 0 || (size_t)fileInfo.st_size < sizeof(TextureCacheHeader))
+    {
+        fprintf(stderr, "Texture cache %s is truncated\n", fileName);
+        close(fd);
+        return false;
+    }
+    file.fileSize = fileInfo.st_size;
+    void* mapping = mmap(NULL, file.fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map texture cache %s\n", fileName);
+        return false;
+    }
+
+    file.bytes = (const unsigned char*)mapping;
+    file.header = (const TextureCacheHeader*)mapping;
+    file.levels = (const TextureCacheLevel*)(file.bytes + sizeof(TextureCacheHeader));
+    if (!validTextureCache(file))
+    {
+        fprintf(stderr, "Texture cache %s is invalid or from another version\n", fileName);
+        unmapTextureCache(file);
+        return false;
+    }
+    return true;
+}
+
+void unmapTextureCache(TextureCacheFile& file) {
+    if (file.bytes)
+        munmap((void*)file.bytes, file.fileSize);
+    file.bytes = NULL;
+    file.header = NULL;
+    file.levels = NULL;
+}
+
+bool readTextureCache(const char* fileName, TextureMip& mip) {
+    TextureCacheFile file;
+    if (!mapTextureCache(fileName, file))
+        return false;
+    mip.width = file.levels[0].width;
+    mip.height = file.levels[0].height;
+    mip.pixels.resize((size_t)mip.width * mip.height * 4);
+    decompressImage((TextureFormat)file.header->format, file.bytes + file.levels[0].offset, mip.width, mip.height,
+                    mip.pixels.data());
+    unmapTextureCache(file);
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <stddef.h>
+#include <vector>
+#include "block_compression.h"
+#include "mip_chain.h"
+
+// Packed texture format (.tex), produced offline with --convert-texture.
+// Layout: TextureCacheHeader, levelCount TextureCacheLevel entries, finest
+// first, then each level's blocks starting on a 16 byte boundary. Levels
+// are stored exactly as glCompressedTexSubImage2D (or glTexSubImage2D for
+// RGBA8) takes them, so loading is a memory map and a copy.
+struct TextureCacheHeader {
+    char magic[4];            // "JBTX"
+    unsigned int version;
+    unsigned int format;      // TextureFormat
+    unsigned int width;
+    unsigned int height;
+    unsigned int levelCount;
+    unsigned int flags;       // TEXTURE_CACHE_*
+    unsigned int reserved;
+};
+
+struct TextureCacheLevel {
+    unsigned int width;
+    unsigned int height;
+    unsigned long long offset;
+    unsigned long long size;
+};
+
+const unsigned int TEXTURE_CACHE_VERSION = 1;
+const unsigned int TEXTURE_CACHE_HAS_ALPHA = 1; // some texel isn't opaque
+
+// Compresses every level of mips (finest first) into format and writes them
+bool writeTextureCache(const std::vector<TextureMip>& mips, TextureFormat format, const char* fileName);
+
+// A mapped .tex file, level data points into the mapping
+struct TextureCacheFile {
+    const TextureCacheHeader* header;
+    const TextureCacheLevel* levels;
+    const unsigned char* bytes;
+    size_t fileSize;
+};
+
+// Maps the file and validates its header and level table
+bool mapTextureCache(const char* fileName, TextureCacheFile& file);
+void unmapTextureCache(TextureCacheFile& file);
+
+// Decompresses the finest level into RGBA8, for code that has no GL context
+// (the software rasterizer)
+bool readTextureCache(const char* fileName, TextureMip& mip);
+
+#endif
@@ -0,0 +1,422 @@
+#include "texture_streaming.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+// Block formats are extensions on GL 4.1, the headers may not have them
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+static const GLenum INTERNAL_FORMATS[TEXTURE_FORMAT_COUNT] = {
+    GL_RGBA8, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_COMPRESSED_RGBA_BPTC_UNORM
+};
+
+bool textureFormatSupported(TextureFormat format) {
+    if (format == TEXTURE_FORMAT_BC1 || format == TEXTURE_FORMAT_BC3)
+        return hasGLExtension("GL_EXT_texture_compression_s3tc");
+    if (format == TEXTURE_FORMAT_BC7)
+    {
+        // Core since 4.2
+        int major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        return major > 4 || (major == 4 && minor >= 2) || hasGLExtension("GL_ARB_texture_compression_bptc");
+    }
+    return true;
+}
+
+static bool isTextureCacheFile(const std::string& fileName) {
+    return fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, ".tex") == 0;
+}
+
+// Maps a .tex, levels in a format the GL can't sample are decompressed into mips
+static bool mapTextureLevels(StreamedTexture& texture) {
+    if (!mapTextureCache(texture.fileName.c_str(), texture.cache))
+        return false;
+    texture.format = (TextureFormat)texture.cache.header->format;
+    if (texture.uploadFormats & 1u << texture.format)
+        return true;
+    texture.mips.resize(texture.cache.header->levelCount);
+    for (size_t i = 0; i < texture.mips.size(); i++)
+    {
+        const TextureCacheLevel& level = texture.cache.levels[i];
+        TextureMip& mip = texture.mips[i];
+        mip.width = level.width;
+        mip.height = level.height;
+        mip.pixels.resize((size_t)mip.width * mip.height * 4);
+        decompressImage(texture.format, texture.cache.bytes + level.offset, mip.width, mip.height, mip.pixels.data());
+    }
+    unmapTextureCache(texture.cache);
+    texture.format = TEXTURE_FORMAT_RGBA8;
+    return true;
+}
+
+// Images get the tightest format for their channels and bit depth
+static bool decodeTextureLevels(StreamedTexture& texture) {
+    texture.format = TEXTURE_FORMAT_RGBA8;
+    return loadPixelLevels(texture.fileName.c_str(), texture.usage, texture.pixelFormat, texture.mips);
+}
+
+static void decodeTextureJob(void* data, int begin, int end) {
+    StreamedTexture& texture = *(StreamedTexture*)data;
+    texture.pixelFormat = PIXEL_FORMAT_RGBA8;
+    bool loaded = isTextureCacheFile(texture.fileName) ? mapTextureLevels(texture) : decodeTextureLevels(texture);
+    texture.residency = loaded ? TEXTURE_DECODED : TEXTURE_FAILED;
+}
+
+// A level as upload rows: pixel rows when uncompressed, rows of 4x4 blocks otherwise
+struct UploadLevel {
+    const unsigned char* bytes;
+    int width, height;
+    int rowCount;
+    size_t rowBytes;
+};
+
+static UploadLevel uploadLevel(const StreamedTexture& texture, int level) {
+    UploadLevel upload;
+    if (texture.cache.bytes)
+    {
+        const TextureCacheLevel& cached = texture.cache.levels[level];
+        upload.bytes = texture.cache.bytes + cached.offset;
+        upload.width = cached.width;
+        upload.height = cached.height;
+    }
+    else
+    {
+        upload.bytes = texture.mips[level].pixels.data();
+        upload.width = texture.mips[level].width;
+        upload.height = texture.mips[level].height;
+    }
+    int blockSize = textureBlockSize(texture.format);
+    upload.rowCount = (upload.height + blockSize - 1) / blockSize;
+    if (texture.format == TEXTURE_FORMAT_RGBA8)
+        upload.rowBytes = (size_t)upload.width * pixelFormatInfo(texture.pixelFormat).pixelBytes;
+    else
+        upload.rowBytes = textureLevelSize(texture.format, upload.width, 1);
+    return upload;
+}
+
+static GLenum internalFormat(const StreamedTexture& texture) {
+    if (texture.format == TEXTURE_FORMAT_RGBA8)
+        return pixelFormatInfo(texture.pixelFormat).internalFormat;
+    return INTERNAL_FORMATS[texture.format];
+}
+
+// CPU copies of the levels, not needed once they are all on the GPU
+static void releaseLevelData(StreamedTexture& texture) {
+    texture.mips.clear();
+    unmapTextureCache(texture.cache);
+}
+
+static void startDecode(TextureStreamer& streamer, StreamedTexture& texture) {
+    texture.residency = TEXTURE_DECODING;
+    texture.uploadFormats = streamer.uploadFormats;
+    runJob(*streamer.jobs, decodeTextureJob, &texture, &streamer.decodes);
+}
+
+void createTextureStreamer(TextureStreamer& streamer, JobSystem& jobs, size_t budgetBytes) {
+    streamer.jobs = &jobs;
+    streamer.budgetBytes = budgetBytes;
+    streamer.frame = 0;
+    streamer.nextBuffer = 0;
+    memset(&streamer.stats, 0, sizeof(streamer.stats));
+    streamer.uploadFormats = 0;
+    for (int format = 0; format < TEXTURE_FORMAT_COUNT; format++)
+        if (textureFormatSupported((TextureFormat)format))
+            streamer.uploadFormats |= 1u << format;
+    streamer.immutableStorage = textureStorageSupported();
+
+    glGenTextures(1, &streamer.placeholder);
+    glBindTexture(GL_TEXTURE_2D, streamer.placeholder);
+    const unsigned char grey[16] = { 128, 128, 128, 255, 128, 128, 128, 255, 128, 128, 128, 255, 128, 128, 128, 255 };
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    for (int i = 0; i < TextureStreamer::UPLOAD_RING_SIZE; i++)
+    {
+        glGenBuffers(1, &streamer.ring[i].buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streamer.ring[i].buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, TextureStreamer::UPLOAD_BUFFER_SIZE, NULL, GL_STREAM_DRAW);
+        streamer.ring[i].fence = 0;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+static void releaseTexture(TextureStreamer& streamer, StreamedTexture& texture) {
+    glDeleteTextures(1, &texture.texture);
+    texture.texture = 0;
+    streamer.stats.residentBytes -= texture.gpuBytes;
+    texture.gpuBytes = 0;
+    releaseLevelData(texture);
+    texture.residency = TEXTURE_EVICTED;
+}
+
+void destroyTextureStreamer(TextureStreamer& streamer) {
+    waitForCounter(*streamer.jobs, streamer.decodes);
+    for (size_t i = 0; i < streamer.textures.size(); i++)
+        releaseTexture(streamer, *streamer.textures[i]);
+    streamer.textures.clear();
+    streamer.uploadQueue.clear();
+    for (int i = 0; i < TextureStreamer::UPLOAD_RING_SIZE; i++)
+    {
+        glDeleteSync(streamer.ring[i].fence);
+        glDeleteBuffers(1, &streamer.ring[i].buffer);
+    }
+    glDeleteTextures(1, &streamer.placeholder);
+}
+
+int requestTexture(TextureStreamer& streamer, const char* fileName, TextureUsage usage) {
+    StreamedTexture* texture = new StreamedTexture();
+    texture->fileName = fileName;
+    texture->usage = usage;
+    texture->cache = TextureCacheFile();
+    texture->texture = 0;
+    texture->levelCount = 0;
+    texture->baseLevel = 0;
+    texture->uploadLevel = -1;
+    texture->uploadRow = 0;
+    texture->gpuBytes = 0;
+    texture->lastUsedFrame = streamer.frame;
+    streamer.textures.push_back(std::unique_ptr<StreamedTexture>(texture));
+    streamer.stats.requested++;
+    startDecode(streamer, *texture);
+    return streamer.textures.size() - 1;
+}
+
+unsigned int useTexture(TextureStreamer& streamer, int handle) {
+    StreamedTexture& texture = *streamer.textures[handle];
+    texture.lastUsedFrame = streamer.frame;
+    if (texture.residency == TEXTURE_EVICTED)
+        startDecode(streamer, texture);
+    return texture.texture && texture.baseLevel < texture.levelCount ? texture.texture : streamer.placeholder;
+}
+
+// Storage for every level up front, only levels from baseLevel on are sampled
+static void allocateTexture(TextureStreamer& streamer, RenderState& state, StreamedTexture& texture) {
+    glGenTextures(1, &texture.texture);
+    bindTexture(state, 0, GL_TEXTURE_2D, texture.texture);
+    texture.levelCount = texture.cache.bytes ? texture.cache.header->levelCount : texture.mips.size();
+    texture.gpuBytes = 0;
+    GLenum format = internalFormat(texture);
+    const PixelFormatInfo& pixels = pixelFormatInfo(texture.pixelFormat);
+    if (streamer.immutableStorage)
+    {
+        UploadLevel base = uploadLevel(texture, 0);
+        allocateTextureStorage(GL_TEXTURE_2D, texture.levelCount, format, base.width, base.height);
+    }
+    for (int level = 0; level < texture.levelCount; level++)
+    {
+        UploadLevel data = uploadLevel(texture, level);
+        size_t size = data.rowCount * data.rowBytes;
+        texture.gpuBytes += size;
+        if (streamer.immutableStorage)
+            continue;
+        if (texture.format == TEXTURE_FORMAT_RGBA8)
+            glTexImage2D(GL_TEXTURE_2D, level, format, data.width, data.height, 0, pixels.format, pixels.type, NULL);
+        else
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, format, data.width, data.height, 0, size, NULL);
+    }
+    if (texture.format == TEXTURE_FORMAT_RGBA8)
+        setPixelSwizzle(GL_TEXTURE_2D, texture.pixelFormat);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levelCount - 1);
+    texture.baseLevel = texture.levelCount;
+    texture.uploadLevel = texture.levelCount - 1;
+    texture.uploadRow = 0;
+    streamer.stats.residentBytes += texture.gpuBytes;
+}
+
+// Part of a level copied into an upload buffer
+struct PendingUpload {
+    StreamedTexture* texture;
+    int level, row, rows;
+    size_t offset;
+};
+
+// Packs rows of queued levels, smallest level first, into the next upload
+// buffer and issues their glTexSubImage2D or glCompressedTexSubImage2D. Returns false when the buffer is
+// still being read by the GPU.
+static bool fillUploadBuffer(TextureStreamer& streamer, RenderState& state) {
+    PixelUploadBuffer& upload = streamer.ring[streamer.nextBuffer];
+    if (upload.fence)
+    {
+        if (glClientWaitSync(upload.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            return false;
+        glDeleteSync(upload.fence);
+        upload.fence = 0;
+    }
+
+    // The fence has passed, so nothing reads the old contents any more
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer);
+    unsigned char* mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, TextureStreamer::UPLOAD_BUFFER_SIZE,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    std::vector<PendingUpload> pending;
+    size_t used = 0;
+    for (size_t queued = 0; queued < streamer.uploadQueue.size();)
+    {
+        StreamedTexture& texture = *streamer.textures[streamer.uploadQueue[queued]];
+        if (texture.uploadLevel < 0)
+        {
+            queued++;
+            continue;
+        }
+        UploadLevel level = uploadLevel(texture, texture.uploadLevel);
+        // Parts start 8 byte aligned, 16 bit rows of an odd width may follow single byte ones
+        used = std::min((used + 7) & ~(size_t)7, TextureStreamer::UPLOAD_BUFFER_SIZE);
+        int rows = std::min(level.rowCount - texture.uploadRow,
+                            (int)((TextureStreamer::UPLOAD_BUFFER_SIZE - used) / level.rowBytes));
+        if (rows == 0)
+            break;
+        memcpy(mapped + used, level.bytes + texture.uploadRow * level.rowBytes, rows * level.rowBytes);
+        PendingUpload part = { &texture, texture.uploadLevel, texture.uploadRow, rows, used };
+        pending.push_back(part);
+        used += rows * level.rowBytes;
+        texture.uploadRow += rows;
+        if (texture.uploadRow == level.rowCount)
+        {
+            texture.uploadLevel--;
+            texture.uploadRow = 0;
+        }
+    }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    for (size_t i = 0; i < pending.size(); i++)
+    {
+        const PendingUpload& part = pending[i];
+        StreamedTexture& texture = *part.texture;
+        UploadLevel level = uploadLevel(texture, part.level);
+        bindTexture(state, 0, GL_TEXTURE_2D, texture.texture);
+        if (texture.format == TEXTURE_FORMAT_RGBA8)
+        {
+            // Rows are packed tightly, an R8 row of odd width isn't 4 byte aligned
+            const PixelFormatInfo& pixels = pixelFormatInfo(texture.pixelFormat);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment(level.rowBytes));
+            glTexSubImage2D(GL_TEXTURE_2D, part.level, 0, part.row, level.width, part.rows, pixels.format, pixels.type,
+                            (const void*)part.offset);
+        }
+        else
+        {
+            // Block rows are 4 pixels, the last one may be cut by the level's edge
+            int y = part.row * 4, height = std::min(part.rows * 4, level.height - y);
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, part.level, 0, y, level.width, height,
+                                      INTERNAL_FORMATS[texture.format], part.rows * level.rowBytes,
+                                      (const void*)part.offset);
+        }
+        if (part.row + part.rows == level.rowCount)
+        {
+            // The level is complete, sampling may start there
+            texture.baseLevel = part.level;
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, part.level);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    streamer.nextBuffer = (streamer.nextBuffer + 1) % TextureStreamer::UPLOAD_RING_SIZE;
+    streamer.stats.uploadedBytes += used;
+    return true;
+}
+
+static void evictTextures(TextureStreamer& streamer, RenderState& state) {
+    bool deleted = false;
+    while (streamer.stats.residentBytes > streamer.budgetBytes)
+    {
+        // Least recently used texture with storage. updateTextureStreaming
+        // advances the frame before the draws mark their textures, so the
+        // ones drawn last frame are still one behind and must be kept.
+        StreamedTexture* victim = NULL;
+        for (size_t i = 0; i < streamer.textures.size(); i++)
+        {
+            StreamedTexture* texture = streamer.textures[i].get();
+            if (texture->texture && texture->lastUsedFrame + 1 < streamer.frame &&
+                (!victim || texture->lastUsedFrame < victim->lastUsedFrame))
+                victim = texture;
+        }
+        if (!victim)
+            break;
+        int handle = 0;
+        while (streamer.textures[handle].get() != victim)
+            handle++;
+        streamer.uploadQueue.erase(std::remove(streamer.uploadQueue.begin(), streamer.uploadQueue.end(), handle),
+                                   streamer.uploadQueue.end());
+        if (victim->residency == TEXTURE_RESIDENT)
+            streamer.stats.resident--;
+        releaseTexture(streamer, *victim);
+        streamer.stats.evictions++;
+        deleted = true;
+    }
+    // A deleted name may come back from glGenTextures, the shadowed binding must not match it
+    if (deleted)
+        invalidateRenderState(state);
+}
+
+void updateTextureStreaming(TextureStreamer& streamer, RenderState& state) {
+    streamer.frame++;
+    // Without worker threads nothing decodes in the background, take one job per frame
+    if (streamer.jobs->workerCount == 1)
+        runPendingJob(*streamer.jobs);
+
+    // Newly decoded textures join the upload queue in request order
+    for (size_t i = 0; i < streamer.textures.size(); i++)
+    {
+        StreamedTexture& texture = *streamer.textures[i];
+        if (texture.residency == TEXTURE_DECODED && !texture.texture)
+        {
+            allocateTexture(streamer, state, texture);
+            // Counts as a use, eviction below must not throw away what it just allocated
+            texture.lastUsedFrame = streamer.frame;
+            texture.residency = TEXTURE_UPLOADING;
+            streamer.uploadQueue.push_back(i);
+        }
+    }
+
+    // At most one pass over the ring per frame, so uploads never wait on the GPU
+    for (int uploads = 0; uploads < TextureStreamer::UPLOAD_RING_SIZE && !streamer.uploadQueue.empty(); uploads++)
+    {
+        if (!fillUploadBuffer(streamer, state))
+            break;
+        size_t kept = 0;
+        for (size_t i = 0; i < streamer.uploadQueue.size(); i++)
+        {
+            StreamedTexture& texture = *streamer.textures[streamer.uploadQueue[i]];
+            if (texture.baseLevel > 0)
+            {
+                streamer.uploadQueue[kept++] = streamer.uploadQueue[i];
+                continue;
+            }
+            releaseLevelData(texture);
+            texture.residency = TEXTURE_RESIDENT;
+            streamer.stats.resident++;
+        }
+        streamer.uploadQueue.resize(kept);
+    }
+
+    evictTextures(streamer, state);
+}
+
+void finishTextureStreaming(TextureStreamer& streamer, RenderState& state) {
+    for (;;)
+    {
+        bool pending = false;
+        for (size_t i = 0; i < streamer.textures.size(); i++)
+        {
+            int residency = streamer.textures[i]->residency;
+            pending |= residency == TEXTURE_DECODING || residency == TEXTURE_DECODED || residency == TEXTURE_UPLOADING;
+        }
+        if (!pending)
+            return;
+        waitForCounter(*streamer.jobs, streamer.decodes);
+        updateTextureStreaming(streamer, state);
+    }
+}
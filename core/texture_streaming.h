@@ -0,0 +1,106 @@
+#ifndef TEXTURE_STREAMING_H
+#define TEXTURE_STREAMING_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "opengl.h"
+#include "job_system.h"
+#include "render_state.h"
+#include "mip_chain.h"
+#include "texture_cache.h"
+#include "pixel_format.h"
+
+enum TextureResidency {
+    TEXTURE_EVICTED,    // nothing loaded, the next use requests it again
+    TEXTURE_DECODING,   // a job is decoding the file and building the mip chain, or mapping a .tex
+    TEXTURE_DECODED,    // mips are ready, waiting for their turn to upload
+    TEXTURE_UPLOADING,  // smallest levels are on the GPU and usable, finer ones follow
+    TEXTURE_RESIDENT,   // every level is on the GPU, CPU copies are freed
+    TEXTURE_FAILED
+};
+
+struct StreamedTexture {
+    std::string fileName;
+    TextureUsage usage;
+    std::atomic<int> residency;     // TextureResidency, the decode job moves it to DECODED or FAILED
+    unsigned int uploadFormats;     // copy of TextureStreamer::uploadFormats for the decode job
+    TextureFormat format;           // of the levels below, written by the decode job
+    PixelFormat pixelFormat;        // layout of the rows when format is uncompressed (TEXTURE_FORMAT_RGBA8)
+    std::vector<TextureMip> mips;   // decoded levels, written by the decode job until DECODED
+    TextureCacheFile cache;         // or a mapped .tex whose levels upload as they are
+    unsigned int texture;           // 0 until storage is allocated
+    int levelCount;
+    int baseLevel;                  // finest complete level on the GPU, GL_TEXTURE_BASE_LEVEL
+    int uploadLevel, uploadRow;     // next rows to copy into an upload buffer, -1 when all are
+    size_t gpuBytes;                // storage of all levels
+    unsigned int lastUsedFrame;     // TextureStreamer::frame of the last useTexture or allocation
+};
+
+// Staging buffer for glTexSubImage2D and glCompressedTexSubImage2D, reused once the GPU signals the fence
+struct PixelUploadBuffer {
+    unsigned int buffer;
+    GLsync fence;
+};
+
+struct TextureStreamingStats {
+    unsigned int requested;
+    unsigned int resident;
+    unsigned int evictions;
+    size_t uploadedBytes;
+    size_t residentBytes;
+};
+
+// Loads textures without stalling the render thread: files decode on the
+// job system, levels upload smallest first through a ring of pixel buffer
+// objects (a few per frame, never waiting on the GPU), and a texture is
+// usable as soon as its smallest levels arrive. Until then draws get a
+// placeholder. Textures not used for a while are evicted, least recently
+// used first, once the GPU storage exceeds budgetBytes.
+//
+// Files ending in .tex (see texture_cache.h) skip decoding: the job maps
+// them and their prebuilt levels upload block rows straight from the
+// mapping. Block formats the GL can't sample are decompressed to RGBA8 by
+// the job instead. Images are uploaded in the tightest PixelFormat for
+// their channels and bit depth (R8 for grey, RGBA16F for HDR...).
+struct TextureStreamer {
+    static const int UPLOAD_RING_SIZE = 4;
+    static const size_t UPLOAD_BUFFER_SIZE = 1 << 20;
+
+    JobSystem* jobs;
+    JobCounter decodes;
+    std::vector<std::unique_ptr<StreamedTexture> > textures;
+    std::vector<int> uploadQueue;   // decoded textures in request order
+    PixelUploadBuffer ring[UPLOAD_RING_SIZE];
+    int nextBuffer;
+    unsigned int placeholder;       // 2x2 grey, bound until a texture has levels
+    unsigned int uploadFormats;     // bit per TextureFormat the GL accepts
+    bool immutableStorage;          // glTexStorage2D, otherwise a glTexImage2D per level
+    size_t budgetBytes;
+    unsigned int frame;
+    TextureStreamingStats stats;
+};
+
+void createTextureStreamer(TextureStreamer& streamer, JobSystem& jobs, size_t budgetBytes);
+// Waits for decodes still running, deletes every texture and buffer
+void destroyTextureStreamer(TextureStreamer& streamer);
+
+// Whether the current context samples format, RGBA8 always
+bool textureFormatSupported(TextureFormat format);
+
+// Starts decoding fileName on a worker and returns its handle right away
+int requestTexture(TextureStreamer& streamer, const char* fileName, TextureUsage usage = TEXTURE_USAGE_COLOR);
+// The texture object to bind this frame: the real one once it has a level,
+// the placeholder before. Marks the texture used, evicted ones are requested again.
+unsigned int useTexture(TextureStreamer& streamer, int handle);
+
+// Once per frame on the GL thread: allocates storage for decoded textures,
+// fills free upload buffers and evicts over budget. Texture binds go through
+// state, and deleted textures invalidate it.
+void updateTextureStreaming(TextureStreamer& streamer, RenderState& state);
+// Runs updateTextureStreaming until every requested texture is resident or
+// failed, for runs that need the final images from the first frame
+void finishTextureStreaming(TextureStreamer& streamer, RenderState& state);
+
+#endif
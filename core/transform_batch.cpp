@@ -0,0 +1,77 @@
+#include "transform_batch.h"
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// result = a * b, all column major (glm layout)
+static inline void multiplyMatrices(const float* a, const float* b, float* result) {
+#if defined(__SSE__)
+    __m128 a0 = _mm_loadu_ps(a);
+    __m128 a1 = _mm_loadu_ps(a + 4);
+    __m128 a2 = _mm_loadu_ps(a + 8);
+    __m128 a3 = _mm_loadu_ps(a + 12);
+    for (int column = 0; column < 4; column++)
+    {
+        const float* bColumn = b + column * 4;
+        __m128 sum = _mm_mul_ps(a0, _mm_set1_ps(bColumn[0]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(bColumn[1])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(bColumn[2])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(bColumn[3])));
+        _mm_storeu_ps(result + column * 4, sum);
+    }
+#elif defined(__ARM_NEON)
+    float32x4_t a0 = vld1q_f32(a);
+    float32x4_t a1 = vld1q_f32(a + 4);
+    float32x4_t a2 = vld1q_f32(a + 8);
+    float32x4_t a3 = vld1q_f32(a + 12);
+    for (int column = 0; column < 4; column++)
+    {
+        float32x4_t bColumn = vld1q_f32(b + column * 4);
+        float32x4_t sum = vmulq_lane_f32(a0, vget_low_f32(bColumn), 0);
+        sum = vmlaq_lane_f32(sum, a1, vget_low_f32(bColumn), 1);
+        sum = vmlaq_lane_f32(sum, a2, vget_high_f32(bColumn), 0);
+        sum = vmlaq_lane_f32(sum, a3, vget_high_f32(bColumn), 1);
+        vst1q_f32(result + column * 4, sum);
+    }
+#else
+    for (int column = 0; column < 4; column++)
+    {
+        for (int row = 0; row < 4; row++)
+        {
+            result[column * 4 + row] = a[row] * b[column * 4] + a[4 + row] * b[column * 4 + 1] +
+                                       a[8 + row] * b[column * 4 + 2] + a[12 + row] * b[column * 4 + 3];
+        }
+    }
+#endif
+}
+
+// For M = [c0 c1 c2], inverse(M)^T = [c1 x c2, c2 x c0, c0 x c1] / det(M)
+static inline void cofactorNormalMatrix(const glm::mat4& model, glm::mat3& normalMatrix) {
+    glm::vec3 c0(model[0]), c1(model[1]), c2(model[2]);
+    glm::vec3 r0 = glm::cross(c1, c2);
+    glm::vec3 r1 = glm::cross(c2, c0);
+    glm::vec3 r2 = glm::cross(c0, c1);
+    float determinant = glm::dot(c0, r0);
+    float inverseDeterminant = determinant != 0.0f ? 1.0f / determinant : 0.0f;
+    normalMatrix[0] = r0 * inverseDeterminant;
+    normalMatrix[1] = r1 * inverseDeterminant;
+    normalMatrix[2] = r2 * inverseDeterminant;
+}
+
+void computeObjectTransforms(const glm::mat4& viewProjection, const glm::mat4* models,
+                             size_t count, ObjectTransform* transforms) {
+    const float* vp = &viewProjection[0][0];
+    for (size_t i = 0; i < count; i++)
+    {
+        multiplyMatrices(vp, &models[i][0][0], &transforms[i].modelViewProjection[0][0]);
+        cofactorNormalMatrix(models[i], transforms[i].normalMatrix);
+    }
+}
+
+void computeNormalMatrices(const glm::mat4* models, size_t count, glm::mat3* normalMatrices) {
+    for (size_t i = 0; i < count; i++)
+        cofactorNormalMatrix(models[i], normalMatrices[i]);
+}
@@ -0,0 +1,23 @@
+#ifndef TRANSFORM_BATCH_H
+#define TRANSFORM_BATCH_H
+
+#include <glm/glm.hpp>
+#include <stddef.h>
+
+// Per-object matrices the vertex shader needs, computed once per frame on
+// the CPU so the shader never inverts a matrix per vertex
+struct ObjectTransform {
+    glm::mat4 modelViewProjection;
+    glm::mat3 normalMatrix; // transpose(inverse(mat3(model)))
+};
+
+// Computes transforms for `count` objects in one pass. The 4x4 products use
+// SSE on x86 and NEON on ARM (scalar glm otherwise); normal matrices come
+// from the cofactors of the model's upper 3x3, no general inverse needed.
+void computeObjectTransforms(const glm::mat4& viewProjection, const glm::mat4* models,
+                             size_t count, ObjectTransform* transforms);
+
+// Normal matrices only, for instances whose MVP is built in the shader
+void computeNormalMatrices(const glm::mat4* models, size_t count, glm::mat3* normalMatrices);
+
+#endif
@@ -0,0 +1,99 @@
+#include "uniform_buffers.h"
+#include <stdio.h>
+#include <string.h>
+
+void bindSharedUniformBlocks(unsigned int program) {
+    static const struct { const char* name; unsigned int binding; } blocks[] = {
+        { "FrameUniforms", FRAME_UNIFORM_BINDING },
+        { "LightUniforms", LIGHT_UNIFORM_BINDING }
+    };
+    for (size_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++)
+    {
+        unsigned int index = glGetUniformBlockIndex(program, blocks[i].name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, index, blocks[i].binding);
+    }
+}
+
+static GLsizeiptr alignUp(GLsizeiptr value, GLint alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool createUniformRing(UniformRing& ring, size_t bytesPerFrame, int blocksPerFrame) {
+    ring.alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ring.alignment);
+    if (ring.alignment < 1)
+        ring.alignment = 256;
+    // Every pushed block starts aligned, leave room for the padding
+    ring.frameSize = alignUp(bytesPerFrame + blocksPerFrame * (ring.alignment - 1), ring.alignment);
+    ring.frameIndex = 0;
+    ring.mapped = NULL;
+    ring.used = 0;
+    for (int i = 0; i < UNIFORM_RING_FRAMES; i++)
+        ring.fences[i] = 0;
+
+    glGenBuffers(1, &ring.buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+    glBufferData(GL_UNIFORM_BUFFER, ring.frameSize * UNIFORM_RING_FRAMES, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    if (glGetError() != GL_NO_ERROR)
+    {
+        fputs("Failed to create the uniform buffer ring\n", stderr);
+        return false;
+    }
+    return true;
+}
+
+void destroyUniformRing(UniformRing& ring) {
+    for (int i = 0; i < UNIFORM_RING_FRAMES; i++)
+    {
+        if (ring.fences[i])
+            glDeleteSync(ring.fences[i]);
+        ring.fences[i] = 0;
+    }
+    glDeleteBuffers(1, &ring.buffer);
+    ring.buffer = 0;
+}
+
+void beginUniformFrame(UniformRing& ring) {
+    // Everything submitted so far may read the previous region
+    if (ring.mapped == NULL && ring.used > 0)
+    {
+        if (ring.fences[ring.frameIndex])
+            glDeleteSync(ring.fences[ring.frameIndex]);
+        ring.fences[ring.frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        ring.frameIndex = (ring.frameIndex + 1) % UNIFORM_RING_FRAMES;
+    }
+
+    GLsync fence = ring.fences[ring.frameIndex];
+    if (fence)
+    {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(fence);
+        ring.fences[ring.frameIndex] = 0;
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+    ring.mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, ring.frameIndex * ring.frameSize, ring.frameSize,
+                                                   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    ring.used = 0;
+}
+
+void pushUniformBlock(UniformRing& ring, unsigned int binding, const void* data, size_t size) {
+    GLintptr offset = alignUp(ring.used, ring.alignment);
+    if (ring.mapped == NULL || offset + (GLsizeiptr)size > ring.frameSize)
+    {
+        fputs("Uniform ring region overflow\n", stderr);
+        return;
+    }
+    memcpy(ring.mapped + offset, data, size);
+    ring.used = offset + size;
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, ring.buffer, ring.frameIndex * ring.frameSize + offset, size);
+}
+
+void endUniformFrame(UniformRing& ring) {
+    glBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    ring.mapped = NULL;
+}
@@ -0,0 +1,58 @@
+#ifndef UNIFORM_BUFFERS_H
+#define UNIFORM_BUFFERS_H
+
+#include <glm/glm.hpp>
+#include <stddef.h>
+#include "opengl.h"
+
+// Fixed binding points, every program gets its blocks bound to these at link
+enum UniformBlockBinding {
+    FRAME_UNIFORM_BINDING = 0,
+    LIGHT_UNIFORM_BINDING = 1
+};
+
+// std140 mirrors of the blocks in the shaders, vec3s are padded to vec4
+struct FrameUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 viewPos; // w unused
+};
+
+struct LightUniforms {
+    glm::vec4 position; // w unused
+    glm::vec4 color;    // w unused
+};
+
+// Binds FrameUniforms and LightUniforms of a linked program to their binding
+// points, blocks the program doesn't use are ignored
+void bindSharedUniformBlocks(unsigned int program);
+
+// Triple buffered ring for the per-frame uniform blocks. GL 4.1 has no
+// persistent mapping, so each frame maps only its own region unsynchronized
+// and a fence per region keeps the CPU from overwriting one the GPU may
+// still read (normally a no-op with three frames in flight).
+const int UNIFORM_RING_FRAMES = 3;
+
+struct UniformRing {
+    unsigned int buffer;
+    GLsizeiptr frameSize;   // bytes per region, multiple of the offset alignment
+    GLint alignment;        // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    int frameIndex;
+    GLsync fences[UNIFORM_RING_FRAMES];
+    unsigned char* mapped;  // current region while a frame is open
+    GLintptr used;
+};
+
+// bytesPerFrame is the total size of the blocksPerFrame blocks pushed each frame
+bool createUniformRing(UniformRing& ring, size_t bytesPerFrame, int blocksPerFrame);
+void destroyUniformRing(UniformRing& ring);
+
+// Fences the previous region, waits for the next one and maps it
+void beginUniformFrame(UniformRing& ring);
+// Copies a block into the current region and binds it to binding
+void pushUniformBlock(UniformRing& ring, unsigned int binding, const void* data, size_t size);
+// Unmaps the region, must be called before drawing
+void endUniformFrame(UniformRing& ring);
+
+#endif
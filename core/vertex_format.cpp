@@ -0,0 +1,199 @@
+#include "vertex_format.h"
+#include "mesh.h"
+#include "opengl.h"
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+unsigned int vertexStride(VertexFormat format) {
+    return format == VERTEX_FORMAT_COMPACT ? sizeof(CompactVertex) : sizeof(Vertex);
+}
+
+void quantizationRange(const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                       glm::vec3& offset, glm::vec3& scale) {
+    offset = boundsMin;
+    scale = boundsMax - boundsMin;
+    // Flat meshes still need a non-zero scale on the flat axis
+    for (int i = 0; i < 3; i++)
+    {
+        if (scale[i] <= 0.0f)
+            scale[i] = 1.0f;
+    }
+}
+
+unsigned short floatToHalf(float value) {
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    unsigned int sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    unsigned int mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff)
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0); // inf / nan
+    if (exponent >= 31)
+        return sign | 0x7c00; // overflow to inf
+    if (exponent <= 0)
+    {
+        // Subnormal half or zero
+        if (exponent < -10)
+            return sign;
+        mantissa |= 0x800000;
+        unsigned int shift = 14 - exponent;
+        unsigned int half = mantissa >> shift;
+        // Round to nearest
+        if ((mantissa >> (shift - 1)) & 1)
+            half++;
+        return sign | half;
+    }
+    unsigned int half = sign | (exponent << 10) | (mantissa >> 13);
+    // Round to nearest, a carry into the exponent is still correct
+    if (mantissa & 0x1000)
+        half++;
+    return half;
+}
+
+float halfToFloat(unsigned short half) {
+    unsigned int sign = (half & 0x8000) << 16;
+    unsigned int exponent = (half >> 10) & 0x1f;
+    unsigned int mantissa = half & 0x3ff;
+    unsigned int bits;
+    if (exponent == 0x1f)
+        bits = sign | 0x7f800000 | (mantissa << 13); // inf / nan
+    else if (exponent != 0)
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    else if (mantissa == 0)
+        bits = sign;
+    else
+    {
+        // Subnormal half, normalize it
+        exponent = 127 - 14;
+        while (!(mantissa & 0x400))
+        {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static short toSnorm16(float value) {
+    value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+    return (short)lroundf(value * 32767.0f);
+}
+
+void encodeOctahedral(const float* normal, short* encoded) {
+    float sum = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+    if (sum == 0.0f)
+    {
+        encoded[0] = encoded[1] = 0;
+        return;
+    }
+    float x = normal[0] / sum;
+    float y = normal[1] / sum;
+    // Fold the lower hemisphere over the diagonals
+    if (normal[2] < 0.0f)
+    {
+        float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    encoded[0] = toSnorm16(x);
+    encoded[1] = toSnorm16(y);
+}
+
+// decodeOctahedral in VertexShaderCode.glsl
+void decodeOctahedral(const short* encoded, float* normal) {
+    // snorm16 to float the way GL converts vertex attributes
+    float x = std::max(encoded[0] / 32767.0f, -1.0f);
+    float y = std::max(encoded[1] / 32767.0f, -1.0f);
+    float z = 1.0f - fabsf(x) - fabsf(y);
+    float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    float length = sqrtf(x * x + y * y + z * z);
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+static unsigned char toUnorm8(float value) {
+    value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    return (unsigned char)lroundf(value * 255.0f);
+}
+
+void compressVertices(const std::vector<Vertex>& vertices, const glm::vec3& boundsMin,
+                      const glm::vec3& boundsMax, std::vector<CompactVertex>& compact) {
+    glm::vec3 offset, scale;
+    quantizationRange(boundsMin, boundsMax, offset, scale);
+
+    compact.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex& source = vertices[i];
+        CompactVertex& target = compact[i];
+        for (int k = 0; k < 3; k++)
+        {
+            float unit = (source.position[k] - offset[k]) / scale[k];
+            unit = unit < 0.0f ? 0.0f : (unit > 1.0f ? 1.0f : unit);
+            target.position[k] = (unsigned short)lroundf(unit * 65535.0f);
+        }
+        target.position[3] = 0;
+        encodeOctahedral(source.normal, target.normal);
+        target.color[0] = toUnorm8(source.color[0]);
+        target.color[1] = toUnorm8(source.color[1]);
+        target.color[2] = toUnorm8(source.color[2]);
+        target.color[3] = 255;
+        target.texCoord[0] = floatToHalf(source.texCoord[0]);
+        target.texCoord[1] = floatToHalf(source.texCoord[1]);
+    }
+}
+
+void decompressVertices(const CompactVertex* compact, size_t count, const glm::vec3& boundsMin,
+                        const glm::vec3& boundsMax, std::vector<Vertex>& vertices) {
+    glm::vec3 offset, scale;
+    quantizationRange(boundsMin, boundsMax, offset, scale);
+
+    vertices.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        const CompactVertex& source = compact[i];
+        Vertex& target = vertices[i];
+        for (int k = 0; k < 3; k++)
+            target.position[k] = offset[k] + source.position[k] / 65535.0f * scale[k];
+        decodeOctahedral(source.normal, target.normal);
+        for (int k = 0; k < 3; k++)
+            target.color[k] = source.color[k] / 255.0f;
+        target.texCoord[0] = halfToFloat(source.texCoord[0]);
+        target.texCoord[1] = halfToFloat(source.texCoord[1]);
+    }
+}
+
+void setupVertexAttributes(VertexFormat format) {
+    if (format == VERTEX_FORMAT_COMPACT)
+    {
+        GLsizei stride = sizeof(CompactVertex);
+        glEnableVertexAttribArray(0); // position, 16-bit unorm
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(CompactVertex, position));
+        glEnableVertexAttribArray(1); // octahedral normal, 16-bit snorm
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(CompactVertex, normal));
+        glEnableVertexAttribArray(2); // color, 8-bit unorm
+        glVertexAttribPointer(2, 3, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(CompactVertex, color));
+        glEnableVertexAttribArray(3); // texture coords, half float
+        glVertexAttribPointer(3, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(CompactVertex, texCoord));
+        return;
+    }
+
+    glEnableVertexAttribArray(0); // position
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+    glEnableVertexAttribArray(1); // normal
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(2); // color
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+    glEnableVertexAttribArray(3); // texture coords
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
+}
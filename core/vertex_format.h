@@ -0,0 +1,49 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+struct Vertex;
+
+// How a mesh's vertices are laid out in its vertex buffer
+enum VertexFormat {
+    VERTEX_FORMAT_FLOAT = 0,   // Vertex: 11 floats, 44 bytes
+    VERTEX_FORMAT_COMPACT = 1  // CompactVertex: 20 bytes
+};
+
+// Quantized vertex, decoded in VertexShaderCode.glsl:
+// - position: 16-bit unorm relative to the mesh bounds (w is padding),
+//   turned back into object space with the positionOffset/positionScale uniforms
+// - normal: octahedral encoding in 2x 16-bit snorm
+// - color: RGBA8 unorm
+// - texture coords: 2x half float, so repeating UVs outside [0, 1] survive
+struct CompactVertex {
+    unsigned short position[4];
+    short normal[2];
+    unsigned char color[4];
+    unsigned short texCoord[2];
+};
+
+unsigned int vertexStride(VertexFormat format);
+
+// Offset and scale that map [0, 1] positions back onto the bounds
+void quantizationRange(const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                       glm::vec3& offset, glm::vec3& scale);
+
+void compressVertices(const std::vector<Vertex>& vertices, const glm::vec3& boundsMin,
+                      const glm::vec3& boundsMax, std::vector<CompactVertex>& compact);
+
+// Inverse of compressVertices, decoding the way the vertex shader does
+void decompressVertices(const CompactVertex* compact, size_t count, const glm::vec3& boundsMin,
+                        const glm::vec3& boundsMax, std::vector<Vertex>& vertices);
+
+unsigned short floatToHalf(float value);
+float halfToFloat(unsigned short half);
+void encodeOctahedral(const float* normal, short* encoded);
+void decodeOctahedral(const short* encoded, float* normal);
+
+// Points attributes 0-3 of the bound VBO at the given layout
+void setupVertexAttributes(VertexFormat format);
+
+#endif
@@ -1,4 +1,9 @@
 #!/bin/bash
 
-clang++ -std=c++11 -o main core/*.cpp -I. -I$(brew --prefix)/include -L$(brew --prefix)/lib -lglfw -lassimp -framework OpenGL
-./main
\ No newline at end of file
+if [ "$(uname)" = "Darwin" ]; then
+    clang++ -std=c++11 -o main core/*.cpp -I. -I$(brew --prefix)/include -L$(brew --prefix)/lib -lglfw -lassimp -framework OpenGL
+else
+    # Linux: EGL is used for --headless rendering (works with Mesa llvmpipe)
+    clang++ -std=c++11 -o main core/*.cpp -I. -lglfw -lassimp -lEGL -lGL -pthread
+fi
+./main "$@"
\ No newline at end of file
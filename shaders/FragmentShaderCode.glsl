@@ -5,19 +5,35 @@ in vec3 vertexColor;
 in vec3 Normal;     // Normal vector
 in vec3 FragPos;    // Fragment position
 in vec2 TexCoord;   // Texture coordinates
+flat in float TextureLayer;
 
 uniform bool useTexture; // Add this line
 uniform sampler2D texture1; // Texture sampler
+// Atlas materials sample a layer of the texture array instead of texture1
+uniform bool useTextureArray;
+uniform sampler2DArray textureArray;
 
-// Light properties
-uniform vec3 lightPos;       // Light position
-uniform vec3 lightColor;     // Light color
-uniform vec3 viewPos;        // Camera position
+// Shared by every program, written once per frame (see uniform_buffers.h)
+layout (std140) uniform FrameUniforms {
+   mat4 view;
+   mat4 projection;
+   mat4 viewProjection;
+   vec4 viewPos;     // Camera position
+} frame;
+
+layout (std140) uniform LightUniforms {
+   vec4 position;    // Light position
+   vec4 color;       // Light color
+} light;
 
 uniform bool useLighting;
 
 void main()
 {
+   vec3 lightPos = light.position.xyz;
+   vec3 lightColor = light.color.rgb;
+   vec3 viewPos = frame.viewPos.xyz;
+
    // Ambient
    float ambientStrength = 0.1;
    vec3 ambient = ambientStrength * lightColor;
@@ -35,7 +51,11 @@ void main()
    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
    vec3 specular = specularStrength * spec * lightColor;  
 
-   vec4 texColor = useTexture ? texture(texture1, TexCoord) : vec4(1.0); // Check useTexture before sampling
+   vec4 texColor = vec4(1.0);
+   if (useTextureArray)
+      texColor = texture(textureArray, vec3(TexCoord, TextureLayer));
+   else if (useTexture)
+      texColor = texture(texture1, TexCoord); // Check useTexture before sampling
 
    if (useLighting) {
       // Perform lighting calculations
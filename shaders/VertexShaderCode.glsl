@@ -1,34 +1,106 @@
 #version 410 core
 
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 inNormal; // Normal vector
+layout (location = 1) in vec3 inNormal; // Normal vector (xy only when octahedral)
 layout (location = 2) in vec3 inVertexColor;
 layout (location = 3) in vec2 aTexCoords; // Texture coordinates
+// Per-instance attributes (see instancing.h), only read when instanced
+layout (location = 4) in mat4 instanceModel;
+layout (location = 8) in mat3 instanceNormalMatrix;
+// Draw index inside a multi-draw batch (see multi_draw.h)
+layout (location = 11) in uint batchDrawID;
 
 out vec3 vertexColor;
 out vec3 FragPos;   // Fragment position
 out vec3 Normal;    // Normal
 out vec2 TexCoord;  // Texture coordinates
+flat out float TextureLayer; // layer of the texture array, see texture_array.h
 
+// Computed per object on the CPU (see transform_batch.h)
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat4 modelViewProjection;
+uniform mat3 normalMatrix;
+
+// Instanced draws take the model from the instance attributes instead
+uniform bool instanced = false;
+
+// Multi-draw batches fetch model, normal matrix and position decoding from
+// a buffer texture, 9 texels per draw starting at drawOffset + batchDrawID
+uniform bool multiDraw = false;
+uniform int drawOffset = 0;
+uniform samplerBuffer drawData;
+
+// Shared by every program, written once per frame (see uniform_buffers.h)
+layout (std140) uniform FrameUniforms {
+  mat4 view;
+  mat4 projection;
+  mat4 viewProjection;
+  vec4 viewPos;
+} frame;
 
 uniform bool useLighting;
+uniform float textureLayer = 0.0; // multi-draw batches keep it in the draw data instead
 
-vec4 transformedPosition = projection * view * model * vec4(aPos, 1.0);
+// Compact vertices: positions are 0..1 inside the mesh bounds and normals are
+// octahedral encoded. The defaults decode plain float vertices unchanged.
+uniform vec3 positionOffset = vec3(0.0);
+uniform vec3 positionScale = vec3(1.0);
+uniform bool octahedralNormals = false;
+
+vec3 decodeOctahedral(vec2 e)
+{
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
 
 void main()
 {
+  vec3 decodeOffset = positionOffset;
+  vec3 decodeScale = positionScale;
+  float layer = textureLayer;
+  mat4 drawModel;
+  mat3 drawNormalMatrix;
+  if (multiDraw) {
+    int base = (drawOffset + int(batchDrawID)) * 9;
+    drawModel = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1),
+                     texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+    drawNormalMatrix = mat3(texelFetch(drawData, base + 4).xyz, texelFetch(drawData, base + 5).xyz,
+                            texelFetch(drawData, base + 6).xyz);
+    vec4 offsetLayer = texelFetch(drawData, base + 7);
+    decodeOffset = offsetLayer.xyz;
+    layer = offsetLayer.w;
+    decodeScale = texelFetch(drawData, base + 8).xyz;
+  }
+
+  // decode the vertex attributes (no-op for float vertices)
+  vec3 position = decodeOffset + aPos * decodeScale;
+  vec3 normal = octahedralNormals ? decodeOctahedral(inNormal.xy) : inNormal;
+
   // set transformed position
-  gl_Position = transformedPosition;
+  vec4 worldPosition;
+  if (multiDraw) {
+    worldPosition = drawModel * vec4(position, 1.0);
+    gl_Position = frame.viewProjection * worldPosition;
+    Normal = drawNormalMatrix * normal;
+  } else if (instanced) {
+    worldPosition = instanceModel * vec4(position, 1.0);
+    gl_Position = frame.viewProjection * worldPosition;
+    Normal = instanceNormalMatrix * normal;
+  } else {
+    worldPosition = model * vec4(position, 1.0);
+    gl_Position = modelViewProjection * vec4(position, 1.0);
+    Normal = normalMatrix * normal; // Transform normals
+  }
 
   // pass the vertex color data to the Fragment Shader
   vertexColor = inVertexColor;
 
   // pass the texture coordinates to the Fragment Shader
   TexCoord = aTexCoords;
+  TextureLayer = layer;
 
-  FragPos = vec3(model * vec4(aPos, 1.0)); // Position in world space
-  Normal = mat3(transpose(inverse(model))) * inNormal; // Transform normals
+  FragPos = vec3(worldPosition); // Position in world space
 }
\ No newline at end of file